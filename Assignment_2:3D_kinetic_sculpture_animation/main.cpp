@@ -6,54 +6,392 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
+#include <cstdio>
+#include <chrono>
 #include <fstream>
 #include <sstream>
 #include <map>
 #include <string>
+#include <future>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 #include "common.hpp"
+#include "bvh.hpp"
+#include "culling.hpp"
+#include "occlusion.hpp"
+#include "ecs.hpp"
+#include "file_watcher.hpp"
+#include "geometry_arena.hpp"
+#include "gl_state.hpp"
+#include "job_system.hpp"
+#include "kinetic_sculpture.hpp"
+#include "linkage_solver.hpp"
+#include "oscillator_solver.hpp"
+#include "program_cache.hpp"
+#include "render_queue.hpp"
+#include "scene.hpp"
+#include "shader_permutations.hpp"
+#include "texture_streamer.hpp"
+#include "triple_buffer.hpp"
+#include "uniform_blocks.hpp"
+#include "uniforms.hpp"
 
-// Window dimensions
-const unsigned int SCR_WIDTH = 1200;
-const unsigned int SCR_HEIGHT = 800;
+// Window dimensions (overridable with --resolution WxH)
+unsigned int SCR_WIDTH = 1200;
+unsigned int SCR_HEIGHT = 800;
 
-// Camera
+// Camera: the simulation moves it, the GL thread turns it (cameraFront is
+// the mouse look, read as late as possible before drawing)
 glm::vec3 cameraPos = glm::vec3(0.0f, 0.0f, 3.0f);
 glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
 glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
 
-// Timing
-float deltaTime = 0.0f;
-float lastFrame = 0.0f;
+// Simulation clock: fixed steps of 1 / simulationRate seconds (--sim-rate),
+// as many as it takes to reach wall time but at most MAX_CATCH_UP_STEPS per
+// update. Time beyond that is dropped, so a long stall costs a jump instead
+// of a string of slow updates each trying to catch up.
+double simulationRate = 120.0;
+const int MAX_CATCH_UP_STEPS = 8;
+double simulationClock = 0.0;       // wall time the newest step reached
+double droppedSimulationMs = 0.0;
 
-// Earth parameters
-float animationTime = 0.0f;
-float rotationSpeed = 0.3f;
-float earthScale = 1.0f;
-bool isRotating = true;
+// Display
 bool showWireframe = false;
 
-// Earth lighting parameters
-float lightIntensity = 1.0f;
-glm::vec3 sunPosition = glm::vec3(5.0f, 3.0f, 5.0f);
-glm::vec3 sunColor = glm::vec3(1.0f, 0.95f, 0.8f);
+// Relief mapping parameters (reliefDepth must match Bake::kReliefDepth)
+bool reliefEnabled = true;
+float reliefDepth = 0.004f;
 
-// Earth structure
+// Optional Earth layers, each selecting a shader variant
+bool nightLightsEnabled = true;
+bool cloudsEnabled = true;
+
+// Static meshes share one vertex/index arena in the Earth's vertex layout
+// (position, UV, normal, tangent), so they all draw from a single VAO
+Common::GeometryArena staticMeshes(11 * sizeof(float), {
+    { 0, 3, 0 },
+    { 1, 2, 3 * sizeof(float) },
+    { 2, 3, 5 * sizeof(float) },
+    { 3, 3, 8 * sizeof(float) },
+});
+
+// Earth structure (textures are cubemaps baked by earth_bake)
 struct EarthModel {
-    unsigned int VAO, VBO, EBO;
+    Common::GeometryArena::MeshId mesh = Common::GeometryArena::INVALID_MESH;
     std::vector<float> vertices;
     std::vector<unsigned int> indices;
     unsigned int diffuseTexture;
     unsigned int cloudsTexture;
     unsigned int nightLightsTexture;
+    unsigned int reliefTexture;
+    unsigned int coastTexture;
     bool loaded;
 };
 
 EarthModel earth;
 
+// Scene entities: the Earth (Transform, Spin, WorldMatrix, Planet), the sun
+// (Transform, Light) and one per sculpture element (SculptureInstance)
+Common::World scene;
+Common::Entity earthEntity;
+Common::Entity sunEntity;
+
+// Drawn with the Earth shader from the model's current mesh and textures
+struct Planet {
+    EarthModel* model;
+};
+
+void createScene(size_t elementCount)
+{
+    Common::Transform earthTransform;
+    Common::Spin earthSpin;
+    earthSpin.speed = 0.3f;
+    earthEntity = scene.create(earthTransform, earthSpin, Common::WorldMatrix(), Planet{ &earth });
+    
+    Common::Transform sunTransform;
+    sunTransform.position = glm::vec3(5.0f, 3.0f, 5.0f);
+    Common::Light sunLight;
+    sunLight.color = glm::vec3(1.0f, 0.95f, 0.8f);
+    sunEntity = scene.create(sunTransform, sunLight);
+    
+    std::vector<Common::SculptureInstance> elements;
+    Common::layoutSculpture(elementCount, Common::SculptureLayout(), elements);
+    for (const Common::SculptureInstance& element : elements)
+        scene.create(element);
+}
+
+// Sculpture elements in chunk order, for the instance buffer and the solvers
+std::vector<Common::SculptureInstance> gatherSculptureElements()
+{
+    std::vector<Common::SculptureInstance> elements;
+    scene.each<Common::SculptureInstance>([&](size_t count, Common::SculptureInstance* chunk) {
+        elements.insert(elements.end(), chunk, chunk + count);
+    });
+    return elements;
+}
+
+// Earth shader uniforms, hashed at compile time and resolved through each variant's table
+constexpr Common::UniformId U_DIFFUSE_TEX("diffuseTex");
+constexpr Common::UniformId U_CLOUDS_TEX("cloudsTex");
+constexpr Common::UniformId U_NIGHT_TEX("nightTex");
+constexpr Common::UniformId U_RELIEF_TEX("reliefTex");
+constexpr Common::UniformId U_RELIEF_DEPTH("reliefDepth");
+constexpr Common::UniformId U_COAST_TEX("coastTex");
+constexpr Common::UniformId U_AMBIENT_SH("ambientSH");
+
+// Linked program binaries, reused across launches until the shaders or driver change
+Common::ProgramCache programCache("shader_cache");
+
+// Earth shader variants; bit i of a feature mask #defines EARTH_FEATURE_NAMES[i].
+// INSTANCED takes the model matrix per instance from the render queue, so
+// planets are drawn as instanced packets; the layer bits are toggled by keys.
+enum EarthFeature : uint32_t {
+    EARTH_NIGHT_LIGHTS = 1u << 0,
+    EARTH_CLOUDS = 1u << 1,
+    EARTH_RELIEF = 1u << 2,
+    EARTH_INSTANCED = 1u << 3,
+    EARTH_ALL_LAYERS = (1u << 3) - 1
+};
+const std::vector<std::string> EARTH_FEATURE_NAMES = { "NIGHT_LIGHTS", "CLOUDS", "RELIEF", "INSTANCED" };
+
+Common::ShaderPermutations earthShaders("resources/vs/kinetic_sculpture.vs", "resources/fs/kinetic_sculpture.fs",
+                                        EARTH_FEATURE_NAMES, &programCache);
+
+// Kinetic sculpture: a ring of pivoting elements around the Earth, drawn as one
+// instanced draw and animated in the vertex shader (--sculpture-elements N,
+// --sculpture-shape rod|vane|sphere). With --sculpture-sim euler|verlet the
+// elements are pendulums simulated on the CPU instead, and with
+// --sculpture-sim linkage each is a chain of rods (--sculpture-links N).
+size_t sculptureElements = 10000;
+Common::ElementShape sculptureShape = Common::ElementShape::Vane;
+bool sculptureVisible = true;
+bool sculptureSimulated = false;
+bool sculptureLinked = false;
+unsigned int sculptureLinks = 4;
+Common::KineticSculpture sculpture;
+Common::OscillatorSolver sculptureSolver;
+Common::LinkageSolver sculptureLinkage;
+std::vector<Common::SculptureInstance> sculptureAnchors;
+
+enum SculptureFeature : uint32_t {
+    SCULPTURE_SIMULATED = 1u << 0,
+    SCULPTURE_LINKED = 1u << 1
+};
+Common::ShaderPermutations sculptureShaders("resources/vs/sculpture_element.vs", "resources/fs/sculpture_element.fs",
+                                            { "SIMULATED", "LINKED" }, &programCache);
+
+// Pendulum wave: periods shorten from the inner to the outer edge so the ring
+// falls in and out of step, realigning every PENDULUM_WAVE_PERIOD seconds. A
+// light wind circling the ring keeps it from settling.
+const float PENDULUM_WAVE_PERIOD = 60.0f;
+const float PENDULUM_WAVE_CYCLES = 20.0f;     // swings of the innermost pendulum per period
+const float PENDULUM_WAVE_SPREAD = 8.0f;      // extra swings of the outermost
+
+void setupSculptureSolver(Common::Integrator integrator, const std::vector<Common::SculptureInstance>& instances)
+{
+    Common::SculptureLayout layout;
+    sculptureSolver.resize(instances.size());
+    sculptureSolver.setIntegrator(integrator);
+    sculptureSolver.setDamping(0.02f);
+    sculptureSolver.setDriveFrequency(2.5f);
+    for (size_t i = 0; i < instances.size(); ++i) {
+        const glm::vec3& offset = instances[i].offset;
+        float radius = glm::length(offset);
+        float t = (radius - layout.innerRadius) / (layout.outerRadius - layout.innerRadius);
+        float frequency = 2.0f * (float)M_PI * (PENDULUM_WAVE_CYCLES + PENDULUM_WAVE_SPREAD * t) / PENDULUM_WAVE_PERIOD;
+        sculptureSolver.set(i, frequency * frequency, 0.05f, std::atan2(offset.z, offset.x), 0.8f);
+    }
+}
+
+// Linkage: chains hang from pins that sway along the ring in the analytic
+// sculpture's spiral wave, each link hinged about its spoke with springy joints
+const float LINKAGE_LINK_LENGTH = 0.12f;
+const float LINKAGE_JOINT_STIFFNESS = 0.3f;
+const float LINKAGE_SWAY = 0.1f;            // pin travel either side, along the ring
+const unsigned int LINKAGE_ITERATIONS = 8;
+const float LINKAGE_ROD_RADIUS = 0.06f * LINKAGE_LINK_LENGTH;   // as meshed by createLinked()
+
+// The linked sculpture's rods in a BVH, in sculpture space, for picking (P).
+// Refit every step; once that has loosened it past BVH_REBUILD_COST times its
+// built cost, rebuilt on another thread. Simulation thread only.
+const float BVH_REBUILD_COST = 1.5f;
+Common::Bvh sculptureBvh;
+std::vector<Common::Aabb> sculptureRodBounds;
+double sculptureBvhMs = 0.0;        // since the last snapshot
+
+void setupSculptureLinkage(const std::vector<Common::SculptureInstance>& anchors)
+{
+    sculptureAnchors = anchors;
+    Common::buildChainSculpture(sculptureLinkage, sculptureAnchors, sculptureLinks, LINKAGE_LINK_LENGTH,
+                                LINKAGE_JOINT_STIFFNESS);
+    sculptureLinkage.setDamping(0.2f);
+}
+
+void driveSculptureLinkage(float time)
+{
+    for (size_t i = 0; i < sculptureAnchors.size(); ++i) {
+        const Common::SculptureInstance& anchor = sculptureAnchors[i];
+        glm::vec3 along = glm::cross(glm::vec3(0.0f, 1.0f, 0.0f), anchor.axis);
+        float sway = LINKAGE_SWAY * std::sin(anchor.frequency * time + anchor.phase);
+        sculptureLinkage.setPosition(i * (sculptureLinks + 1), anchor.offset + along * sway);
+    }
+}
+
+// Software occlusion culling of the linked sculpture's rods: the planets are
+// rasterized on the CPU as low-poly spheres into a small depth buffer, and
+// rods hidden behind them are left out of the instance buffer (--occlusion off)
+bool occlusionEnabled = true;
+const unsigned int OCCLUSION_WIDTH = 320;
+const unsigned int OCCLUSION_HEIGHT = 192;
+const unsigned int OCCLUDER_SEGMENTS = 24;
+
+// Sculpture space to world: tilted towards the default camera so the ring reads as a ring
+glm::mat4 sculptureModel()
+{
+    return glm::rotate(glm::mat4(1.0f), glm::radians(20.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+}
+
+uint32_t sculptureFeatures()
+{
+    return (sculptureSimulated ? SCULPTURE_SIMULATED : 0u) | (sculptureLinked ? SCULPTURE_LINKED : 0u);
+}
+
+uint32_t earthFeatures()
+{
+    return EARTH_INSTANCED | (nightLightsEnabled ? EARTH_NIGHT_LIGHTS : 0u) | (cloudsEnabled ? EARTH_CLOUDS : 0u) |
+           (reliefEnabled ? EARTH_RELIEF : 0u);
+}
+
+// Camera/lights once per frame, transforms once per draw (std140, see uniform_blocks.hpp)
+Common::UniformBuffer<Common::FrameBlock> frameUniforms;
+Common::UniformBuffer<Common::ObjectBlock> objectUniforms;
+
+// Cooked textures stream in mip-tail first; finer levels arrive in the background
+// on a reader thread that starts with the first load, once the context exists
+Common::TextureStreamer textureStreamer;
+
+// Draws are recorded into the render queue, sorted by key and replayed once per frame
+enum RenderPass : uint8_t {
+    PASS_OPAQUE = 0
+};
+Common::RenderQueue renderQueue;
+Common::Material earthMaterial;
+
+// Planets recorded per render queue chunk; a smaller chunk costs more in
+// scheduling than the two inverses per planet it would spread
+constexpr size_t PLANET_RECORD_CHUNK = 64;
+
+// Earth asset files, also watched for hot reload
+const std::string EARTH_MESH_PATH = "resources/23-earth_photorealistic_2k/Earth 2K.obj";
+const std::pair<const char*, unsigned int EarthModel::*> EARTH_TEXTURE_FILES[] = {
+    { "resources/cooked/earth_diffuse.ctex", &EarthModel::diffuseTexture },
+    { "resources/cooked/earth_clouds.ctex", &EarthModel::cloudsTexture },
+    { "resources/cooked/earth_night.ctex", &EarthModel::nightLightsTexture },
+    { "resources/cooked/earth_relief.ctex", &EarthModel::reliefTexture },
+    { "resources/cooked/earth_coast.ctex", &EarthModel::coastTexture },
+};
+
+// Hot reload: only the asset behind a changed file is rebuilt, off the render
+// thread where possible, and swapped in between frames
+using ReloadClock = std::chrono::steady_clock;
+
+// A replacement texture streams in next to the one it replaces
+struct TextureReload {
+    std::string path;
+    unsigned int EarthModel::* slot;
+    unsigned int replacement;
+    ReloadClock::time_point start;
+    double swapMs;      // render-thread time spent on this reload
+};
+std::vector<TextureReload> textureReloads;
+
+// The OBJ is parsed by std::async into these, then uploaded between frames
+std::future<bool> meshReload;
+ReloadClock::time_point meshReloadStart;
+bool meshReloadQueued = false;
+std::vector<float> reloadedVertices;
+std::vector<unsigned int> reloadedIndices;
+
+bool shaderReloadPending = false;
+ReloadClock::time_point shaderReloadStart;
+double shaderSwapMs = 0.0;
+
+// Simulation and rendering run on separate threads (--sim-thread off runs
+// them one after the other on the main thread). The simulation thread owns
+// the scene, the camera position and the sculpture solvers and steps them on
+// the fixed clock, publishing a FrameSnapshot after each update; the GL
+// thread draws the newest snapshot, interpolated between its last two steps.
+// GLFW input can only be read on the main thread, so processInput() samples
+// what the simulation needs into SimInput.
+bool simulationThreaded = true;
+
+struct SimInput {
+    bool forward = false, back = false, left = false, right = false;
+    unsigned int spinPresses = 0;       // SPACE presses so far
+    unsigned int pickPresses = 0;       // P presses so far
+    bool brighter = false, dimmer = false;
+    bool grow = false, shrink = false;
+    bool sunRight = false, sunLeft = false, sunUp = false, sunDown = false;
+    glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
+    ReloadClock::time_point sampled = ReloadClock::now();
+};
+
+// A planet's world matrix and bounding sphere, as drawn this frame
+struct PlanetDraw {
+    glm::mat4 model;
+    glm::vec3 center;
+    float radius;
+    EarthModel* planet;
+};
+
+struct PlanetState {
+    Common::Transform transform;
+    EarthModel* planet;
+};
+
+// Everything one simulation step leaves for drawing
+struct SimState {
+    double time = 0.0;                                  // simulation clock
+    glm::vec3 cameraPos = glm::vec3(0.0f);
+    glm::vec3 lightPos = glm::vec3(0.0f);
+    glm::vec3 lightColor = glm::vec3(0.0f);
+    std::vector<PlanetState> planets;
+    std::vector<float> sculptureAngles;                 // simulated sculpture
+    std::vector<Common::LinkTransform> sculptureRods;   // linked sculpture
+};
+
+// The last two steps, which a frame draws in between; never changed once published
+struct FrameSnapshot {
+    SimState previous;
+    SimState current;
+    int steps = 0;                                      // steps since the last snapshot
+    double solverMs = 0.0;
+    double simulateMs = 0.0;
+    double droppedMs = 0.0;                             // simulation time dropped so far
+    double bvhMs = 0.0;                                 // sculpture BVH upkeep, these steps
+    float bvhDegradation = 1.0f;
+    ReloadClock::time_point inputSampled;               // input the newest step read
+};
+
+Common::TripleBuffer<FrameSnapshot> frames;
+std::mutex inputMutex;
+SimInput simInput;
+
+// Simulation thread only: the steps the next snapshot is built from
+SimState previousStep;
+SimState currentStep;
+
+std::thread simulationThread;
+std::atomic<bool> simulationRunning{false};
+
 // GLTF Model structure
 struct GLTFModel {
     unsigned int VAO, VBO, EBO;
@@ -143,13 +481,14 @@ bool loadGLTFModel(const std::string& gltfPath, GLTFModel& model)
     glGenBuffers(1, &model.VBO);
     glGenBuffers(1, &model.EBO);
     
-    glBindVertexArray(model.VAO);
+    Common::GLStateCache& gl = Common::glState();
+    gl.bindVertexArray(model.VAO);
     
-    glBindBuffer(GL_ARRAY_BUFFER, model.VBO);
+    gl.bindBuffer(GL_ARRAY_BUFFER, model.VBO);
     glBufferData(GL_ARRAY_BUFFER, model.vertices.size() * sizeof(float), 
                  model.vertices.data(), GL_STATIC_DRAW);
     
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model.EBO);
+    gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, model.EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, model.indices.size() * sizeof(unsigned int), 
                  model.indices.data(), GL_STATIC_DRAW);
     
@@ -160,7 +499,7 @@ bool loadGLTFModel(const std::string& gltfPath, GLTFModel& model)
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
     
-    glBindVertexArray(0);
+    gl.bindVertexArray(0);
     
     model.loaded = true;
     std::cout << "Parametric pattern model loaded successfully with " << model.vertices.size()/6 
@@ -169,30 +508,67 @@ bool loadGLTFModel(const std::string& gltfPath, GLTFModel& model)
     return true;
 }
 
-// Function to load shader from file
-std::string loadShaderFromFile(const std::string& filePath)
+// Load the 9 ambient SH irradiance coefficients baked by earth_bake (one "r g b" per line).
+// Falls back to the old flat ambient if the file is missing.
+bool loadAmbientSH(const std::string& filePath, glm::vec3 coeffs[9])
 {
-    std::ifstream shaderFile;
-    shaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    for (int i = 0; i < 9; ++i)
+        coeffs[i] = glm::vec3(i == 0 ? 0.3f : 0.0f);
     
-    try
-    {
-        shaderFile.open(filePath);
-        std::stringstream shaderStream;
-        shaderStream << shaderFile.rdbuf();
-        shaderFile.close();
-        return shaderStream.str();
-    }
-    catch (std::ifstream::failure& e)
-    {
-        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << filePath << std::endl;
-        return "";
+    std::ifstream file(filePath);
+    for (int i = 0; i < 9; ++i) {
+        if (!(file >> coeffs[i].x >> coeffs[i].y >> coeffs[i].z)) {
+            std::cout << "ERROR::AMBIENT_SH::FILE_NOT_SUCCESSFULLY_READ: " << filePath << std::endl;
+            for (int j = 0; j < 9; ++j)
+                coeffs[j] = glm::vec3(j == 0 ? 0.3f : 0.0f);
+            return false;
+        }
     }
+    return true;
+}
+
+// Fraction of the screen covered by a sphere, 0 when it is behind the camera
+float sphereScreenCoverage(const glm::vec3& center, float radius, const glm::mat4& view, float fovY, float aspect)
+{
+    glm::vec3 viewCenter = glm::vec3(view * glm::vec4(center, 1.0f));
+    float distance = glm::length(viewCenter);
+    if (distance <= radius)
+        return 1.0f;
+    if (viewCenter.z > radius)
+        return 0.0f;
+    
+    // Projected radius in NDC (y spans [-1, 1]); the screen is 4 NDC units in area
+    float projected = std::tan(std::asin(radius / distance)) / std::tan(fovY * 0.5f);
+    float coverage = 3.14159265f * projected * projected / aspect / 4.0f;
+    return coverage < 1.0f ? coverage : 1.0f;
+}
+
+// Cube face axes in GL cubemap order (+X, -X, +Y, -Y, +Z, -Z):
+// direction = major + s * right + t * down for s, t in [-1, 1]
+const glm::vec3 cubeFaceMajor[6] = { {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1} };
+const glm::vec3 cubeFaceRight[6] = { {0, 0, -1}, {0, 0, 1}, {1, 0, 0}, {1, 0, 0}, {1, 0, 0}, {-1, 0, 0} };
+const glm::vec3 cubeFaceDown[6]  = { {0, -1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}, {0, -1, 0}, {0, -1, 0} };
+
+// Tangent matching the relief cubemap's face-right axis for a sphere normal
+glm::vec3 cubeFaceTangent(const glm::vec3& n)
+{
+    glm::vec3 a = glm::abs(n);
+    int face;
+    if (a.x >= a.y && a.x >= a.z)
+        face = n.x > 0.0f ? 0 : 1;
+    else if (a.y >= a.z)
+        face = n.y > 0.0f ? 2 : 3;
+    else
+        face = n.z > 0.0f ? 4 : 5;
+    glm::vec3 right = cubeFaceRight[face];
+    return glm::normalize(right - n * glm::dot(n, right));
 }
 
 // Forward declarations
+bool parseEarthModel(const std::string& objPath, std::vector<float>& vertices, std::vector<unsigned int>& indices);
+void uploadEarthMesh(EarthModel& model);
 bool loadEarthModel(const std::string& objPath, EarthModel& model);
-void createFallbackEarth();
+void createCubeSphereEarth();
 unsigned int loadTexture(const char* path);
 void processFaceVertex(const std::string& vertex, std::vector<unsigned int>& posIndices, 
                       std::vector<unsigned int>& texIndices, std::vector<unsigned int>& normIndices);
@@ -201,170 +577,218 @@ void processFaceVertex(const std::string& vertex, std::vector<unsigned int>& pos
 void initializeEarth()
 {
     // Load earth model
-    if (!loadEarthModel("resources/23-earth_photorealistic_2k/Earth 2K.obj", earth)) {
-        std::cout << "Failed to load earth model, creating fallback sphere..." << std::endl;
-        // Create a simple sphere as fallback
-        createFallbackEarth();
+    if (!loadEarthModel(EARTH_MESH_PATH, earth)) {
+        std::cout << "Failed to load earth model, creating cube-sphere..." << std::endl;
+        // Create a cube-sphere matching the cubemap textures
+        createCubeSphereEarth();
     }
     
-    // Load textures
+    // Load cooked cubemap textures (only the mip tail blocks)
     std::cout << "Loading textures..." << std::endl;
-    earth.diffuseTexture = loadTexture("resources/23-earth_photorealistic_2k/Textures/Diffuse_2K.png");
-    earth.cloudsTexture = loadTexture("resources/23-earth_photorealistic_2k/Textures/Clouds_2K.png");
-    earth.nightLightsTexture = loadTexture("resources/23-earth_photorealistic_2k/Textures/Night_lights_2K.png");
+    for (const auto& file : EARTH_TEXTURE_FILES)
+        earth.*file.second = textureStreamer.load(file.first);
     
     // Check if textures loaded successfully
     std::cout << "Diffuse texture ID: " << earth.diffuseTexture << std::endl;
     std::cout << "Clouds texture ID: " << earth.cloudsTexture << std::endl;
     std::cout << "Night lights texture ID: " << earth.nightLightsTexture << std::endl;
+    std::cout << "Relief texture ID: " << earth.reliefTexture << std::endl;
+    std::cout << "Coastline texture ID: " << earth.coastTexture << std::endl;
     
-    if (earth.diffuseTexture == 0 || earth.cloudsTexture == 0 || earth.nightLightsTexture == 0) {
+    if (earth.diffuseTexture == 0 || earth.cloudsTexture == 0 || earth.nightLightsTexture == 0 ||
+        earth.reliefTexture == 0 || earth.coastTexture == 0) {
         std::cout << "ERROR: Some textures failed to load!" << std::endl;
     } else {
         std::cout << "All textures loaded successfully!" << std::endl;
     }
 }
 
-// Create a proper sphere for Earth
-void createFallbackEarth()
+// Create a cube-sphere for Earth: six subdivided cube faces pushed onto the
+// unit sphere, so vertex density follows the cubemap texel layout
+void createCubeSphereEarth()
 {
     std::vector<float> vertices;
     std::vector<unsigned int> indices;
     
-    int segments = 64;  // More segments for better quality
-    int rings = 32;     // More rings for better quality
+    const int subdivisions = 32;  // Quads per face edge
     
-    for (int i = 0; i <= rings; ++i) {
-        float phi = M_PI * i / rings;
-        for (int j = 0; j <= segments; ++j) {
-            float theta = 2.0f * M_PI * j / segments;
-            
-            float x = cos(theta) * sin(phi);
-            float y = cos(phi);
-            float z = sin(theta) * sin(phi);
-            
-            // Position
-            vertices.push_back(x);
-            vertices.push_back(y);
-            vertices.push_back(z);
-            
-            // UV coordinates for equirectangular mapping
-            // Convert spherical to UV coordinates
-            float u = 0.5f + atan2(z, x) / (2.0f * M_PI);
-            float v = 0.5f - asin(y) / M_PI;
-            
-            // Ensure UV coordinates are in [0, 1] range
-            u = fmod(u + 1.0f, 1.0f);
-            v = glm::clamp(v, 0.0f, 1.0f);
-            
-            vertices.push_back(u);
-            vertices.push_back(v);
-            
-            // Normal
-            vertices.push_back(x);
-            vertices.push_back(y);
-            vertices.push_back(z);
+    for (int face = 0; face < 6; ++face) {
+        unsigned int base = vertices.size() / 11;
+        for (int j = 0; j <= subdivisions; ++j) {
+            for (int i = 0; i <= subdivisions; ++i) {
+                // Tangent warp evens out vertex spacing on the sphere
+                float a = 2.0f * i / subdivisions - 1.0f;
+                float b = 2.0f * j / subdivisions - 1.0f;
+                float s = tan(a * M_PI / 4.0f);
+                float t = tan(b * M_PI / 4.0f);
+                
+                glm::vec3 p = glm::normalize(cubeFaceMajor[face] + s * cubeFaceRight[face] + t * cubeFaceDown[face]);
+                glm::vec3 tangent = glm::normalize(cubeFaceRight[face] - p * glm::dot(p, cubeFaceRight[face]));
+                
+                // Position
+                vertices.push_back(p.x);
+                vertices.push_back(p.y);
+                vertices.push_back(p.z);
+                
+                // Face-local UV (cubemap sampling uses the position instead)
+                vertices.push_back(0.5f * (s + 1.0f));
+                vertices.push_back(0.5f * (t + 1.0f));
+                
+                // Normal
+                vertices.push_back(p.x);
+                vertices.push_back(p.y);
+                vertices.push_back(p.z);
+                
+                // Tangent (face right axis)
+                vertices.push_back(tangent.x);
+                vertices.push_back(tangent.y);
+                vertices.push_back(tangent.z);
+            }
+        }
+        
+        for (int j = 0; j < subdivisions; ++j) {
+            for (int i = 0; i < subdivisions; ++i) {
+                unsigned int current = base + j * (subdivisions + 1) + i;
+                unsigned int next = current + subdivisions + 1;
+                
+                indices.push_back(current);
+                indices.push_back(current + 1);
+                indices.push_back(next);
+                
+                indices.push_back(current + 1);
+                indices.push_back(next + 1);
+                indices.push_back(next);
+            }
         }
     }
     
-    for (int i = 0; i < rings; ++i) {
-        for (int j = 0; j < segments; ++j) {
-            int current = i * (segments + 1) + j;
-            int next = current + segments + 1;
-            
-            indices.push_back(current);
-            indices.push_back(next);
-            indices.push_back(current + 1);
-            
-            indices.push_back(current + 1);
-            indices.push_back(next);
-            indices.push_back(next + 1);
-        }
+    earth.vertices = vertices;
+    earth.indices = indices;
+    uploadEarthMesh(earth);
+}
+
+// True on the frame a key goes down, not on every frame it is held
+bool keyPressed(GLFWwindow* window, int key)
+{
+    static bool down[GLFW_KEY_LAST + 1] = {};
+    bool pressed = glfwGetKey(window, key) == GLFW_PRESS;
+    bool edge = pressed && !down[key];
+    down[key] = pressed;
+    return edge;
+}
+
+// Process input on the main thread: display toggles apply here, movement and
+// the scene controls go to the simulation
+void processInput(GLFWwindow* window)
+{
+    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+    
+    if (glfwGetKey(window, GLFW_KEY_TAB) == GLFW_PRESS) {
+        showWireframe = !showWireframe;
     }
     
-    // Create OpenGL buffers
-    glGenVertexArrays(1, &earth.VAO);
-    glGenBuffers(1, &earth.VBO);
-    glGenBuffers(1, &earth.EBO);
+    if (keyPressed(window, GLFW_KEY_B)) {
+        reliefEnabled = !reliefEnabled;
+    }
     
-    glBindVertexArray(earth.VAO);
+    if (keyPressed(window, GLFW_KEY_N)) {
+        nightLightsEnabled = !nightLightsEnabled;
+    }
+    
+    if (keyPressed(window, GLFW_KEY_C)) {
+        cloudsEnabled = !cloudsEnabled;
+    }
     
-    glBindBuffer(GL_ARRAY_BUFFER, earth.VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    if (keyPressed(window, GLFW_KEY_K)) {
+        sculptureVisible = !sculptureVisible;
+    }
     
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, earth.EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    SimInput input;
+    input.forward = glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS;
+    input.back = glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS;
+    input.left = glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS;
+    input.right = glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS;
     
-    // Position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    // Texture coordinate attribute
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    // Normal attribute
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float)));
-    glEnableVertexAttribArray(2);
+    // SPACE and P are counted per press, not sampled: the simulation may
+    // step several times per frame, or not at all
+    static unsigned int spinPresses = 0;
+    if (keyPressed(window, GLFW_KEY_SPACE))
+        spinPresses++;
+    input.spinPresses = spinPresses;
+    static unsigned int pickPresses = 0;
+    if (keyPressed(window, GLFW_KEY_P))
+        pickPresses++;
+    input.pickPresses = pickPresses;
     
-    glBindVertexArray(0);
+    input.brighter = glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS;
+    input.dimmer = glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS;
+    input.grow = glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+    input.shrink = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
+    input.sunRight = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+    input.sunLeft = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+    input.sunUp = glfwGetKey(window, GLFW_KEY_Y) == GLFW_PRESS;
+    input.sunDown = glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS;
+    input.cameraFront = cameraFront;
+    input.sampled = ReloadClock::now();
     
-    earth.vertices = vertices;
-    earth.indices = indices;
-    earth.loaded = true;
+    std::lock_guard<std::mutex> lock(inputMutex);
+    simInput = input;
 }
 
-// Process input
-void processInput(GLFWwindow* window)
+// Camera movement and the scene controls for one step of dt seconds, on the
+// simulation thread
+void applyInput(const SimInput& input, float dt)
 {
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-        glfwSetWindowShouldClose(window, true);
-
-    const float cameraSpeed = 2.5f * deltaTime;
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        cameraPos += cameraSpeed * cameraFront;
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        cameraPos -= cameraSpeed * cameraFront;
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        cameraPos -= glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
+    const float cameraSpeed = 2.5f * dt;
+    if (input.forward)
+        cameraPos += cameraSpeed * input.cameraFront;
+    if (input.back)
+        cameraPos -= cameraSpeed * input.cameraFront;
+    if (input.left)
+        cameraPos -= glm::normalize(glm::cross(input.cameraFront, cameraUp)) * cameraSpeed;
+    if (input.right)
+        cameraPos += glm::normalize(glm::cross(input.cameraFront, cameraUp)) * cameraSpeed;
     
     // Earth controls
-    if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) {
-        isRotating = !isRotating;
-    }
-    
-    if (glfwGetKey(window, GLFW_KEY_TAB) == GLFW_PRESS) {
-        showWireframe = !showWireframe;
+    Common::Transform& earthTransform = *scene.get<Common::Transform>(earthEntity);
+    Common::Spin& earthSpin = *scene.get<Common::Spin>(earthEntity);
+    Common::Transform& sunTransform = *scene.get<Common::Transform>(sunEntity);
+    Common::Light& sunLight = *scene.get<Common::Light>(sunEntity);
+    static unsigned int spinPressesSeen = 0;
+    if ((input.spinPresses - spinPressesSeen) % 2 == 1) {
+        earthSpin.enabled = !earthSpin.enabled;
     }
+    spinPressesSeen = input.spinPresses;
     
     // Adjust light intensity
-    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) {
-        lightIntensity = glm::clamp(lightIntensity + deltaTime, 0.1f, 3.0f);
+    if (input.brighter) {
+        sunLight.intensity = glm::clamp(sunLight.intensity + dt, 0.1f, 3.0f);
     }
-    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) {
-        lightIntensity = glm::clamp(lightIntensity - deltaTime, 0.1f, 3.0f);
+    if (input.dimmer) {
+        sunLight.intensity = glm::clamp(sunLight.intensity - dt, 0.1f, 3.0f);
     }
     
     // Adjust earth size
-    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) {
-        earthScale = glm::clamp(earthScale + deltaTime, 0.5f, 3.0f);
+    if (input.grow) {
+        earthTransform.scale = glm::clamp(earthTransform.scale + dt, 0.5f, 3.0f);
     }
-    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS) {
-        earthScale = glm::clamp(earthScale - deltaTime, 0.5f, 3.0f);
+    if (input.shrink) {
+        earthTransform.scale = glm::clamp(earthTransform.scale - dt, 0.5f, 3.0f);
     }
     
     // Adjust sun position
-    if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS) {
-        sunPosition.x += deltaTime * 2.0f;
+    if (input.sunRight) {
+        sunTransform.position.x += dt * 2.0f;
     }
-    if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS) {
-        sunPosition.x -= deltaTime * 2.0f;
+    if (input.sunLeft) {
+        sunTransform.position.x -= dt * 2.0f;
     }
-    if (glfwGetKey(window, GLFW_KEY_Y) == GLFW_PRESS) {
-        sunPosition.y += deltaTime * 2.0f;
+    if (input.sunUp) {
+        sunTransform.position.y += dt * 2.0f;
     }
-    if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS) {
-        sunPosition.y -= deltaTime * 2.0f;
+    if (input.sunDown) {
+        sunTransform.position.y -= dt * 2.0f;
     }
 }
 
@@ -429,7 +853,7 @@ unsigned int loadTexture(const char* path)
 {
     unsigned int textureID;
     glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
+    Common::glState().bindTexture(GL_TEXTURE_2D, textureID);
     
     // Set texture parameters
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -497,8 +921,9 @@ void processFaceVertex(const std::string& vertex, std::vector<unsigned int>& pos
     }
 }
 
-// Function to load OBJ model
-bool loadEarthModel(const std::string& objPath, EarthModel& model)
+// Parse an OBJ into the interleaved Earth vertex layout. Touches no GL state,
+// so hot reloads run it on a background thread.
+bool parseEarthModel(const std::string& objPath, std::vector<float>& vertices, std::vector<unsigned int>& indices)
 {
     std::ifstream file(objPath);
     if (!file.is_open()) {
@@ -566,21 +991,21 @@ bool loadEarthModel(const std::string& objPath, EarthModel& model)
               << normIndices.size() << " norm" << std::endl;
     
     // Create vertices array
-    model.vertices.clear();
-    model.indices.clear();
+    vertices.clear();
+    indices.clear();
     
     for (size_t i = 0; i < posIndices.size(); i++) {
         // Position
         glm::vec3 pos = positions[posIndices[i]];
-        model.vertices.push_back(pos.x);
-        model.vertices.push_back(pos.y);
-        model.vertices.push_back(pos.z);
+        vertices.push_back(pos.x);
+        vertices.push_back(pos.y);
+        vertices.push_back(pos.z);
         
         // Texture coordinates
         if (i < texIndices.size() && texIndices[i] < texCoords.size()) {
             glm::vec2 tex = texCoords[texIndices[i]];
-            model.vertices.push_back(tex.x);
-            model.vertices.push_back(tex.y);
+            vertices.push_back(tex.x);
+            vertices.push_back(tex.y);
         } else {
             // Fallback UV coordinates if not available in OBJ
             glm::vec3 unit = glm::normalize(pos);
@@ -588,61 +1013,382 @@ bool loadEarthModel(const std::string& objPath, EarthModel& model)
             float v = 0.5f - asin(unit.y) / M_PI;
             u = fmod(u + 1.0f, 1.0f);
             v = glm::clamp(v, 0.0f, 1.0f);
-            model.vertices.push_back(u);
-            model.vertices.push_back(v);
+            vertices.push_back(u);
+            vertices.push_back(v);
         }
         
         // Normal
         if (i < normIndices.size() && normIndices[i] < normals.size()) {
             glm::vec3 norm = normals[normIndices[i]];
-            model.vertices.push_back(norm.x);
-            model.vertices.push_back(norm.y);
-            model.vertices.push_back(norm.z);
+            vertices.push_back(norm.x);
+            vertices.push_back(norm.y);
+            vertices.push_back(norm.z);
         } else {
-            model.vertices.push_back(0.0f);
-            model.vertices.push_back(0.0f);
-            model.vertices.push_back(1.0f);
+            vertices.push_back(0.0f);
+            vertices.push_back(0.0f);
+            vertices.push_back(1.0f);
         }
         
-        model.indices.push_back(i);
+        // Tangent
+        glm::vec3 tangent = cubeFaceTangent(glm::normalize(pos));
+        vertices.push_back(tangent.x);
+        vertices.push_back(tangent.y);
+        vertices.push_back(tangent.z);
+        
+        indices.push_back(i);
     }
     
-    // Create OpenGL buffers
-    glGenVertexArrays(1, &model.VAO);
-    glGenBuffers(1, &model.VBO);
-    glGenBuffers(1, &model.EBO);
+    return true;
+}
+
+// Copy the Earth's vertices and indices into the static mesh arena. A
+// reloaded mesh replaces the previous allocation, whose space is reused.
+void uploadEarthMesh(EarthModel& model)
+{
+    staticMeshes.free(model.mesh);
+    model.mesh = staticMeshes.upload(model.vertices.data(), model.vertices.size() / 11,
+                                     model.indices.data(), model.indices.size());
+    model.loaded = model.mesh != Common::GeometryArena::INVALID_MESH;
+}
+
+// Function to load OBJ model
+bool loadEarthModel(const std::string& objPath, EarthModel& model)
+{
+    if (!parseEarthModel(objPath, model.vertices, model.indices))
+        return false;
     
-    glBindVertexArray(model.VAO);
+    uploadEarthMesh(model);
+    if (!model.loaded)
+        return false;
+    std::cout << "Earth model loaded successfully with " << model.vertices.size()/11 
+              << " vertices and " << model.indices.size() << " indices" << std::endl;
     
-    glBindBuffer(GL_ARRAY_BUFFER, model.VBO);
-    glBufferData(GL_ARRAY_BUFFER, model.vertices.size() * sizeof(float), 
-                 model.vertices.data(), GL_STATIC_DRAW);
+    return true;
+}
+
+double msSince(ReloadClock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(ReloadClock::now() - start).count();
+}
+
+void reportReload(const std::string& what, ReloadClock::time_point start, double swapMs)
+{
+    std::cout << "Reloaded " << what << " in " << msSince(start) << " ms ("
+              << swapMs << " ms swap on the render thread)" << std::endl;
+}
+
+void beginMeshReload()
+{
+    meshReloadStart = ReloadClock::now();
+    meshReload = std::async(std::launch::async, [] {
+        return parseEarthModel(EARTH_MESH_PATH, reloadedVertices, reloadedIndices);
+    });
+}
+
+// Start rebuilding whatever the changed file feeds
+void beginReload(const std::string& path)
+{
+    bool shaderFile = false;
+    for (Common::ShaderPermutations* shaders : { &earthShaders, &sculptureShaders }) {
+        const std::vector<std::string>& shaderFiles = shaders->files();
+        if (std::find(shaderFiles.begin(), shaderFiles.end(), path) == shaderFiles.end())
+            continue;
+        // Every variant recompiles on the driver's threads; the old programs
+        // keep drawing until update() swaps each one in
+        ReloadClock::time_point start = ReloadClock::now();
+        if (!shaders->reload()) {
+            std::cout << "ERROR::HOT_RELOAD::SHADER_NOT_READ: " << path << std::endl;
+            continue;
+        }
+        if (!shaderReloadPending) {
+            shaderReloadStart = start;
+            shaderSwapMs = 0.0;
+        }
+        shaderReloadPending = true;
+        shaderSwapMs += msSince(start);
+        shaderFile = true;
+    }
+    if (shaderFile)
+        return;
     
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model.EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, model.indices.size() * sizeof(unsigned int), 
-                 model.indices.data(), GL_STATIC_DRAW);
+    for (const auto& file : EARTH_TEXTURE_FILES) {
+        if (path != file.first)
+            continue;
+        // Only the mip tail is read here; finer levels stream on the loader thread
+        ReloadClock::time_point start = ReloadClock::now();
+        unsigned int replacement = textureStreamer.load(path);
+        if (!replacement) {
+            std::cout << "ERROR::HOT_RELOAD::TEXTURE_NOT_LOADED: " << path << std::endl;
+            return;
+        }
+        // A newer save supersedes a replacement that is still streaming in
+        for (size_t i = 0; i < textureReloads.size(); ++i) {
+            if (textureReloads[i].slot == file.second) {
+                textureStreamer.unload(textureReloads[i].replacement);
+                textureReloads.erase(textureReloads.begin() + i);
+                break;
+            }
+        }
+        textureReloads.push_back({ path, file.second, replacement, start, msSince(start) });
+        return;
+    }
     
-    // Position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    // Texture coordinate attribute
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    // Normal attribute
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float)));
-    glEnableVertexAttribArray(2);
+    if (path == EARTH_MESH_PATH) {
+        if (meshReload.valid())
+            meshReloadQueued = true;
+        else
+            beginMeshReload();
+    }
+}
+
+// Swap in replacement textures once they are at least as sharp as what they
+// replace (or the streamer has nothing left to load within its budget)
+void finishTextureReloads()
+{
+    for (size_t i = 0; i < textureReloads.size();) {
+        TextureReload& reload = textureReloads[i];
+        unsigned int& slot = earth.*reload.slot;
+        int current = textureStreamer.residentLevel(slot);
+        if (current >= 0 && textureStreamer.residentLevel(reload.replacement) > current &&
+            !textureStreamer.fullyResident()) {
+            ++i;
+            continue;
+        }
+        ReloadClock::time_point start = ReloadClock::now();
+        textureStreamer.unload(slot);
+        slot = reload.replacement;
+        reportReload(reload.path, reload.start, reload.swapMs + msSince(start));
+        textureReloads.erase(textureReloads.begin() + i);
+    }
+}
+
+// Upload a mesh the background parse has finished
+void finishMeshReload()
+{
+    if (!meshReload.valid() || meshReload.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return;
     
-    glBindVertexArray(0);
+    if (meshReload.get()) {
+        ReloadClock::time_point start = ReloadClock::now();
+        earth.vertices.swap(reloadedVertices);
+        earth.indices.swap(reloadedIndices);
+        uploadEarthMesh(earth);
+        reportReload(EARTH_MESH_PATH, meshReloadStart, msSince(start));
+    } else {
+        std::cout << "ERROR::HOT_RELOAD::MESH_NOT_PARSED: keeping the current mesh" << std::endl;
+    }
+    if (meshReloadQueued) {
+        meshReloadQueued = false;
+        beginMeshReload();
+    }
+}
+
+// Box each rod, padded by its radius, and bring the BVH up to date with them
+void updateSculptureBvh(const std::vector<Common::LinkTransform>& rods)
+{
+    ReloadClock::time_point start = ReloadClock::now();
+    const glm::vec3 pad(LINKAGE_ROD_RADIUS);
+    sculptureRodBounds.resize(rods.size());
+    for (size_t i = 0; i < rods.size(); ++i) {
+        sculptureRodBounds[i].min = glm::min(rods[i].pivot, rods[i].tip) - pad;
+        sculptureRodBounds[i].max = glm::max(rods[i].pivot, rods[i].tip) + pad;
+    }
     
-    model.loaded = true;
-    std::cout << "Earth model loaded successfully with " << model.vertices.size()/8 
-              << " vertices and " << model.indices.size() << " indices" << std::endl;
+    if (sculptureBvh.size() != rods.size())
+        sculptureBvh.build(sculptureRodBounds.data(), sculptureRodBounds.size());
+    else if (!sculptureBvh.finishRebuild(sculptureRodBounds.data()))
+        sculptureBvh.refit(sculptureRodBounds.data());
+    if (!sculptureBvh.rebuilding() && sculptureBvh.degradation() > BVH_REBUILD_COST)
+        sculptureBvh.beginRebuild(sculptureRodBounds.data());
+    sculptureBvhMs += msSince(start);
+}
+
+// Print the rod whose box the camera looks at first
+void pickSculptureRod(const glm::vec3& origin, const glm::vec3& direction)
+{
+    const glm::mat4 toSculpture = glm::inverse(sculptureModel());
+    glm::vec3 localOrigin = glm::vec3(toSculpture * glm::vec4(origin, 1.0f));
+    glm::vec3 localDirection = glm::vec3(toSculpture * glm::vec4(direction, 0.0f));
+    uint32_t rod = 0;
+    float distance = 0.0f;
+    if (sculptureBvh.raycast(localOrigin, localDirection, FAR_PLANE, rod, distance))
+        std::cout << "Picked chain " << rod / sculptureLinks << ", link " << rod % sculptureLinks << " at "
+                  << distance << std::endl;
+    else
+        std::cout << "Picked nothing" << std::endl;
+}
+
+// One fixed step of dt seconds at simulationClock: input, the scene systems
+// and the sculpture solvers, with what a frame draws written into state.
+// Returns the solvers' time in ms.
+double stepSimulation(const SimInput& input, float dt, SimState& state)
+{
+    const float time = (float)simulationClock;
+    applyInput(input, dt);
+    Common::updateSpin(scene, time);
+    Common::updateWorldMatrices(scene);
+    
+    state.time = simulationClock;
+    state.cameraPos = cameraPos;
+    const Common::Transform& sunTransform = *scene.get<Common::Transform>(sunEntity);
+    const Common::Light& sunLight = *scene.get<Common::Light>(sunEntity);
+    state.lightPos = sunTransform.position;
+    state.lightColor = sunLight.color * sunLight.intensity;
+    state.planets.clear();
+    scene.each<Common::Transform, Planet>([&](size_t count, Common::Transform* transforms, Planet* planets) {
+        for (size_t i = 0; i < count; ++i)
+            state.planets.push_back({ transforms[i], planets[i].model });
+    });
+    
+    // The solvers write straight into the state; the GL thread uploads it
+    ReloadClock::time_point solverStart = ReloadClock::now();
+    if (sculpture.simulated()) {
+        state.sculptureAngles.resize(sculptureSolver.size());
+        sculptureSolver.step(dt, state.sculptureAngles.data());
+    }
+    if (sculpture.linked()) {
+        driveSculptureLinkage(time);
+        sculptureLinkage.step(dt, LINKAGE_ITERATIONS);
+        state.sculptureRods.resize(sculptureAnchors.size() * sculptureLinks);
+        Common::writeChainTransforms(sculptureLinkage, sculptureAnchors.size(), sculptureLinks,
+                                     state.sculptureRods.data());
+    }
+    double solverMs = msSince(solverStart);
     
+    static unsigned int pickPressesSeen = 0;
+    if (sculpture.linked()) {
+        updateSculptureBvh(state.sculptureRods);
+        if (input.pickPresses != pickPressesSeen)
+            pickSculptureRod(cameraPos, input.cameraFront);
+    }
+    pickPressesSeen = input.pickPresses;
+    return solverMs;
+}
+
+// Step the simulation clock up to wall time with the newest input and copy
+// the last two steps into snapshot. False, leaving snapshot alone, if no
+// step was due yet.
+bool simulate(FrameSnapshot& snapshot)
+{
+    ReloadClock::time_point start = ReloadClock::now();
+    const double step = 1.0 / simulationRate;
+    const double now = glfwGetTime();
+    if (now - simulationClock > MAX_CATCH_UP_STEPS * step) {
+        droppedSimulationMs += (now - simulationClock - MAX_CATCH_UP_STEPS * step) * 1000.0;
+        simulationClock = now - MAX_CATCH_UP_STEPS * step;
+    }
+    if (simulationClock + step > now)
+        return false;
+    
+    SimInput input;
+    {
+        std::lock_guard<std::mutex> lock(inputMutex);
+        input = simInput;
+    }
+    snapshot.steps = 0;
+    snapshot.solverMs = 0.0;
+    while (simulationClock + step <= now) {
+        simulationClock += step;
+        std::swap(previousStep, currentStep);
+        snapshot.solverMs += stepSimulation(input, (float)step, currentStep);
+        snapshot.steps++;
+    }
+    snapshot.previous = previousStep;
+    snapshot.current = currentStep;
+    snapshot.droppedMs = droppedSimulationMs;
+    snapshot.bvhMs = sculptureBvhMs;
+    snapshot.bvhDegradation = sculptureBvh.degradation();
+    sculptureBvhMs = 0.0;
+    snapshot.inputSampled = input.sampled;
+    snapshot.simulateMs = msSince(start);
     return true;
 }
 
-int main()
+// The first step, taken twice over so the first frame has two to draw between
+void startSimulation()
+{
+    simulationClock = glfwGetTime();
+    FrameSnapshot& snapshot = frames.back();
+    snapshot.solverMs = stepSimulation(simInput, (float)(1.0 / simulationRate), currentStep);
+    previousStep = currentStep;
+    snapshot.previous = previousStep;
+    snapshot.current = currentStep;
+    snapshot.steps = 1;
+    snapshot.inputSampled = simInput.sampled;
+    frames.publish();
+}
+
+// Simulation thread: sleep until the next step is due, take every step that
+// is, and publish
+void simulationLoop()
+{
+    while (simulationRunning.load(std::memory_order_relaxed)) {
+        if (simulate(frames.back())) {
+            frames.publish();
+            continue;
+        }
+        double wait = simulationClock + 1.0 / simulationRate - glfwGetTime();
+        if (wait > 0.0)
+            std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+    }
+}
+
+int main(int argc, char** argv)
 {
+    // The main thread owns the job system's non-worker deque, claimed before
+    // the simulation thread or any loader can reach the scheduler first
+    Common::attachMainThread();
+    
+    auto launchTime = std::chrono::steady_clock::now();
+    auto msSinceLaunch = [&]() {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - launchTime).count();
+    };
+    
+    // Optional window size, e.g. --resolution 1920x1080 to profile the Earth pass,
+    // texture memory budget in MiB, e.g. --texture-budget 32, and driver shader
+    // compile threads, e.g. --compile-threads 1 (needs KHR_parallel_shader_compile),
+    // and the sculpture's element count and shape; --sim-thread off simulates
+    // on the main thread between frames, --sim-rate 60 steps it at 60 Hz, and
+    // --occlusion off draws every linked rod in view
+    int compileThreads = -1;
+    Common::Integrator integrator = Common::Integrator::SemiImplicitEuler;
+    for (int i = 1; i + 1 < argc; ++i) {
+        unsigned int w, h, budget, threads, elements, links, rate;
+        if (std::string(argv[i]) == "--resolution" && sscanf(argv[i + 1], "%ux%u", &w, &h) == 2) {
+            SCR_WIDTH = w;
+            SCR_HEIGHT = h;
+        }
+        if (std::string(argv[i]) == "--texture-budget" && sscanf(argv[i + 1], "%u", &budget) == 1)
+            textureStreamer.setBudget((size_t)budget << 20);
+        if (std::string(argv[i]) == "--compile-threads" && sscanf(argv[i + 1], "%u", &threads) == 1)
+            compileThreads = (int)threads;
+        if (std::string(argv[i]) == "--sculpture-elements" && sscanf(argv[i + 1], "%u", &elements) == 1)
+            sculptureElements = elements;
+        if (std::string(argv[i]) == "--sculpture-sim") {
+            std::string method = argv[i + 1];
+            sculptureLinked = method == "linkage";
+            sculptureSimulated = !sculptureLinked;
+            integrator = method == "verlet" ? Common::Integrator::Verlet : Common::Integrator::SemiImplicitEuler;
+        }
+        if (std::string(argv[i]) == "--sim-thread")
+            simulationThreaded = std::string(argv[i + 1]) != "off";
+        if (std::string(argv[i]) == "--occlusion")
+            occlusionEnabled = std::string(argv[i + 1]) != "off";
+        if (std::string(argv[i]) == "--sim-rate" && sscanf(argv[i + 1], "%u", &rate) == 1 && rate > 0)
+            simulationRate = rate;
+        if (std::string(argv[i]) == "--sculpture-links" && sscanf(argv[i + 1], "%u", &links) == 1 && links > 0)
+            sculptureLinks = links;
+        if (std::string(argv[i]) == "--sculpture-shape") {
+            std::string shape = argv[i + 1];
+            if (shape == "rod")
+                sculptureShape = Common::ElementShape::Rod;
+            else if (shape == "sphere")
+                sculptureShape = Common::ElementShape::Sphere;
+            else
+                sculptureShape = Common::ElementShape::Vane;
+        }
+    }
+    
     // Initialize GLFW
     if (!glfwInit()) {
         std::cout << "Failed to initialize GLFW" << std::endl;
@@ -682,163 +1428,544 @@ int main()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    if (compileThreads >= 0 && !Common::setShaderCompilerThreads((unsigned int)compileThreads))
+        std::cout << "KHR_parallel_shader_compile not supported; --compile-threads ignored" << std::endl;
 
-    // Configure global OpenGL state
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    // Configure global OpenGL state; all binds and state changes go through the
+    // state cache, which skips calls that would not change anything
+    Common::GLStateCache& gl = Common::glState();
+    gl.enable(GL_DEPTH_TEST);
+    gl.enable(GL_BLEND);
+    gl.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    gl.enable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
     // Initialize earth model
+    staticMeshes.create();
     initializeEarth();
+    createScene(sculptureElements);
+    std::vector<Common::SculptureInstance> elements = gatherSculptureElements();
+    if (sculptureLinked && !elements.empty()) {
+        setupSculptureLinkage(elements);
+        if (sculpture.createLinked(elements.size() * sculptureLinks, LINKAGE_LINK_LENGTH))
+            std::cout << "Kinetic sculpture: " << elements.size() << " chains of " << sculptureLinks << " rods, "
+                      << sculptureLinkage.constraintCount() << " constraints solved on the CPU" << std::endl;
+    } else if (sculpture.create(sculptureShape, elements,
+                                Common::elementSpacing(elements.size(), Common::SculptureLayout()),
+                                sculptureSimulated)) {
+        std::cout << "Kinetic sculpture: " << sculpture.instanceCount() << " elements, "
+                  << sculpture.indexCount() / 3 << " triangles each"
+                  << (sculptureSimulated ? ", simulated on the CPU" : "") << std::endl;
+        if (sculptureSimulated)
+            setupSculptureSolver(integrator, elements);
+    }
+    std::cout << "Scene: " << scene.size() << " entities in " << scene.archetypeCount() << " archetypes" << std::endl;
 
-    // Load and compile shader program
-    std::string vertexShaderSource = loadShaderFromFile("resources/vs/kinetic_sculpture.vs");
-    std::string fragmentShaderSource = loadShaderFromFile("resources/fs/kinetic_sculpture.fs");
+    // Ambient SH never changes, so it is set once per variant as it links
+    glm::vec3 ambientSH[9];
+    loadAmbientSH("resources/cooked/earth_sh.txt", ambientSH);
+    
+    // Sampler units and constants are fixed per program too
+    earthShaders.setLinkCallback([&](const Common::ShaderPermutations::Variant& variant) {
+        glUniform1i(variant.uniforms.location(U_DIFFUSE_TEX), 0);
+        glUniform1i(variant.uniforms.location(U_CLOUDS_TEX), 1);
+        glUniform1i(variant.uniforms.location(U_NIGHT_TEX), 2);
+        glUniform1i(variant.uniforms.location(U_RELIEF_TEX), 3);
+        glUniform1i(variant.uniforms.location(U_COAST_TEX), 4);
+        glUniform1f(variant.uniforms.location(U_RELIEF_DEPTH), reliefDepth);
+        glUniform3fv(variant.uniforms.location(U_AMBIENT_SH), 9, glm::value_ptr(ambientSH[0]));
+    });
     
-    if (vertexShaderSource.empty() || fragmentShaderSource.empty())
+    // Link the plain variant now so there is always something to draw, then
+    // submit every variant the layer toggles can reach. They compile on the
+    // driver's threads while frames render with the best finished subset.
+    // Compiled once per driver; later launches load the cached program binaries.
+    if (!earthShaders.load())
     {
         std::cout << "Failed to load shader files" << std::endl;
         return -1;
     }
-    
-    const char* vertexShaderCode = vertexShaderSource.c_str();
-    const char* fragmentShaderCode = fragmentShaderSource.c_str();
-    
-    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderCode, NULL);
-    glCompileShader(vertexShader);
-
-    int success;
-    char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-    }
-
-    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderCode, NULL);
-    glCompileShader(fragmentShader);
-
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success)
+    double shaderStart = msSinceLaunch();
+    if (!earthShaders.warmUp({ EARTH_INSTANCED }))
     {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+        std::cout << "Failed to build shader variants" << std::endl;
+        return -1;
     }
-
-    unsigned int shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success)
+    std::cout << "Fallback shader ready in " << msSinceLaunch() - shaderStart << " ms" << std::endl;
+    if (!sculptureShaders.load() || !sculptureShaders.warmUp({ sculptureFeatures() }))
     {
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+        std::cout << "Failed to build the sculpture shader" << std::endl;
+        return -1;
     }
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    std::vector<uint32_t> earthVariants;
+    for (uint32_t layers = 0; layers <= EARTH_ALL_LAYERS; ++layers)
+        earthVariants.push_back(EARTH_INSTANCED | layers);
+    earthShaders.submit(earthVariants);
+    bool shadersReported = false;
+    frameUniforms.create(Common::FRAME_BLOCK_BINDING);
+    objectUniforms.create(Common::OBJECT_BLOCK_BINDING);
 
     // Enable texture loading
     stbi_set_flip_vertically_on_load(true);
 
+    // GPU timer for the Earth draw, reported every couple of seconds
+    unsigned int earthTimerQuery;
+    glGenQueries(1, &earthTimerQuery);
+    bool earthTimerPending = false;
+    double earthGpuMs = 0.0;
+    int earthGpuSamples = 0;
+    double solverMs = 0.0;
+    int solverSteps = 0;
+    double bvhMs = 0.0;
+    float bvhDegradation = 1.0f;
+    float lastTimerReport = 0.0f;
+    
+    // CPU time of a frame on the GL thread (up to the swap), time per
+    // simulation step, and input-to-present latency: for the scene, from when
+    // the simulated input was read, and for the mouse look, from the poll
+    double frameCpuMs = 0.0;
+    double simulateMs = 0.0;
+    double sceneLatencyMs = 0.0;
+    double lookLatencyMs = 0.0;
+    int frameSamples = 0;
+    int simulateSteps = 0;
+    double droppedMs = 0.0;
+    float lastFrameReport = (float)glfwGetTime();
+    
+    bool firstFrameReported = false;
+    bool fullResolutionReported = false;
+    
+    // Watch every file the Earth is built from (the mesh may not exist yet)
+    Common::FileWatcher assetWatcher;
+    for (const std::string& file : earthShaders.files())
+        assetWatcher.watch(file);
+    for (const std::string& file : sculptureShaders.files())
+        assetWatcher.watch(file);
+    for (const auto& file : EARTH_TEXTURE_FILES)
+        assetWatcher.watch(file.first);
+    assetWatcher.watch(EARTH_MESH_PATH);
+
+    std::vector<PlanetDraw> planets;
+    Common::CullingSet planetBounds;
+    std::vector<uint32_t> visiblePlanets;
+    
+    // Linked sculpture rods as drawn this frame and their boxes, in
+    // sculpture space, and the rods left to draw after culling
+    std::vector<Common::LinkTransform> sculptureRods;
+    std::vector<Common::Aabb> rodBounds;
+    Common::CullingSet rodCulling;
+    std::vector<uint32_t> visibleRods;
+    Common::OcclusionBuffer occlusion;
+    occlusion.resize(OCCLUSION_WIDTH, OCCLUSION_HEIGHT);
+    std::vector<glm::vec3> occluderVertices;
+    std::vector<uint32_t> occluderIndices;
+    Common::buildOccluderSphere(OCCLUDER_SEGMENTS, occluderVertices, occluderIndices);
+    double occlusionMs = 0.0;
+    size_t rodsInView = 0, rodsOccluded = 0;
+    int occlusionFrames = 0;
+    double cullingMs = 0.0;
+    size_t culledObjects = 0, objectsInView = 0;
+    int cullingFrames = 0;
+    
+    // The first step is taken here, so the first frame has one
+    startSimulation();
+    if (simulationThreaded) {
+        simulationRunning = true;
+        simulationThread = std::thread(simulationLoop);
+    }
+
     // Render loop
     while (!glfwWindowShouldClose(window))
     {
-        // Per-frame time logic
+        ReloadClock::time_point frameStart = ReloadClock::now();
         float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-
-        // Update animation time
-        animationTime = currentFrame;
+        gl.beginFrame();
 
-        // Input
+        // Input, as late before drawing as it can be read
+        glfwPollEvents();
         processInput(window);
+        
+        // Take the newest snapshot (without the simulation thread, step the
+        // clock right here first)
+        if (!simulationThreaded && simulate(frames.back()))
+            frames.publish();
+        bool newSnapshot = frames.acquire();
+        const FrameSnapshot& snapshot = frames.front();
+        if (newSnapshot) {
+            simulateMs += snapshot.simulateMs;
+            simulateSteps += snapshot.steps;
+            droppedMs = snapshot.droppedMs;
+        }
+        
+        // Draw one step behind: the state alpha of the way from the previous
+        // step to the newest, alpha being how far wall time has got past the
+        // newest. Motion is then smooth whatever the frame rate, at the cost
+        // of up to one step of latency.
+        const SimState& previous = snapshot.previous;
+        const SimState& current = snapshot.current;
+        const float alpha = glm::clamp((float)((glfwGetTime() - current.time) * simulationRate), 0.0f, 1.0f);
+        const glm::vec3 viewPos = glm::mix(previous.cameraPos, current.cameraPos, alpha);
+        planets.clear();
+        for (size_t i = 0; i < current.planets.size(); ++i) {
+            const Common::Transform& transform = i < previous.planets.size()
+                ? Common::interpolate(previous.planets[i].transform, current.planets[i].transform, alpha)
+                : current.planets[i].transform;
+            planets.push_back({ Common::worldMatrix(transform), transform.position, transform.scale,
+                                current.planets[i].planet });
+        }
 
         // Render
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Activate shader
-        glUseProgram(shaderProgram);
+        // Frame boundary: start rebuilding changed assets and swap in finished ones
+        for (const std::string& path : assetWatcher.changes())
+            beginReload(path);
+        finishMeshReload();
 
-        // Pass projection matrix to shader
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+        // Pick up finished variants, then activate the one for the enabled layers
+        // (or the richest finished subset of it while it compiles)
+        ReloadClock::time_point shaderUpdateStart = ReloadClock::now();
+        size_t shadersPending = earthShaders.update() + sculptureShaders.update();
+        if (shaderReloadPending) {
+            shaderSwapMs += msSince(shaderUpdateStart);
+            if (shadersPending == 0) {
+                reportReload("shaders (" + std::to_string(earthShaders.size() + sculptureShaders.size()) + " variants)",
+                             shaderReloadStart, shaderSwapMs);
+                shaderReloadPending = false;
+            }
+        }
+        if (shadersPending == 0 && !shadersReported) {
+            std::cout << earthShaders.size() << " shader variants ready in " << msSinceLaunch() - shaderStart
+                      << " ms (" << programCache.hits() << " cached, "
+                      << programCache.misses() << " compiled, "
+                      << (Common::parallelCompileSupported() ? "parallel" : "serial") << ")" << std::endl;
+            shadersReported = true;
+        }
+        const Common::ShaderPermutations::Variant& earthShader = earthShaders.bestReady(earthFeatures());
+        gl.useProgram(earthShader.program);
 
-        // Camera/view transformation
-        glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+        // Projection and camera/view transformation
+        float aspect = (float)SCR_WIDTH / (float)SCR_HEIGHT;
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), aspect, NEAR_PLANE, FAR_PLANE);
+        glm::mat4 view = glm::lookAt(viewPos, viewPos + cameraFront, cameraUp);
         
-        // Lighting setup for earth
-        glm::vec3 lightColor = sunColor * lightIntensity;
-        glUniform3fv(glGetUniformLocation(shaderProgram, "lightPos"), 1, glm::value_ptr(sunPosition));
-        glUniform3fv(glGetUniformLocation(shaderProgram, "lightColor"), 1, glm::value_ptr(lightColor));
-        glUniform3fv(glGetUniformLocation(shaderProgram, "viewPos"), 1, glm::value_ptr(cameraPos));
+        // Stream texture levels by how much of the screen the Earth covers, then
+        // upload whatever has arrived (before binding, since uploads rebind)
+        float earthCoverage = 0.0f;
+        for (const PlanetDraw& planet : planets)
+            earthCoverage = std::max(earthCoverage, sphereScreenCoverage(planet.center, planet.radius, view,
+                                                                         glm::radians(45.0f), aspect));
+        unsigned int earthTextures[] = { earth.diffuseTexture, earth.cloudsTexture, earth.nightLightsTexture,
+                                         earth.reliefTexture, earth.coastTexture };
+        for (unsigned int texture : earthTextures)
+            textureStreamer.setCoverage(texture, earthCoverage);
+        for (const TextureReload& reload : textureReloads)
+            textureStreamer.setCoverage(reload.replacement, earthCoverage);
+        textureStreamer.update();
+        finishTextureReloads();
+        
+        // Per-frame block: camera and lighting, shared by every program
+        Common::FrameBlock frame;
+        frame.view = view;
+        frame.projection = projection;
+        frame.viewProjection = projection * view;
+        frame.viewPos = viewPos;
+        frame.lightPos = glm::mix(previous.lightPos, current.lightPos, alpha);
+        frame.lightColor = glm::mix(previous.lightColor, current.lightColor, alpha);
+        frame.animationTime = (float)(previous.time + (current.time - previous.time) * alpha);
+        frameUniforms.upload(frame);
 
         // Set wireframe mode if enabled
-        if (showWireframe) {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        } else {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        }
+        gl.polygonMode(showWireframe ? GL_LINE : GL_FILL);
 
-        // Render earth
-        if (earth.loaded) {
-            // Bind textures first
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, earth.diffuseTexture);
-            glUniform1i(glGetUniformLocation(shaderProgram, "diffuseTex"), 0);
-            
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, earth.cloudsTexture);
-            glUniform1i(glGetUniformLocation(shaderProgram, "cloudsTex"), 1);
-            
-            glActiveTexture(GL_TEXTURE2);
-            glBindTexture(GL_TEXTURE_2D, earth.nightLightsTexture);
-            glUniform1i(glGetUniformLocation(shaderProgram, "nightTex"), 2);
+        // Record this frame's draws; the queue sorts them and replays them
+        // below. Planets outside the view are culled first (an animated or
+        // simulated sculpture moves on the GPU, so it has no CPU-side bounds
+        // and is always drawn; linked rods are culled below).
+        renderQueue.beginFrame();
+        ReloadClock::time_point cullingStart = ReloadClock::now();
+        planetBounds.resize(planets.size());
+        for (size_t i = 0; i < planets.size(); ++i)
+            planetBounds.setSphere(i, planets[i].center, planets[i].radius);
+        planetBounds.cull(Common::extractFrustum(frame.viewProjection), visiblePlanets);
+        cullingMs += msSince(cullingStart);
+        culledObjects += planets.size();
+        objectsInView += visiblePlanets.size();
+        cullingFrames++;
+        
+        // Material from the current texture ids (hot reload may have swapped
+        // them); every planet is drawn with the Earth's
+        earthMaterial.textureTarget = GL_TEXTURE_CUBE_MAP;
+        earthMaterial.textureCount = 5;
+        earthMaterial.textures[0] = earth.diffuseTexture;
+        earthMaterial.textures[1] = earth.cloudsTexture;
+        earthMaterial.textures[2] = earth.nightLightsTexture;
+        earthMaterial.textures[3] = earth.reliefTexture;
+        earthMaterial.textures[4] = earth.coastTexture;
+        
+        // Visible planets are recorded in chunks across the workers, each
+        // into a command list of its own
+        renderQueue.record(visiblePlanets.size(), [&](Common::CommandList& list, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                const PlanetDraw& draw = planets[visiblePlanets[i]];
+                const EarthModel& planet = *draw.planet;
+                if (!planet.loaded)
+                    continue;
+                
+                // Per-draw block: the inverses are computed here once, not per vertex.
+                // The instanced variant only reads the model matrix from it.
+                const glm::mat4& model = draw.model;
+                Common::ObjectBlock object;
+                object.model = model;
+                object.modelViewProjection = frame.viewProjection * model;
+                object.normalMatrix = glm::transpose(glm::inverse(model));
+                object.objectViewPos = glm::vec3(glm::inverse(model) * glm::vec4(viewPos, 1.0f));
+                
+                // Sorted front to back by this draw's own distance from the camera.
+                // Planets share the arena's VAO and the Earth material, so they are
+                // drawn together by one multi-draw.
+                Common::DrawPacket packet;
+                float depth = glm::clamp(glm::length(glm::vec3(model[3]) - viewPos) / FAR_PLANE, 0.0f, 1.0f);
+                packet.key = Common::makeSortKey(PASS_OPAQUE, earthShader.program, earthMaterial.id, depth);
+                packet.program = earthShader.program;
+                const Common::GeometryArena::Range& range = staticMeshes.range(planet.mesh);
+                packet.vertexArray = staticMeshes.vertexArray();
+                packet.material = &earthMaterial;
+                packet.indexCount = range.indexCount;
+                packet.firstIndex = range.firstIndex;
+                packet.baseVertex = range.baseVertex;
+                packet.instanced = (earthShader.features & EARTH_INSTANCED) != 0;
+                list.draw(packet, object);
+            }
+        }, PLANET_RECORD_CHUNK);
+        
+        // Upload the solvers' output, interpolated like everything else
+        if (sculpture.simulated() && previous.sculptureAngles.size() == current.sculptureAngles.size()) {
+            float* angles = sculpture.mapAngles();
+            if (angles) {
+                for (size_t i = 0; i < current.sculptureAngles.size(); ++i)
+                    angles[i] = glm::mix(previous.sculptureAngles[i], current.sculptureAngles[i], alpha);
+                sculpture.unmapAngles();
+            }
+        }
+        
+        // Linked rods are culled before upload, against the view frustum and
+        // then behind the planets drawn this frame, and only the rest are
+        // written to the instance buffer. Wireframe planets hide nothing.
+        size_t sculptureInstances = sculpture.instanceCount();
+        if (sculptureVisible && sculpture.linked() && previous.sculptureRods.size() == current.sculptureRods.size()) {
+            const size_t rodCount = current.sculptureRods.size();
+            const glm::vec3 pad(LINKAGE_ROD_RADIUS);
+            sculptureRods.resize(rodCount);
+            rodBounds.resize(rodCount);
+            rodCulling.resize(rodCount);
+            for (size_t i = 0; i < rodCount; ++i) {
+                Common::LinkTransform& rod = sculptureRods[i];
+                rod.pivot = glm::mix(previous.sculptureRods[i].pivot, current.sculptureRods[i].pivot, alpha);
+                rod.tip = glm::mix(previous.sculptureRods[i].tip, current.sculptureRods[i].tip, alpha);
+                rodBounds[i].min = glm::min(rod.pivot, rod.tip) - pad;
+                rodBounds[i].max = glm::max(rod.pivot, rod.tip) + pad;
+                rodCulling.setBox(i, rodBounds[i].min, rodBounds[i].max);
+            }
+            const glm::mat4 sculptureClip = frame.viewProjection * sculptureModel();
+            ReloadClock::time_point rodCullingStart = ReloadClock::now();
+            rodCulling.cull(Common::extractFrustum(sculptureClip), visibleRods);
+            cullingMs += msSince(rodCullingStart);
+            culledObjects += rodCount;
+            objectsInView += visibleRods.size();
             
-            // Create model matrix for earth
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
+            if (occlusionEnabled && !showWireframe) {
+                ReloadClock::time_point occlusionStart = ReloadClock::now();
+                const size_t inView = visibleRods.size();
+                occlusion.clear();
+                for (uint32_t index : visiblePlanets) {
+                    if (planets[index].planet->loaded)
+                        occlusion.addOccluder(frame.viewProjection * planets[index].model, occluderVertices.data(),
+                                              occluderVertices.size(), occluderIndices.data(),
+                                              occluderIndices.size());
+                }
+                occlusion.rasterize();
+                occlusion.cull(sculptureClip, rodBounds.data(), visibleRods);
+                occlusionMs += msSince(occlusionStart);
+                rodsInView += inView;
+                rodsOccluded += inView - visibleRods.size();
+                occlusionFrames++;
+            }
             
-            // Apply rotation if enabled
-            if (isRotating) {
-                model = glm::rotate(model, animationTime * rotationSpeed, glm::vec3(0.0f, 1.0f, 0.0f));
+            Common::LinkTransform* transforms = sculpture.mapTransforms();
+            if (transforms) {
+                for (size_t i = 0; i < visibleRods.size(); ++i)
+                    transforms[i] = sculptureRods[visibleRods[i]];
+                sculpture.unmapTransforms();
             }
+            sculptureInstances = visibleRods.size();
+        }
+        if (newSnapshot && (sculpture.simulated() || sculpture.linked())) {
+            solverMs += snapshot.solverMs;
+            solverSteps += snapshot.steps;
+            bvhMs += snapshot.bvhMs;
+            bvhDegradation = snapshot.bvhDegradation;
+        }
+        
+        // The whole sculpture is one packet; every element moves in the vertex shader
+        if (sculptureVisible && sculptureInstances > 0) {
+            const Common::ShaderPermutations::Variant& sculptureShader = sculptureShaders.bestReady(sculptureFeatures());
             
-            // Apply scaling
-            model = glm::scale(model, glm::vec3(earthScale, earthScale, earthScale));
+            Common::ObjectBlock object;
+            object.model = sculptureModel();
+            object.modelViewProjection = frame.viewProjection * object.model;
+            object.normalMatrix = glm::transpose(glm::inverse(object.model));
+            object.objectViewPos = glm::vec3(glm::inverse(object.model) * glm::vec4(viewPos, 1.0f));
             
-            glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
+            Common::DrawPacket packet;
+            float depth = glm::clamp(glm::length(glm::vec3(object.model[3]) - viewPos) / FAR_PLANE, 0.0f, 1.0f);
+            packet.key = Common::makeSortKey(PASS_OPAQUE, sculptureShader.program, 0, depth);
+            packet.program = sculptureShader.program;
+            packet.vertexArray = sculpture.vertexArray();
+            packet.indexCount = sculpture.indexCount();
+            packet.instanceCount = (unsigned int)sculptureInstances;
+            renderQueue.record(1, [&](Common::CommandList& list, size_t, size_t) {
+                list.draw(packet, object);
+            });
+        }
+        
+        // Collect the last timing without stalling; skip timing frames until it lands
+        if (earthTimerPending) {
+            GLint available = 0;
+            glGetQueryObjectiv(earthTimerQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint64 elapsed = 0;
+                glGetQueryObjectui64v(earthTimerQuery, GL_QUERY_RESULT, &elapsed);
+                earthGpuMs += elapsed / 1.0e6;
+                earthGpuSamples++;
+                earthTimerPending = false;
+            }
+        }
+        
+        // Sort and draw
+        bool timeThisFrame = !earthTimerPending && renderQueue.size() > 0;
+        if (timeThisFrame)
+            glBeginQuery(GL_TIME_ELAPSED, earthTimerQuery);
+        renderQueue.submit(objectUniforms);
+        if (timeThisFrame) {
+            glEndQuery(GL_TIME_ELAPSED);
+            earthTimerPending = true;
+        }
+        
+        if (earthGpuSamples > 0 && currentFrame - lastTimerReport > 2.0f) {
+            std::cout << "Opaque pass (" << SCR_WIDTH << "x" << SCR_HEIGHT << ", relief "
+                      << (reliefEnabled ? "on" : "off") << ", "
+                      << (sculptureVisible ? sculpture.instanceCount() : 0) << " sculpture elements): "
+                      << earthGpuMs / earthGpuSamples << " ms GPU" << std::endl;
+            earthGpuMs = 0.0;
+            earthGpuSamples = 0;
+            lastTimerReport = currentFrame;
             
-            // Bind VAO and draw
-            glBindVertexArray(earth.VAO);
-            glDrawElements(GL_TRIANGLES, earth.indices.size(), GL_UNSIGNED_INT, 0);
+            Common::TextureResidencyStats residency = textureStreamer.stats();
+            std::cout << "Textures: " << residency.residentBytes / (1024.0 * 1024.0) << " / "
+                      << residency.budgetBytes / (1024.0 * 1024.0) << " MiB, "
+                      << residency.evictionsThisFrame << " evictions this frame ("
+                      << residency.totalEvictions << " total), reload "
+                      << residency.averageReloadMs << " ms avg" << std::endl;
+            std::cout << "GL state calls this frame: " << gl.stats().issued << " issued, "
+                      << gl.stats().elided << " elided" << std::endl;
+            const Common::RenderQueueStats& queueStats = renderQueue.stats();
+            std::cout << "Render queue: " << queueStats.packets << " packets in " << queueStats.drawCalls
+                      << " draw calls (" << queueStats.multiDraws << " multi-draw indirect)" << std::endl;
+            if (solverSteps > 0 && sculpture.linked()) {
+                double stepMs = solverMs / solverSteps;
+                std::cout << "Sculpture linkage: " << stepMs << " ms per step, "
+                          << LINKAGE_ITERATIONS * 1000.0 / stepMs << " iterations/s over "
+                          << sculptureLinkage.constraintCount() << " constraints in "
+                          << sculptureLinkage.colorCount() << " colors; BVH " << bvhMs / solverSteps
+                          << " ms per step, SAH cost " << bvhDegradation << "x built" << std::endl;
+                solverMs = bvhMs = 0.0;
+                solverSteps = 0;
+            } else if (solverSteps > 0) {
+                double stepMs = solverMs / solverSteps;
+                std::cout << "Sculpture solver: " << stepMs << " ms per step, "
+                          << stepMs * 1.0e6 / sculptureSolver.size() << " ns per element" << std::endl;
+                solverMs = 0.0;
+                solverSteps = 0;
+            }
+            if (frameSamples > 0) {
+                std::cout << "Frame: " << frameCpuMs / frameSamples << " ms CPU on the GL thread, "
+                          << (simulateSteps > 0 ? simulateMs / simulateSteps : 0.0) << " ms per simulation step ("
+                          << simulateSteps / (currentFrame - lastFrameReport) << " steps/s at "
+                          << simulationRate << " Hz, " << (simulationThreaded ? "own thread" : "inline") << ", "
+                          << droppedMs << " ms dropped), input to present "
+                          << sceneLatencyMs / frameSamples << " ms (scene), "
+                          << lookLatencyMs / frameSamples << " ms (look)" << std::endl;
+                frameCpuMs = simulateMs = sceneLatencyMs = lookLatencyMs = 0.0;
+                frameSamples = simulateSteps = 0;
+                lastFrameReport = currentFrame;
+            }
+            if (cullingFrames > 0) {
+                std::cout << "Frustum culling: " << objectsInView / cullingFrames << " of "
+                          << culledObjects / cullingFrames << " planets and rods in view, "
+                          << cullingMs / cullingFrames << " ms CPU per frame" << std::endl;
+                cullingMs = 0.0;
+                culledObjects = objectsInView = 0;
+                cullingFrames = 0;
+            }
+            if (occlusionFrames > 0) {
+                std::cout << "Occlusion: " << (rodsInView > 0 ? 100.0 * rodsOccluded / rodsInView : 0.0)
+                          << "% of " << rodsInView / occlusionFrames << " rods in view occluded, "
+                          << occlusionMs / occlusionFrames << " ms CPU per frame ("
+                          << occlusion.triangleCount() << " occluder triangles at " << OCCLUSION_WIDTH << "x"
+                          << OCCLUSION_HEIGHT << ")" << std::endl;
+                occlusionMs = 0.0;
+                rodsInView = rodsOccluded = 0;
+                occlusionFrames = 0;
+            }
         }
 
-        // Swap buffers and poll IO events
+        // Swap buffers; the frame counts as presented when the swap returns
+        frameCpuMs += msSince(frameStart);
         glfwSwapBuffers(window);
-        glfwPollEvents();
+        ReloadClock::time_point presented = ReloadClock::now();
+        sceneLatencyMs += std::chrono::duration<double, std::milli>(presented - snapshot.inputSampled).count();
+        lookLatencyMs += std::chrono::duration<double, std::milli>(presented - frameStart).count();
+        frameSamples++;
+        
+        if (!firstFrameReported) {
+            std::cout << "Time to first frame: " << msSinceLaunch() << " ms" << std::endl;
+            firstFrameReported = true;
+        }
+        if (!fullResolutionReported && textureStreamer.fullyResident()) {
+            std::cout << "Time to full resolution: " << msSinceLaunch() << " ms ("
+                      << textureStreamer.residentBytes() / 1024 << " KiB resident)" << std::endl;
+            fullResolutionReported = true;
+        }
     }
 
     // Cleanup
+    if (simulationThreaded) {
+        simulationRunning = false;
+        simulationThread.join();
+    }
     if (earth.loaded) {
-        glDeleteVertexArrays(1, &earth.VAO);
-        glDeleteBuffers(1, &earth.VBO);
-        glDeleteBuffers(1, &earth.EBO);
-        glDeleteTextures(1, &earth.diffuseTexture);
-        glDeleteTextures(1, &earth.cloudsTexture);
-        glDeleteTextures(1, &earth.nightLightsTexture);
+        textureStreamer.unload(earth.diffuseTexture);
+        textureStreamer.unload(earth.cloudsTexture);
+        textureStreamer.unload(earth.nightLightsTexture);
+        textureStreamer.unload(earth.reliefTexture);
+        textureStreamer.unload(earth.coastTexture);
     }
-    glDeleteProgram(shaderProgram);
+    for (const TextureReload& reload : textureReloads)
+        textureStreamer.unload(reload.replacement);
+    if (meshReload.valid())
+        meshReload.wait();
+    glDeleteQueries(1, &earthTimerQuery);
+    frameUniforms.destroy();
+    objectUniforms.destroy();
+    renderQueue.destroy();
+    staticMeshes.destroy();
+    sculpture.destroy();
+    earthShaders.clear();
+    sculptureShaders.clear();
     
     // Reset polygon mode
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    gl.polygonMode(GL_FILL);
 
     glfwTerminate();
     return 0;
@@ -2,29 +2,141 @@
 in vec2 TexCoord;
 in vec3 FragPos;
 in vec3 Normal;
+in vec3 SphereDir;
+#ifdef RELIEF
+in vec3 Tangent;
+in vec3 ObjTangent;
+in vec3 ObjViewDir;
+#endif
 out vec4 FragColor;
 
-uniform sampler2D diffuseTex;
-uniform sampler2D cloudsTex;
-uniform sampler2D nightTex;
-uniform vec3 lightPos;
-uniform vec3 lightColor;
-uniform vec3 viewPos;
+// Optional inputs exist only in the variants that use them
+uniform samplerCube diffuseTex;
+uniform samplerCube coastTex;    // ocean SDF: 0.5 on the coast, +/- COAST_SDF_RANGE texels at 0/1
+uniform vec3 ambientSH[9];       // irradiance SH of the space environment, cosine lobe folded in
+#ifdef CLOUDS
+uniform samplerCube cloudsTex;
+#endif
+#ifdef NIGHT_LIGHTS
+uniform samplerCube nightTex;
+#endif
+#ifdef RELIEF
+uniform samplerCube reliefTex;   // rg: tangent normal, b: height, a: sqrt(cone ratio)
+uniform float reliefDepth;
+
+// Depth the cone ratios were baked for (Bake::kReliefDepth) and fixed tap count
+const float RELIEF_BAKE_DEPTH = 0.004;
+const int RELIEF_STEPS = 8;
+#endif
+
+#include "../include/uniform_blocks.glsl"
+
+// Matches kSdfRange in the coastline bake
+const float COAST_SDF_RANGE = 4.0;
+
+// Anti-aliased ocean coverage from the coastline distance field; the edge
+// stays one pixel wide at any zoom because the width comes from fwidth
+float oceanCoverage(vec3 dir)
+{
+    float dist = (texture(coastTex, dir).r - 128.0 / 255.0) * (255.0 / 127.0) * COAST_SDF_RANGE;
+    float width = max(fwidth(dist), 1e-4);
+    return smoothstep(-width, width, dist);
+}
+
+// Ambient irradiance for a world-space normal from the baked SH coefficients
+vec3 ambientIrradiance(vec3 n)
+{
+    vec3 e = ambientSH[0];
+    e += ambientSH[1] * n.y + ambientSH[2] * n.z + ambientSH[3] * n.x;
+    e += ambientSH[4] * (n.x * n.y) + ambientSH[5] * (n.y * n.z) + ambientSH[7] * (n.x * n.z);
+    e += ambientSH[6] * (3.0 * n.z * n.z - 1.0) + ambientSH[8] * (n.x * n.x - n.y * n.y);
+    return max(e, vec3(0.0));
+}
+
+#ifdef RELIEF
+// Cone step mapping over the cube-sphere: march a view ray below the surface in
+// face-UV units and return the displaced lookup direction. Each tap advances by
+// the largest step the baked cone allows, so a fixed number of taps converges
+// without overshooting ridges.
+vec3 reliefDirection(vec3 dir, vec3 T, vec3 B, vec3 viewTS)
+{
+    // Face-UV -> sphere offset; using the corner-compressed scale keeps steps conservative
+    float major = max(abs(dir.x), max(abs(dir.y), abs(dir.z)));
+    float uvToSphere = 2.0 * major * major;
+    
+    // Ray offset in face-UV per unit of normalized depth
+    vec2 rayXY = -viewTS.xy / max(viewTS.z, 0.05) * reliefDepth;
+    float rayRatio = length(rayXY);
+    
+    float depth = 0.0;
+    for (int i = 0; i < RELIEF_STEPS; ++i) {
+        vec2 uv = rayXY * depth;
+        vec4 relief = textureLod(reliefTex, dir + (T * uv.x + B * uv.y) * uvToSphere, 0.0);
+        float surfaceDepth = 1.0 - relief.b;
+        float cone = relief.a * relief.a * RELIEF_BAKE_DEPTH;
+        depth += max(surfaceDepth - depth, 0.0) * cone / (cone + rayRatio);
+    }
+    
+    vec2 uv = rayXY * depth;
+    return dir + (T * uv.x + B * uv.y) * uvToSphere;
+}
+#endif
 
 void main()
 {
-    // Sample the diffuse texture
-    vec3 diffuseColor = texture(diffuseTex, TexCoord).rgb;
+    vec3 dir = normalize(SphereDir);
+    vec3 norm = normalize(Normal);
+    vec3 sphereNorm = norm;
+    
+#ifdef RELIEF
+    {
+        // Object-space tangent frame (face right, face up) for the march
+        vec3 objT = normalize(ObjTangent - dir * dot(dir, ObjTangent));
+        vec3 objB = cross(dir, objT);
+        vec3 view = normalize(ObjViewDir);
+        vec3 viewTS = vec3(dot(view, objT), dot(view, objB), dot(view, dir));
+        dir = reliefDirection(dir, objT, objB, viewTS);
+        
+        // Perturb the world normal with the baked tangent-space normal
+        vec3 T = normalize(Tangent - norm * dot(norm, Tangent));
+        vec3 B = cross(norm, T);
+        vec2 nxy = texture(reliefTex, dir).rg * 2.0 - 1.0;
+        vec3 nts = vec3(nxy, sqrt(max(1.0 - dot(nxy, nxy), 0.0)));
+        norm = normalize(T * nts.x + B * nts.y + norm * nts.z);
+    }
+#endif
+    
+    // Sample the diffuse cubemap along the object-space direction
+    vec3 diffuseColor = texture(diffuseTex, dir).rgb;
     
     // Simple lighting
-    vec3 norm = normalize(Normal);
     vec3 lightDir = normalize(lightPos - FragPos);
     float diff = max(dot(norm, lightDir), 0.0);
     
     // Ambient + diffuse lighting
-    vec3 ambient = 0.3 * lightColor;
+    vec3 ambient = ambientIrradiance(norm) * lightColor;
     vec3 diffuse = diff * lightColor;
     
-    vec3 result = (ambient + diffuse) * diffuseColor;
+    // Sun glint on open water only, using the unperturbed sphere normal
+    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 halfway = normalize(lightDir + viewDir);
+    float ocean = oceanCoverage(dir);
+    vec3 specular = ocean * 0.6 * pow(max(dot(sphereNorm, halfway), 0.0), 64.0) * lightColor;
+    
+    vec3 result = (ambient + diffuse) * diffuseColor + specular;
+    
+#ifdef NIGHT_LIGHTS
+    // City lights fade in across the terminator on the unlit side
+    float night = 1.0 - smoothstep(-0.1, 0.15, dot(sphereNorm, lightDir));
+    result += texture(nightTex, dir).rgb * night;
+#endif
+    
+#ifdef CLOUDS
+    // Clouds float above the relief, so they use the undisplaced direction and
+    // the sphere normal, and hide lights and glint beneath them
+    float cloud = texture(cloudsTex, normalize(SphereDir)).r;
+    vec3 cloudLight = ambientIrradiance(sphereNorm) * lightColor + max(dot(sphereNorm, lightDir), 0.0) * lightColor;
+    result = mix(result, cloudLight, cloud);
+#endif
     FragColor = vec4(result, 1.0);
 }
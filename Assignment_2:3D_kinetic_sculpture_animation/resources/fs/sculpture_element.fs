@@ -0,0 +1,9 @@
+#version 330 core
+in vec3 Color;
+out vec4 FragColor;
+
+// Lighting is done per vertex in sculpture_element.vs
+void main()
+{
+    FragColor = vec4(Color, 1.0);
+}
@@ -0,0 +1,17 @@
+// Matches Common::FrameBlock / Common::ObjectBlock (uniform_blocks.hpp)
+layout(std140) uniform FrameBlock {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec3 viewPos;
+    vec3 lightPos;
+    vec3 lightColor;
+    float animationTime;
+};
+
+layout(std140) uniform ObjectBlock {
+    mat4 model;
+    mat4 modelViewProjection;
+    mat4 normalMatrix;
+    vec3 objectViewPos;
+};
@@ -2,19 +2,53 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
 layout (location = 2) in vec3 aNormal;
+layout (location = 3) in vec3 aTangent;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Variant features (NIGHT_LIGHTS, CLOUDS, RELIEF, INSTANCED) are #defined by
+// Common::ShaderPermutations right after the #version line
+#include "../include/uniform_blocks.glsl"
+
+#ifdef INSTANCED
+// Per-instance model matrix (Common::INSTANCE_MODEL_LOCATION), filled by the
+// render queue; ObjectBlock is not read
+layout (location = 4) in mat4 instanceModel;
+#endif
 
 out vec2 TexCoord;
 out vec3 FragPos;
 out vec3 Normal;
+out vec3 SphereDir;
+#ifdef RELIEF
+out vec3 Tangent;
+out vec3 ObjTangent;
+out vec3 ObjViewDir;
+#endif
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+#ifdef INSTANCED
+    // Transforms only scale uniformly, so the rotation-scale part inverts as
+    // its transpose over the squared scale and also transforms normals
+    mat4 world = instanceModel;
+    mat3 linear = mat3(instanceModel);
+    gl_Position = viewProjection * (world * vec4(aPos, 1.0));
+    Normal = linear * aNormal;
+    vec3 eyePos = transpose(linear) * (viewPos - world[3].xyz) / dot(linear[0], linear[0]);
+#else
+    mat4 world = model;
+    gl_Position = modelViewProjection * vec4(aPos, 1.0);
+    Normal = mat3(normalMatrix) * aNormal;
+    vec3 eyePos = objectViewPos;
+#endif
     TexCoord = aTexCoord;
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    SphereDir = aPos;
+    FragPos = vec3(world * vec4(aPos, 1.0));
+    
+#ifdef RELIEF
+    Tangent = mat3(world) * aTangent;
+    
+    // Object-space frame for relief marching through the cubemaps
+    ObjTangent = aTangent;
+    ObjViewDir = eyePos - aPos;
+#endif
 }
@@ -0,0 +1,80 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+// Per instance (Common::SculptureInstance, or Common::LinkTransform when LINKED)
+layout (location = 4) in vec4 aOffsetPhase;     // pivot position, phase
+layout (location = 5) in vec4 aAxisFrequency;   // unit pivot axis, radians per second; LINKED: rod tip
+#ifdef SIMULATED
+layout (location = 6) in float aAngle;          // swing angle from the CPU solver
+#endif
+
+#include "../include/uniform_blocks.glsl"
+
+out vec3 Color;
+
+// Peak turn about the pivot axis (radians) and peak vertical travel of the
+// analytic motion; SIMULATED takes the angle per instance instead, LINKED the
+// whole rod
+const float SWING_ANGLE = 1.2;
+const float HEAVE = 0.04;
+
+// Brushed metal, warmer at one end of the swing so the wave reads from afar
+const vec3 COOL_METAL = vec3(0.55, 0.6, 0.68);
+const vec3 WARM_METAL = vec3(0.8, 0.62, 0.4);
+
+void main()
+{
+#ifdef LINKED
+    // Stand the rod's local -Y on the segment from pivot to tip; rods are
+    // round, so any frame around it will do
+    vec3 down = normalize(aAxisFrequency.xyz - aOffsetPhase.xyz);
+    vec3 side = abs(down.y) < 0.99 ? normalize(cross(down, vec3(0.0, 1.0, 0.0))) : vec3(1.0, 0.0, 0.0);
+    mat3 frame = mat3(side, -down, cross(side, -down));
+    vec3 position = aPos;
+    vec3 normal = aNormal;
+    float swing = clamp(acos(clamp(-down.y, -1.0, 1.0)) / SWING_ANGLE, 0.0, 1.0) * 2.0 - 1.0;
+    vec3 local = aOffsetPhase.xyz + frame * position;
+#else
+#ifdef SIMULATED
+    float angle = aAngle;
+    float swing = clamp(aAngle / SWING_ANGLE, -1.0, 1.0);
+    float heave = 0.0;
+#else
+    // Every element runs the same oscillation, shifted by its phase
+    float wave = aAxisFrequency.w * animationTime + aOffsetPhase.w;
+    float swing = sin(wave);
+    float angle = SWING_ANGLE * swing;
+    float heave = HEAVE * cos(wave);
+#endif
+    float c = cos(angle);
+    float s = sin(angle);
+    
+    // Turn the element about its local X axis...
+    vec3 position = vec3(aPos.x, aPos.y * c - aPos.z * s, aPos.y * s + aPos.z * c);
+    vec3 normal = vec3(aNormal.x, aNormal.y * c - aNormal.z * s, aNormal.y * s + aNormal.z * c);
+    
+    // ...then map local X onto the pivot axis, keeping local Y as close to up as it gets
+    vec3 axis = aAxisFrequency.xyz;
+    vec3 up = abs(axis.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+    vec3 side = normalize(cross(axis, up));
+    mat3 frame = mat3(axis, cross(side, axis), side);
+    
+    vec3 local = aOffsetPhase.xyz + frame * position + vec3(0.0, heave, 0.0);
+#endif
+    vec4 world = model * vec4(local, 1.0);
+    gl_Position = viewProjection * world;
+    
+    // Lit per vertex: elements are small on screen, so this is close to per
+    // pixel at a fraction of the fill cost. Thin vanes are seen from both sides.
+    vec3 norm = normalize(mat3(normalMatrix) * (frame * normal));
+    vec3 viewDir = normalize(viewPos - world.xyz);
+    if (dot(norm, viewDir) < 0.0)
+        norm = -norm;
+    vec3 lightDir = normalize(lightPos - world.xyz);
+    vec3 halfway = normalize(lightDir + viewDir);
+    float diff = max(dot(norm, lightDir), 0.0);
+    float spec = pow(max(dot(norm, halfway), 0.0), 32.0);
+    
+    vec3 albedo = mix(COOL_METAL, WARM_METAL, swing * 0.5 + 0.5);
+    Color = (0.15 + diff) * albedo * lightColor + 0.5 * spec * lightColor;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "cooked_texture.hpp"
+#include "simd.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Offline bake stages for the Earth texture pack. Each stage reads the source
+// PNGs and writes .ctex files that main.cpp loads at runtime.
+namespace Bake {
+    // 8-bit source image, row 0 at the north pole for equirectangular maps
+    struct Image {
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        std::vector<uint8_t> pixels;
+    };
+
+    bool loadImage(const std::string& path, Image& image, int channels);
+
+    // Fill levels[1..] of a texture from levels[0] with a 2x2 box filter
+    void buildMipChain(Common::CookedTexture& texture);
+
+    // Milliseconds since an arbitrary epoch, for stage timing
+    double nowMs();
+
+    // Direction through cube face coordinates (s, t) in [-1, 1], GL cubemap convention.
+    // |s|, |t| > 1 extends the face onto its neighbours.
+    void cubeFaceDirection(int face, Common::simd::float4 s, Common::simd::float4 t,
+                           Common::simd::float4& x, Common::simd::float4& y, Common::simd::float4& z);
+
+    // Equirect UV for a direction, matching the legacy sphere mapping
+    void directionToEquirect(Common::simd::float4 x, Common::simd::float4 y, Common::simd::float4 z,
+                             Common::simd::float4& u, Common::simd::float4& v);
+
+    // Resample an equirect RGBA image to 6 cube faces (level 0 only when withMips is false)
+    uint32_t equalAreaFaceSize(int width, int height);
+    Common::CookedTexture equirectToCubemap(const Image& source, uint32_t faceSize, bool withMips = true);
+
+    // Relief depth in face-UV units for a height of 1.0; shared with the Earth shader
+    const float kReliefDepth = 0.004f;
+
+    // Stage entry points; return false if any output failed
+    bool bakeCubemaps(const std::string& texturesDir, const std::string& outDir);
+    bool bakeRelief(const std::string& texturesDir, const std::string& outDir);
+    bool bakeCoastline(const std::string& texturesDir, const std::string& outDir);
+    bool bakeAmbientSH(const std::string& outDir);
+}
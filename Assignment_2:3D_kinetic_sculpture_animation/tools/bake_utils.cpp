@@ -0,0 +1,85 @@
+#include "bake.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace Bake {
+
+bool loadImage(const std::string& path, Image& image, int channels) {
+    int width, height, fileChannels;
+    unsigned char* data = stbi_load(path.c_str(), &width, &height, &fileChannels, channels);
+    if (!data) {
+        std::cout << "Failed to load image: " << path << std::endl;
+        return false;
+    }
+
+    image.width = width;
+    image.height = height;
+    image.channels = channels;
+    image.pixels.assign(data, data + (size_t)width * height * channels);
+    stbi_image_free(data);
+    return true;
+}
+
+void buildMipChain(Common::CookedTexture& texture) {
+    using Common::simd::float4;
+
+    const uint32_t channels = texture.channels;
+    texture.levels.resize(1);
+    while (texture.levels.back().width > 1 || texture.levels.back().height > 1) {
+        const Common::CookedLevel& src = texture.levels.back();
+        Common::CookedLevel dst;
+        dst.width = std::max(1u, src.width / 2);
+        dst.height = std::max(1u, src.height / 2);
+        dst.data.resize((size_t)dst.width * dst.height * channels * texture.faces);
+
+        const size_t srcFace = (size_t)src.width * src.height * channels;
+        const size_t dstFace = (size_t)dst.width * dst.height * channels;
+        const size_t rows = (size_t)dst.height * texture.faces;
+
+        Common::parallelFor(rows, [&](size_t begin, size_t end) {
+            for (size_t row = begin; row < end; ++row) {
+                const size_t face = row / dst.height;
+                const uint32_t y = (uint32_t)(row % dst.height);
+                const uint8_t* s = src.data.data() + face * srcFace;
+                uint8_t* d = dst.data.data() + face * dstFace;
+                const uint32_t y0 = std::min(2 * y, src.height - 1);
+                const uint32_t y1 = std::min(2 * y + 1, src.height - 1);
+
+                for (uint32_t x = 0; x < dst.width; ++x) {
+                    const uint32_t x0 = std::min(2 * x, src.width - 1);
+                    const uint32_t x1 = std::min(2 * x + 1, src.width - 1);
+                    const uint8_t* p00 = s + ((size_t)y0 * src.width + x0) * channels;
+                    const uint8_t* p01 = s + ((size_t)y0 * src.width + x1) * channels;
+                    const uint8_t* p10 = s + ((size_t)y1 * src.width + x0) * channels;
+                    const uint8_t* p11 = s + ((size_t)y1 * src.width + x1) * channels;
+                    uint8_t* out = d + ((size_t)y * dst.width + x) * channels;
+
+                    if (channels == 4) {
+                        float4 sum = float4::fromBytes(p00) + float4::fromBytes(p01) +
+                                     float4::fromBytes(p10) + float4::fromBytes(p11);
+                        (sum * float4(0.25f)).storeBytes(out);
+                    } else {
+                        for (uint32_t c = 0; c < channels; ++c)
+                            out[c] = (uint8_t)((p00[c] + p01[c] + p10[c] + p11[c] + 2) / 4);
+                    }
+                }
+            }
+        }, 4);
+
+        texture.levels.push_back(std::move(dst));
+    }
+}
+
+double nowMs() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace Bake
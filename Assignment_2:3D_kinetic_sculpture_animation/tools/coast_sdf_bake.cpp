@@ -0,0 +1,220 @@
+#include "bake.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+// Ocean_Mask_2K -> signed distance field cubemap.
+//
+// The mask (white = land) is resampled onto each cube face at kSupersample x
+// the output resolution, plus a border taken from the neighbouring faces so
+// distances stay continuous across seams. An exact Euclidean distance
+// transform (column sweeps vectorised across columns, then the Felzenszwalb
+// lower-envelope pass per row) gives the distance to the nearest land and
+// ocean texel; the difference is box-filtered down to the output grid.
+//
+// Output: one R8 channel, 128 at the coastline, +127 at kSdfRange output
+// texels into the ocean, -128 at kSdfRange texels inland.
+
+namespace Bake {
+
+namespace {
+
+using Common::simd::float4;
+
+const int kSupersample = 4;
+const float kSdfRange = 4.0f;
+const int kBorder = (int)kSdfRange * kSupersample * 2;
+const float kFar = 1.0e5f;
+
+// The downsample reads one float4 per supersampled row
+static_assert(kSupersample == 4, "coastline downsample assumes 4x supersampling");
+
+// Binary mask of one face on the supersampled grid, border included
+std::vector<uint8_t> sampleOceanFace(const Image& mask, int face, int grid, int inner) {
+    std::vector<uint8_t> ocean((size_t)grid * grid);
+    const float texelST = 2.0f / inner;
+    const float4 lane(0.0f, 1.0f, 2.0f, 3.0f);
+
+    Common::parallelFor((size_t)grid, [&](size_t begin, size_t end) {
+        for (int j = (int)begin; j < (int)end; ++j) {
+            const float4 t((j - kBorder + 0.5f) * texelST - 1.0f);
+            for (int i = 0; i < grid; i += 4) {
+                const float4 s = (float4((float)(i - kBorder) + 0.5f) + lane) * float4(texelST) - float4(1.0f);
+                float4 x, y, z, u, v;
+                cubeFaceDirection(face, s, t, x, y, z);
+                directionToEquirect(x, y, z, u, v);
+
+                float us[4], vs[4];
+                (u * float4((float)mask.width) - float4(0.5f)).store(us);
+                (v * float4((float)mask.height) - float4(0.5f)).store(vs);
+                for (int k = 0; k < 4 && i + k < grid; ++k) {
+                    // Bilinear mask value thresholded at half gives sub-texel edges
+                    const int x0 = (int)std::floor(us[k]), y0 = (int)std::floor(vs[k]);
+                    const float fx = us[k] - x0, fy = vs[k] - y0;
+                    auto at = [&](int px, int py) {
+                        px = (px % mask.width + mask.width) % mask.width;
+                        py = std::clamp(py, 0, mask.height - 1);
+                        return (float)mask.pixels[(size_t)py * mask.width + px];
+                    };
+                    const float top = at(x0, y0) + (at(x0 + 1, y0) - at(x0, y0)) * fx;
+                    const float bottom = at(x0, y0 + 1) + (at(x0 + 1, y0 + 1) - at(x0, y0 + 1)) * fx;
+                    ocean[(size_t)j * grid + i + k] = (top + (bottom - top) * fy) < 127.5f ? 1 : 0;
+                }
+            }
+        }
+    }, 8);
+    return ocean;
+}
+
+// 1D squared distance transform of sampled function f (Felzenszwalb & Huttenlocher)
+void distanceTransform1D(const float* f, int n, float* d, int* v, float* z) {
+    const float inf = std::numeric_limits<float>::infinity();
+    int k = 0;
+    v[0] = 0;
+    z[0] = -inf;
+    z[1] = inf;
+    for (int q = 1; q < n; ++q) {
+        auto intersect = [&](int p) {
+            return ((f[q] + (float)q * q) - (f[p] + (float)p * p)) / (2.0f * (q - p));
+        };
+        float s = intersect(v[k]);
+        while (s <= z[k]) {
+            --k;
+            s = intersect(v[k]);
+        }
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = inf;
+    }
+    k = 0;
+    for (int q = 0; q < n; ++q) {
+        while (z[k + 1] < q)
+            ++k;
+        const float dq = (float)(q - v[k]);
+        d[q] = dq * dq + f[v[k]];
+    }
+}
+
+// Squared Euclidean distance from every texel to the nearest texel where
+// feature[] == want, on a grid x grid image
+std::vector<float> squaredDistance(const std::vector<uint8_t>& feature, uint8_t want, int grid) {
+    std::vector<float> g((size_t)grid * grid);
+    const int paddedColumns = (grid + 3) / 4 * 4;
+
+    // Column sweeps: down then up, four columns per SIMD op. Columns are
+    // split into blocks so each thread owns a contiguous strip.
+    Common::parallelFor((size_t)paddedColumns / 4, [&](size_t begin, size_t end) {
+        std::vector<float> strip((size_t)grid * 4);
+        const float4 one(1.0f);
+        for (size_t block = begin; block < end; ++block) {
+            const int x0 = (int)block * 4;
+            float4 run(kFar);
+            for (int y = 0; y < grid; ++y) {
+                float seed[4];
+                for (int k = 0; k < 4; ++k) {
+                    const int x = std::min(x0 + k, grid - 1);
+                    seed[k] = feature[(size_t)y * grid + x] == want ? 0.0f : kFar;
+                }
+                run = Common::simd::min(run + one, float4::load(seed));
+                run.store(strip.data() + (size_t)y * 4);
+            }
+            run = float4(kFar);
+            for (int y = grid - 1; y >= 0; --y) {
+                run = Common::simd::min(run + one, float4::load(strip.data() + (size_t)y * 4));
+                run = Common::simd::min(run, float4(kFar));
+                (run * run).store(strip.data() + (size_t)y * 4);
+            }
+            for (int y = 0; y < grid; ++y)
+                for (int k = 0; k < 4 && x0 + k < grid; ++k)
+                    g[(size_t)y * grid + x0 + k] = strip[(size_t)y * 4 + k];
+        }
+    }, 1);
+
+    // Row pass: lower envelope of parabolas
+    Common::parallelFor((size_t)grid, [&](size_t begin, size_t end) {
+        std::vector<float> f(grid), d(grid), z(grid + 1);
+        std::vector<int> v(grid);
+        for (size_t y = begin; y < end; ++y) {
+            float* row = g.data() + y * grid;
+            std::copy(row, row + grid, f.begin());
+            distanceTransform1D(f.data(), grid, d.data(), v.data(), z.data());
+            std::copy(d.begin(), d.end(), row);
+        }
+    }, 16);
+    return g;
+}
+
+} // namespace
+
+bool bakeCoastline(const std::string& texturesDir, const std::string& outDir) {
+    Image mask;
+    if (!loadImage(texturesDir + "/Ocean_Mask_2K.png", mask, 1))
+        return false;
+
+    double start = nowMs();
+    const int outSize = (int)equalAreaFaceSize(mask.width, mask.height) / 2;
+    const int inner = outSize * kSupersample;
+    const int grid = inner + 2 * kBorder;
+
+    Common::CookedTexture sdf;
+    sdf.channels = 1;
+    sdf.faces = 6;
+    sdf.levels.resize(1);
+    sdf.levels[0].width = outSize;
+    sdf.levels[0].height = outSize;
+    sdf.levels[0].data.resize((size_t)outSize * outSize * 6);
+
+    double edtMs = 0.0;
+    for (int face = 0; face < 6; ++face) {
+        std::vector<uint8_t> ocean = sampleOceanFace(mask, face, grid, inner);
+
+        double edtStart = nowMs();
+        std::vector<float> toOcean = squaredDistance(ocean, 1, grid);
+        std::vector<float> toLand = squaredDistance(ocean, 0, grid);
+        edtMs += nowMs() - edtStart;
+
+        // Signed distance in supersampled texels, positive over the ocean,
+        // with the half-texel offset so the zero crossing sits on the edge
+        Common::parallelFor((size_t)grid * grid, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                toLand[i] = ocean[i] ? std::sqrt(toLand[i]) - 0.5f : 0.5f - std::sqrt(toOcean[i]);
+            }
+        }, 4096);
+
+        // Box filter kSupersample^2 texels per output texel and encode
+        uint8_t* out = sdf.levels[0].data.data() + (size_t)face * outSize * outSize;
+        const float scale = 127.0f / (kSdfRange * kSupersample * kSupersample * kSupersample);
+        Common::parallelFor((size_t)outSize, [&](size_t begin, size_t end) {
+            for (size_t y = begin; y < end; ++y) {
+                for (int x = 0; x < outSize; ++x) {
+                    float4 sum(0.0f);
+                    for (int sy = 0; sy < kSupersample; ++sy) {
+                        const float* row = toLand.data() +
+                            (size_t)(y * kSupersample + sy + kBorder) * grid + x * kSupersample + kBorder;
+                        sum = sum + float4::load(row);
+                    }
+                    const float value = 128.0f + Common::simd::horizontalSum(sum) * scale;
+                    out[(size_t)y * outSize + x] = (uint8_t)std::lround(std::clamp(value, 0.0f, 255.0f));
+                }
+            }
+        }, 8);
+    }
+
+    buildMipChain(sdf);
+    const double totalMs = nowMs() - start;
+
+    // A binary R8 equirect mask at 8K with mips, for comparison
+    const double maskBytes = 8192.0 * 4096.0 * 4.0 / 3.0;
+    std::cout << "Coastline earth_coast.ctex: 6x" << outSize << "^2 SDF from " << grid << "^2 per face, "
+              << totalMs << " ms (EDT " << edtMs << " ms)" << std::endl;
+    std::cout << "  Memory: SDF " << sdf.byteSize() / 1024.0 << " KiB vs 8K binary mask "
+              << maskBytes / (1024.0 * 1024.0) << " MiB" << std::endl;
+    return Common::writeCookedTexture(outDir + "/earth_coast.ctex", sdf);
+}
+
+} // namespace Bake
@@ -0,0 +1,215 @@
+#include "bake.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Equirectangular -> cubemap conversion.
+//
+// The equirect maps spend most of their texels near the poles (a row at latitude
+// phi covers cos(phi) of the equator's solid angle). Cube faces keep texel solid
+// angle within a 3*sqrt(3) ratio, so we size the faces to match the equirect's
+// equatorial texel density on average and drop the polar oversampling.
+
+namespace Bake {
+
+namespace {
+
+using Common::simd::float4;
+
+const float kPi = 3.14159265358979f;
+
+// Bilinear RGBA fetch from the equirect image with horizontal wrap
+float4 sampleEquirect(const Image& src, float px, float py, float fx, float fy) {
+    const int w = src.width, h = src.height;
+    int x0 = (int)px, y0 = (int)py;
+    int x1 = x0 + 1, y1 = y0 + 1;
+    x0 = (x0 % w + w) % w;
+    x1 = (x1 % w + w) % w;
+    y0 = std::clamp(y0, 0, h - 1);
+    y1 = std::clamp(y1, 0, h - 1);
+
+    const uint8_t* base = src.pixels.data();
+    const float4 p00 = float4::fromBytes(base + ((size_t)y0 * w + x0) * 4);
+    const float4 p01 = float4::fromBytes(base + ((size_t)y0 * w + x1) * 4);
+    const float4 p10 = float4::fromBytes(base + ((size_t)y1 * w + x0) * 4);
+    const float4 p11 = float4::fromBytes(base + ((size_t)y1 * w + x1) * 4);
+
+    const float4 top = p00 + (p01 - p00) * float4(fx);
+    const float4 bottom = p10 + (p11 - p10) * float4(fx);
+    return top + (bottom - top) * float4(fy);
+}
+
+} // namespace
+
+void cubeFaceDirection(int face, float4 s, float4 t, float4& x, float4& y, float4& z) {
+    const float4 one(1.0f), zero(0.0f);
+    switch (face) {
+    case 0: x = one;          y = zero - t;   z = zero - s;   break;  // +X
+    case 1: x = zero - one;   y = zero - t;   z = s;          break;  // -X
+    case 2: x = s;            y = one;        z = t;          break;  // +Y
+    case 3: x = s;            y = zero - one; z = zero - t;   break;  // -Y
+    case 4: x = s;            y = zero - t;   z = one;        break;  // +Z
+    default: x = zero - s;    y = zero - t;   z = zero - one; break;  // -Z
+    }
+}
+
+void directionToEquirect(float4 x, float4 y, float4 z, float4& u, float4& v) {
+    // u = 0.5 + atan2(z, x) / 2pi, v = 0.5 - asin(y) / pi
+    const float4 horizontal = Common::simd::sqrt(x * x + z * z);
+    u = float4(0.5f) + Common::simd::atan2(z, x) * float4(0.5f / kPi);
+    v = float4(0.5f) - Common::simd::atan2(y, horizontal) * float4(1.0f / kPi);
+}
+
+// Face size whose average texel solid angle equals the equirect's equator texel
+uint32_t equalAreaFaceSize(int width, int height) {
+    // 6 N^2 texels over 4 pi sr vs one (2 pi / W) x (pi / H) texel at the equator
+    double n = std::sqrt((double)width * height / (3.0 * kPi));
+    return (uint32_t)std::ceil(n / 16.0) * 16;
+}
+
+Common::CookedTexture equirectToCubemap(const Image& src, uint32_t faceSize, bool withMips) {
+    Common::CookedTexture cube;
+    cube.channels = 4;
+    cube.faces = 6;
+    cube.levels.resize(1);
+    cube.levels[0].width = faceSize;
+    cube.levels[0].height = faceSize;
+    cube.levels[0].data.resize((size_t)faceSize * faceSize * 4 * 6);
+
+    const float4 invN(2.0f / faceSize);
+    const float4 lane(0.0f, 1.0f, 2.0f, 3.0f);
+    const float4 texW((float)src.width), texH((float)src.height);
+    const float4 half(0.5f);
+    // 2x2 supersampling offsets inside the output texel
+    const float sub[4][2] = { { 0.25f, 0.25f }, { 0.75f, 0.25f }, { 0.25f, 0.75f }, { 0.75f, 0.75f } };
+
+    Common::parallelFor((size_t)faceSize * 6, [&](size_t begin, size_t end) {
+        for (size_t row = begin; row < end; ++row) {
+            const int face = (int)(row / faceSize);
+            const uint32_t j = (uint32_t)(row % faceSize);
+            uint8_t* out = cube.levels[0].data.data() + (((size_t)face * faceSize + j) * faceSize) * 4;
+
+            for (uint32_t i = 0; i < faceSize; i += 4) {
+                float4 accum[4] = { float4(0.0f), float4(0.0f), float4(0.0f), float4(0.0f) };
+
+                for (const auto& offset : sub) {
+                    const float4 s = (float4((float)i + offset[0]) + lane) * invN - float4(1.0f);
+                    const float4 t = float4(((float)j + offset[1]) * (2.0f / faceSize) - 1.0f);
+                    float4 x, y, z;
+                    cubeFaceDirection(face, s, t, x, y, z);
+                    float4 u, v;
+                    directionToEquirect(x, y, z, u, v);
+
+                    const float4 px = u * texW - half;
+                    const float4 py = v * texH - half;
+                    const float4 fx0 = Common::simd::floor(px);
+                    const float4 fy0 = Common::simd::floor(py);
+
+                    float pxs[4], pys[4], fxs[4], fys[4];
+                    fx0.store(pxs);
+                    fy0.store(pys);
+                    (px - fx0).store(fxs);
+                    (py - fy0).store(fys);
+                    for (int k = 0; k < 4; ++k)
+                        accum[k] = accum[k] + sampleEquirect(src, pxs[k], pys[k], fxs[k], fys[k]);
+                }
+
+                for (int k = 0; k < 4 && i + k < faceSize; ++k)
+                    (accum[k] * float4(0.25f)).storeBytes(out + (size_t)(i + k) * 4);
+            }
+        }
+    }, 8);
+
+    if (withMips)
+        buildMipChain(cube);
+    return cube;
+}
+
+namespace {
+
+// Texel solid-angle spread for both layouts: max/min ratio and coefficient of variation
+void reportDensity(const Image& src, uint32_t faceSize) {
+    double eqMin = 1e30, eqMax = 0.0, eqSum = 0.0, eqSq = 0.0;
+    for (int r = 0; r < src.height; ++r) {
+        double lat = kPi * (0.5 - (r + 0.5) / src.height);
+        double a = std::cos(lat);
+        eqMin = std::min(eqMin, a);
+        eqMax = std::max(eqMax, a);
+        eqSum += a;
+        eqSq += a * a;
+    }
+    double eqMean = eqSum / src.height;
+    double eqCv = std::sqrt(std::max(0.0, eqSq / src.height - eqMean * eqMean)) / eqMean;
+
+    double cuMin = 1e30, cuMax = 0.0, cuSum = 0.0, cuSq = 0.0;
+    for (uint32_t j = 0; j < faceSize; ++j) {
+        for (uint32_t i = 0; i < faceSize; ++i) {
+            double s = 2.0 * (i + 0.5) / faceSize - 1.0;
+            double t = 2.0 * (j + 0.5) / faceSize - 1.0;
+            double a = std::pow(1.0 + s * s + t * t, -1.5);
+            cuMin = std::min(cuMin, a);
+            cuMax = std::max(cuMax, a);
+            cuSum += a;
+            cuSq += a * a;
+        }
+    }
+    double n = (double)faceSize * faceSize;
+    double cuMean = cuSum / n;
+    double cuCv = std::sqrt(std::max(0.0, cuSq / n - cuMean * cuMean)) / cuMean;
+
+    std::cout << "  Texel solid angle max/min: equirect " << eqMax / eqMin
+              << ", cubemap " << cuMax / cuMin << std::endl;
+    std::cout << "  Texel solid angle CV: equirect " << eqCv << ", cubemap " << cuCv << std::endl;
+}
+
+} // namespace
+
+bool bakeCubemaps(const std::string& texturesDir, const std::string& outDir) {
+    const char* names[][2] = {
+        { "Diffuse_2K.png", "earth_diffuse.ctex" },
+        { "Clouds_2K.png", "earth_clouds.ctex" },
+        { "Night_lights_2K.png", "earth_night.ctex" },
+    };
+
+    bool ok = true;
+    bool reported = false;
+    size_t equirectBytes = 0, cubeBytes = 0;
+    for (const auto& entry : names) {
+        Image src;
+        if (!loadImage(texturesDir + "/" + entry[0], src, 4)) {
+            ok = false;
+            continue;
+        }
+
+        const uint32_t faceSize = equalAreaFaceSize(src.width, src.height);
+        double start = nowMs();
+        Common::CookedTexture cube = equirectToCubemap(src, faceSize);
+        double elapsed = nowMs() - start;
+
+        // Equirect path uploads RGBA8 with a full mip chain (~4/3 of level 0)
+        equirectBytes += (size_t)src.width * src.height * 4 * 4 / 3;
+        cubeBytes += cube.byteSize();
+
+        std::cout << "Cubemap " << entry[1] << ": " << src.width << "x" << src.height
+                  << " -> 6x" << faceSize << "^2, " << cube.levels.size() << " mips, "
+                  << elapsed << " ms" << std::endl;
+        if (!reported) {
+            reportDensity(src, faceSize);
+            reported = true;
+        }
+
+        ok = Common::writeCookedTexture(outDir + "/" + entry[1], cube) && ok;
+    }
+
+    if (equirectBytes > 0) {
+        std::cout << "  VRAM: equirect " << equirectBytes / (1024.0 * 1024.0) << " MiB, cubemap "
+                  << cubeBytes / (1024.0 * 1024.0) << " MiB ("
+                  << 100.0 * cubeBytes / equirectBytes << "%)" << std::endl;
+    }
+    return ok;
+}
+
+} // namespace Bake
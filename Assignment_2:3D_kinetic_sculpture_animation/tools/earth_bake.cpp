@@ -0,0 +1,48 @@
+// Offline texture baker for the Earth texture pack.
+//
+// Usage: earth_bake <texturesDir> <outDir> [stage...]
+// Stages: cubemap, relief, coast, sh (default: all stages)
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "bake.hpp"
+#include "job_system.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv)
+{
+    Common::attachMainThread();
+    if (argc < 3) {
+        std::cout << "Usage: earth_bake <texturesDir> <outDir> [cubemap] [relief] [coast] [sh]" << std::endl;
+        return 1;
+    }
+
+    const std::string texturesDir = argv[1];
+    const std::string outDir = argv[2];
+    auto wants = [&](const char* stage) {
+        if (argc == 3)
+            return true;
+        for (int i = 3; i < argc; ++i)
+            if (std::strcmp(argv[i], stage) == 0)
+                return true;
+        return false;
+    };
+
+    bool ok = true;
+    double start = Bake::nowMs();
+    if (wants("cubemap"))
+        ok = Bake::bakeCubemaps(texturesDir, outDir) && ok;
+    if (wants("relief"))
+        ok = Bake::bakeRelief(texturesDir, outDir) && ok;
+    if (wants("coast"))
+        ok = Bake::bakeCoastline(texturesDir, outDir) && ok;
+    if (wants("sh"))
+        ok = Bake::bakeAmbientSH(outDir) && ok;
+
+    std::cout << "Bake finished in " << Bake::nowMs() - start << " ms" << std::endl;
+    return ok ? 0 : 1;
+}
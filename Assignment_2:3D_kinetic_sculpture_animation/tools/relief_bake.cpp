@@ -0,0 +1,172 @@
+#include "bake.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Bump_2K height map -> relief cubemap.
+//
+// Output texel layout (RGBA8):
+//   R, G  tangent-space normal xy (face right / face up), 0.5 bias
+//   B     height in [0, 1]
+//   A     sqrt of the cone ratio (face-UV distance per unit height), clamped to 1
+//
+// The cone ratio is the widest cone above the texel that stays clear of the
+// height field, so the shader can march with a fixed number of taps and never
+// step through a ridge. Cones are searched within kConeRadius texels; anything
+// beyond that can rise at most (1 - h), which bounds the ratio conservatively.
+
+namespace Bake {
+
+namespace {
+
+using Common::simd::float4;
+
+const int kConeRadius = 8;
+const int kConeWindow = 2 * kConeRadius + 1;
+const int kConeLanes = (kConeWindow + 3) / 4 * 4;
+
+// Height of one face with kConeRadius texels of clamped padding on each side
+struct PaddedFace {
+    int size = 0;
+    int stride = 0;
+    std::vector<float> heights;
+
+    float at(int x, int y) const {
+        return heights[(size_t)(y + kConeRadius) * stride + (x + kConeRadius)];
+    }
+    const float* row(int x, int y) const {
+        return heights.data() + (size_t)(y + kConeRadius) * stride + (x + kConeRadius);
+    }
+};
+
+PaddedFace extractFace(const Common::CookedTexture& cube, int face) {
+    const int n = (int)cube.levels[0].width;
+    PaddedFace out;
+    out.size = n;
+    out.stride = n + 2 * kConeRadius + kConeLanes;
+    out.heights.resize((size_t)out.stride * (n + 2 * kConeRadius));
+
+    const uint8_t* src = cube.levels[0].data.data() + (size_t)face * n * n * 4;
+    for (int y = -kConeRadius; y < n + kConeRadius; ++y) {
+        const int sy = std::clamp(y, 0, n - 1);
+        for (int x = -kConeRadius; x < out.stride - kConeRadius; ++x) {
+            const int sx = std::clamp(x, 0, n - 1);
+            out.heights[(size_t)(y + kConeRadius) * out.stride + (x + kConeRadius)] =
+                src[((size_t)sy * n + sx) * 4] / 255.0f;
+        }
+    }
+    return out;
+}
+
+// 3x3 Sobel, 4 texels per iteration. Returns normal xy in tangent space where
+// +x is face right and +y is face up (rows run downwards).
+void sobelRow(const PaddedFace& h, int y, float slopeScale, float* nx, float* ny) {
+    const float4 two(2.0f), scale(slopeScale), one(1.0f);
+    for (int x = 0; x < h.size; x += 4) {
+        const float* up = h.row(x, y - 1);
+        const float* mid = h.row(x, y);
+        const float* down = h.row(x, y + 1);
+
+        const float4 ul = float4::load(up - 1), uc = float4::load(up), ur = float4::load(up + 1);
+        const float4 ml = float4::load(mid - 1), mr = float4::load(mid + 1);
+        const float4 dl = float4::load(down - 1), dc = float4::load(down), dr = float4::load(down + 1);
+
+        const float4 gx = (ur + two * mr + dr) - (ul + two * ml + dl);
+        const float4 gy = (dl + two * dc + dr) - (ul + two * uc + ur);
+
+        // n = normalize(-dh/dright, -dh/dup, 1); dh/dup = -gy
+        const float4 sx = float4(0.0f) - gx * scale;
+        const float4 sy = gy * scale;
+        const float4 invLen = one / Common::simd::sqrt(sx * sx + sy * sy + one);
+        (sx * invLen).store(nx + x);
+        (sy * invLen).store(ny + x);
+    }
+}
+
+// Minimum of distance / rise over the window; rows of kConeLanes distances are
+// precomputed with padding lanes set to a huge distance so they never win.
+void coneRow(const PaddedFace& h, int y, const float* distances, float outsideDistance, float* cone) {
+    const float4 zero(0.0f), huge(1e30f);
+    for (int x = 0; x < h.size; ++x) {
+        const float hp = h.at(x, y);
+        const float4 base(hp);
+        // Conservative bound for everything outside the search window
+        float4 best(outsideDistance / std::max(1.0f - hp, 1e-6f));
+
+        for (int dy = -kConeRadius; dy <= kConeRadius; ++dy) {
+            const float* row = h.row(x - kConeRadius, y + dy);
+            const float* dist = distances + (size_t)(dy + kConeRadius) * kConeLanes;
+            for (int i = 0; i < kConeLanes; i += 4) {
+                const float4 rise = float4::load(row + i) - base;
+                const float4 ratio = float4::load(dist + i) / Common::simd::max(rise, float4(1e-6f));
+                best = Common::simd::min(best, Common::simd::select(rise > zero, ratio, huge));
+            }
+        }
+
+        float lanes[4];
+        best.store(lanes);
+        cone[x] = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+    }
+}
+
+} // namespace
+
+bool bakeRelief(const std::string& texturesDir, const std::string& outDir) {
+    Image src;
+    if (!loadImage(texturesDir + "/Bump_2K.png", src, 4))
+        return false;
+
+    double start = nowMs();
+    const uint32_t faceSize = equalAreaFaceSize(src.width, src.height);
+    Common::CookedTexture relief = equirectToCubemap(src, faceSize, false);
+    const int n = (int)faceSize;
+
+    // Heights in [0, 1] map to kReliefDepth face-UV units; one texel is 1/n of a face
+    const float texel = 1.0f / n;
+    const float slopeScale = kReliefDepth / (8.0f * texel);
+
+    // Window distances in face-UV units divided by the relief depth, so the
+    // stored ratio is horizontal distance per unit of normalized height
+    std::vector<float> distances((size_t)kConeWindow * kConeLanes, 1e30f);
+    for (int dy = -kConeRadius; dy <= kConeRadius; ++dy)
+        for (int dx = -kConeRadius; dx <= kConeRadius; ++dx)
+            distances[(size_t)(dy + kConeRadius) * kConeLanes + (dx + kConeRadius)] =
+                std::sqrt((float)(dx * dx + dy * dy)) * texel / kReliefDepth;
+    const float outsideDistance = kConeRadius * texel / kReliefDepth;
+
+    std::vector<PaddedFace> faces;
+    for (int face = 0; face < 6; ++face)
+        faces.push_back(extractFace(relief, face));
+
+    Common::parallelFor((size_t)n * 6, [&](size_t begin, size_t end) {
+        std::vector<float> nx(n + 4), ny(n + 4), cone(n);
+        for (size_t row = begin; row < end; ++row) {
+            const int face = (int)(row / n);
+            const int y = (int)(row % n);
+            const PaddedFace& h = faces[face];
+
+            sobelRow(h, y, slopeScale, nx.data(), ny.data());
+            coneRow(h, y, distances.data(), outsideDistance, cone.data());
+
+            uint8_t* out = relief.levels[0].data.data() + (((size_t)face * n + y) * n) * 4;
+            for (int x = 0; x < n; ++x) {
+                const float ratio = cone[x];
+                out[x * 4 + 0] = (uint8_t)std::lround(std::clamp(nx[x] * 0.5f + 0.5f, 0.0f, 1.0f) * 255.0f);
+                out[x * 4 + 1] = (uint8_t)std::lround(std::clamp(ny[x] * 0.5f + 0.5f, 0.0f, 1.0f) * 255.0f);
+                out[x * 4 + 2] = (uint8_t)std::lround(h.at(x, y) * 255.0f);
+                // Round down so the stored cone never grows past the baked one
+                out[x * 4 + 3] = (uint8_t)std::floor(std::sqrt(std::clamp(ratio, 0.0f, 1.0f)) * 255.0f);
+            }
+        }
+    }, 4);
+
+    buildMipChain(relief);
+    std::cout << "Relief earth_relief.ctex: 6x" << faceSize << "^2 normal + cone map, "
+              << nowMs() - start << " ms" << std::endl;
+    return Common::writeCookedTexture(outDir + "/earth_relief.ctex", relief);
+}
+
+} // namespace Bake
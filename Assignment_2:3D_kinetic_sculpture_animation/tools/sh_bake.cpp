@@ -0,0 +1,173 @@
+#include "bake.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+
+// Procedural space environment -> 9-coefficient SH irradiance.
+//
+// The environment (dim starfield plus a Milky Way band with a brighter core)
+// is evaluated over a virtual cubemap and projected onto the first three SH
+// bands, four texels per SIMD op. The cosine-lobe convolution and the basis
+// constants are folded into the output so the shader evaluates irradiance as
+//
+//   E(n) = c0 + c1 y + c2 z + c3 x + c4 xy + c5 yz + c6 (3z^2 - 1) + c7 xz + c8 (x^2 - y^2)
+//
+// Coefficients are scaled so the mean ambient equals kAmbientLevel (the old
+// flat 0.3 term), keeping the overall exposure unchanged. The shader still
+// multiplies by lightColor so the intensity controls affect both terms.
+//
+// Output: earth_sh.txt, nine lines of "r g b".
+
+namespace Bake {
+
+namespace {
+
+using Common::simd::float4;
+
+const float kPi = 3.14159265358979f;
+const int kFaceSize = 256;
+const float kAmbientLevel = 0.3f;
+
+// Galactic plane normal and galactic centre direction (world space)
+const float kGalaxyNormal[3] = { 0.0f, 0.8660254f, 0.5f };
+const float kGalaxyCore[3] = { 0.8660254f, 0.25f, -0.4330127f };
+
+// Radiance of the procedural environment for 4 directions
+void environmentRadiance(float4 x, float4 y, float4 z, const float* stars, float4 rgb[3]) {
+    const float4 one(1.0f);
+
+    // Band falls off as a squared Lorentzian of the distance to the galactic plane
+    const float4 g = x * float4(kGalaxyNormal[0]) + y * float4(kGalaxyNormal[1]) + z * float4(kGalaxyNormal[2]);
+    const float4 gw = g * float4(1.0f / 0.18f);
+    const float4 falloff = one / (one + gw * gw);
+    const float4 band = falloff * falloff;
+
+    // Brighter, warmer bulge towards the core
+    float4 c = Common::simd::max(x * float4(kGalaxyCore[0]) + y * float4(kGalaxyCore[1]) + z * float4(kGalaxyCore[2]),
+                                 float4(0.0f));
+    c = c * c;
+    const float4 core = band * c * c;
+
+    const float4 star = float4::load(stars);
+    const float4 base(0.02f);
+    rgb[0] = base + band * float4(0.55f) + core * float4(1.6f) + star;
+    rgb[1] = base + band * float4(0.6f) + core * float4(1.2f) + star;
+    rgb[2] = base * float4(1.5f) + band * float4(0.8f) + core * float4(0.7f) + star;
+}
+
+// Sparse stars: roughly 1 texel in 200 lights up with a random brightness
+float starAt(uint32_t face, uint32_t i, uint32_t j) {
+    uint32_t h = (face * 73856093u) ^ (i * 19349663u) ^ (j * 83492791u);
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    if (h % 200u != 0)
+        return 0.0f;
+    const float b = (float)((h >> 8) & 0xFF) / 255.0f;
+    return 4.0f * b * b * b;
+}
+
+} // namespace
+
+bool bakeAmbientSH(const std::string& outDir) {
+    double start = nowMs();
+
+    // Accumulators: 9 basis functions x RGB, each a float4 of lane partial sums
+    float total[9][3] = {};
+    std::mutex totalMutex;
+
+    const float texel = 2.0f / kFaceSize;
+    const float4 lane(0.0f, 1.0f, 2.0f, 3.0f);
+
+    Common::parallelFor((size_t)kFaceSize * 6, [&](size_t begin, size_t end) {
+        float4 sum[9][3];
+        for (auto& basis : sum)
+            for (auto& channel : basis)
+                channel = float4(0.0f);
+
+        for (size_t row = begin; row < end; ++row) {
+            const int face = (int)(row / kFaceSize);
+            const int j = (int)(row % kFaceSize);
+            const float4 t((j + 0.5f) * texel - 1.0f);
+
+            for (int i = 0; i < kFaceSize; i += 4) {
+                const float4 s = (float4((float)i + 0.5f) + lane) * float4(texel) - float4(1.0f);
+                float4 x, y, z;
+                cubeFaceDirection(face, s, t, x, y, z);
+
+                // Normalize and weight by the texel's solid angle, (1 + s^2 + t^2)^-3/2 texel^2
+                const float4 lenSq = x * x + y * y + z * z;
+                const float4 invLen = float4(1.0f) / Common::simd::sqrt(lenSq);
+                x = x * invLen;
+                y = y * invLen;
+                z = z * invLen;
+                const float4 weight = invLen * invLen * invLen * float4(texel * texel);
+
+                float stars[4];
+                for (int k = 0; k < 4; ++k)
+                    stars[k] = starAt((uint32_t)face, (uint32_t)(i + k), (uint32_t)j);
+                float4 rgb[3];
+                environmentRadiance(x, y, z, stars, rgb);
+
+                const float4 basis[9] = {
+                    float4(1.0f), y, z, x,
+                    x * y, y * z, float4(3.0f) * z * z - float4(1.0f), x * z, x * x - y * y,
+                };
+                for (int c = 0; c < 3; ++c) {
+                    const float4 weighted = rgb[c] * weight;
+                    for (int b = 0; b < 9; ++b)
+                        sum[b][c] = Common::simd::madd(basis[b], weighted, sum[b][c]);
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(totalMutex);
+        for (int b = 0; b < 9; ++b)
+            for (int c = 0; c < 3; ++c)
+                total[b][c] += Common::simd::horizontalSum(sum[b][c]);
+    }, 16);
+
+    // Squared basis constants (one for the projection, one for evaluation)
+    // times the clamped-cosine convolution per band, divided by pi for Lambert
+    const float k0 = 0.282095f, k1 = 0.488603f, k2 = 1.092548f, k20 = 0.315392f, k22 = 0.546274f;
+    const float a0 = kPi, a1 = 2.0f * kPi / 3.0f, a2 = kPi / 4.0f;
+    const float fold[9] = {
+        a0 * k0 * k0, a1 * k1 * k1, a1 * k1 * k1, a1 * k1 * k1,
+        a2 * k2 * k2, a2 * k2 * k2, a2 * k20 * k20, a2 * k2 * k2, a2 * k22 * k22,
+    };
+
+    float coeffs[9][3];
+    for (int b = 0; b < 9; ++b)
+        for (int c = 0; c < 3; ++c)
+            coeffs[b][c] = total[b][c] * fold[b] / kPi;
+
+    // The higher bands average to zero, so c0 is the mean ambient
+    const float meanLuma = 0.2126f * coeffs[0][0] + 0.7152f * coeffs[0][1] + 0.0722f * coeffs[0][2];
+    const float scale = kAmbientLevel / meanLuma;
+    for (auto& coeff : coeffs)
+        for (float& channel : coeff)
+            channel *= scale;
+
+    const double elapsed = nowMs() - start;
+
+    const std::string path = outDir + "/earth_sh.txt";
+    std::ofstream file(path);
+    if (!file) {
+        std::cout << "ERROR::BAKE::CANNOT_WRITE: " << path << std::endl;
+        return false;
+    }
+    for (const auto& coeff : coeffs)
+        file << coeff[0] << " " << coeff[1] << " " << coeff[2] << "\n";
+
+    std::cout << "Ambient SH earth_sh.txt: 9 coefficients from 6x" << kFaceSize << "^2 directions, "
+              << elapsed << " ms" << std::endl;
+    return (bool)file;
+}
+
+} // namespace Bake
@@ -0,0 +1,55 @@
+#pragma once
+
+// Timing and reporting helpers shared by the benchmarks
+
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+inline double msSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// 1, 2, 4, .. threads, ending with every worker
+inline std::vector<unsigned int> benchThreadCounts() {
+    std::vector<unsigned int> counts;
+    for (unsigned int threads = 1; threads < Common::workerCount(); threads *= 2)
+        counts.push_back(threads);
+    counts.push_back(Common::workerCount());
+    return counts;
+}
+
+// "label, n threads"
+inline std::string threadLabel(const std::string& label, unsigned int threads) {
+    return label + ", " + std::to_string(threads) + " thread" + (threads > 1 ? "s" : "");
+}
+
+// Fastest of repeats runs of f, in ms. f may take the repeat index, for
+// benchmarks that vary their input between runs.
+template <typename F>
+double bestOf(int repeats, F&& f) {
+    double best = 1e30;
+    for (int i = 0; i < repeats; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        if constexpr (std::is_invocable_v<F&, int>)
+            f(i);
+        else
+            f();
+        best = std::min(best, msSince(start));
+    }
+    return best;
+}
+
+// "label: ms, ns per unit", and the speedup over serialMs when given
+inline void report(const std::string& label, double ms, size_t count, const char* unit, double serialMs = 0.0) {
+    std::cout << label << ": " << ms << " ms, " << ms * 1.0e6 / count << " ns per " << unit;
+    if (serialMs > 0.0)
+        std::cout << ", " << serialMs / ms << "x serial";
+    std::cout << std::endl;
+}
@@ -0,0 +1,214 @@
+// Benchmark: dynamic BVH build, refit and queries.
+//
+// At 100k and 1M primitives: small random boxes in a 200-unit cube. Times
+// the SAH build, then 60 frames in which every box drifts a little, each
+// followed by a refit (on 1 thread up to every worker), and the SAH cost of
+// the refit tree against a fresh build of the same boxes. Then queries on
+// the drifted tree, each checked against a brute-force loop over every box:
+// a view frustum, 1000 small overlap boxes and 1000 rays for the nearest hit
+// (the first 50 of each checked).
+//
+// Usage: bvh_bench [primitives] [frames]
+
+#include "bench_common.hpp"
+#include "bvh.hpp"
+#include "job_system.hpp"
+#include "parallel.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const size_t kQueries = 1000;
+const size_t kChecked = 50;     // queries also answered by brute force
+
+struct Scene {
+    std::vector<glm::vec3> centers;
+    std::vector<glm::vec3> velocities;
+    std::vector<glm::vec3> extents;
+    std::vector<Common::Aabb> bounds;
+
+    void update() {
+        for (size_t i = 0; i < centers.size(); ++i)
+            bounds[i] = { centers[i] - extents[i], centers[i] + extents[i] };
+    }
+
+    void drift(float dt) {
+        for (size_t i = 0; i < centers.size(); ++i)
+            centers[i] += velocities[i] * dt;
+        update();
+    }
+};
+
+bool overlaps(const Common::Aabb& a, const Common::Aabb& b) {
+    return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y && a.max.y >= b.min.y &&
+           a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+bool outside(const Common::Frustum& frustum, const Common::Aabb& box) {
+    for (const glm::vec4& plane : frustum.planes) {
+        const float distance = plane.x * (plane.x >= 0.0f ? box.max.x : box.min.x) +
+                          plane.y * (plane.y >= 0.0f ? box.max.y : box.min.y) +
+                          plane.z * (plane.z >= 0.0f ? box.max.z : box.min.z) + plane.w;
+        if (distance < 0.0f)
+            return true;
+    }
+    return false;
+}
+
+float rayEnter(const Common::Aabb& box, const glm::vec3& origin, const glm::vec3& inverse, float maxDistance) {
+    const glm::vec3 t0 = (box.min - origin) * inverse, t1 = (box.max - origin) * inverse;
+    const glm::vec3 entries = glm::min(t0, t1), exits = glm::max(t0, t1);
+    const float enter = std::max(std::max(entries.x, entries.y), std::max(entries.z, 0.0f));
+    const float leave = std::min(exits.x, std::min(exits.y, exits.z));
+    return enter <= leave && enter < maxDistance ? enter : maxDistance;
+}
+
+void run(size_t count, int frames) {
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f), size(0.05f, 0.5f), speed(-2.0f, 2.0f);
+    Scene scene;
+    scene.centers.resize(count);
+    scene.velocities.resize(count);
+    scene.extents.resize(count);
+    scene.bounds.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        scene.centers[i] = glm::vec3(position(rng), position(rng), position(rng));
+        scene.velocities[i] = glm::vec3(speed(rng), speed(rng), speed(rng));
+        scene.extents[i] = glm::vec3(size(rng), size(rng), size(rng));
+    }
+    scene.update();
+    std::cout << count << " primitives, " << Common::workerCount() << " workers" << std::endl;
+
+    Common::Bvh bvh;
+    auto start = std::chrono::steady_clock::now();
+    bvh.build(scene.bounds.data(), count);
+    std::cout << "  build: " << msSince(start) << " ms, " << bvh.nodeCount() << " nodes of " << sizeof(Common::Bvh::Node)
+              << " bytes" << std::endl;
+
+    // Refit: the same frames for every thread count, from the same start
+    const std::vector<unsigned int> threadCounts = benchThreadCounts();
+    const Scene initial = scene;
+    for (unsigned int threads : threadCounts) {
+        scene = initial;
+        bvh.build(scene.bounds.data(), count, threads);
+        double refitMs = 0.0;
+        for (int frame = 0; frame < frames; ++frame) {
+            scene.drift(1.0f / 60.0f);
+            start = std::chrono::steady_clock::now();
+            bvh.refit(scene.bounds.data(), threads);
+            refitMs += msSince(start);
+        }
+        std::cout << threadLabel("  refit", threads) << ": " << refitMs / frames
+                  << " ms per frame, " << refitMs * 1.0e6 / ((double)frames * count) << " ns per primitive"
+                  << std::endl;
+    }
+    std::cout << "  after " << frames << " frames: SAH cost " << bvh.degradation() << "x the build's";
+
+    // A background rebuild of the drifted boxes, and what it wins back
+    start = std::chrono::steady_clock::now();
+    bvh.beginRebuild(scene.bounds.data());
+    while (!bvh.finishRebuild(scene.bounds.data()))
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    std::cout << ", rebuilt in the background in " << msSince(start) << " ms" << std::endl;
+
+    Common::Bvh refitted;
+    refitted.build(initial.bounds.data(), count);
+    refitted.refit(scene.bounds.data());
+
+    // Frustum from the middle of the cube
+    const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    const glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    const Common::Frustum frustum = Common::extractFrustum(projection * view);
+    std::vector<uint32_t> found, expected;
+    for (const Common::Bvh* tree : { &refitted, &bvh }) {
+        found.clear();
+        start = std::chrono::steady_clock::now();
+        tree->inFrustum(frustum, found);
+        std::cout << "  frustum (" << (tree == &bvh ? "rebuilt" : "refit") << "): " << msSince(start) << " ms, "
+                  << found.size() << " visible";
+        expected.clear();
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            if (!outside(frustum, scene.bounds[i]))
+                expected.push_back((uint32_t)i);
+        }
+        std::cout << " (brute force " << msSince(start) << " ms)" << std::endl;
+        std::sort(found.begin(), found.end());
+        if (found != expected)
+            std::cout << "ERROR::BVH_BENCH::MISMATCH: frustum query differs from brute force" << std::endl;
+    }
+
+    // Small overlap boxes and rays, the same for both trees
+    std::vector<Common::Aabb> boxes(kQueries);
+    std::vector<glm::vec3> origins(kQueries), directions(kQueries);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    for (size_t q = 0; q < kQueries; ++q) {
+        const glm::vec3 center(position(rng), position(rng), position(rng));
+        boxes[q] = { center - glm::vec3(2.0f), center + glm::vec3(2.0f) };
+        origins[q] = glm::vec3(position(rng), position(rng), position(rng));
+        directions[q] = glm::normalize(glm::vec3(normal(rng), normal(rng), normal(rng)));
+    }
+    for (const Common::Bvh* tree : { &refitted, &bvh }) {
+        size_t hits = 0, mismatches = 0;
+        start = std::chrono::steady_clock::now();
+        for (const Common::Aabb& box : boxes) {
+            found.clear();
+            tree->overlapping(box, found);
+            hits += found.size();
+        }
+        const double overlapMs = msSince(start);
+        for (size_t q = 0; q < kChecked; ++q) {
+            found.clear();
+            tree->overlapping(boxes[q], found);
+            size_t brute = 0;
+            for (const Common::Aabb& box : scene.bounds)
+                brute += overlaps(box, boxes[q]);
+            mismatches += found.size() != brute;
+        }
+
+        start = std::chrono::steady_clock::now();
+        std::vector<float> distances(kQueries, 1000.0f);
+        for (size_t q = 0; q < kQueries; ++q) {
+            uint32_t primitive;
+            tree->raycast(origins[q], directions[q], 1000.0f, primitive, distances[q]);
+        }
+        const double rayMs = msSince(start);
+        for (size_t q = 0; q < kChecked; ++q) {
+            const glm::vec3 inverse = 1.0f / directions[q];
+            float nearest = 1000.0f;
+            for (const Common::Aabb& box : scene.bounds)
+                nearest = std::min(nearest, rayEnter(box, origins[q], inverse, nearest));
+            mismatches += nearest != distances[q];
+        }
+        std::cout << "  " << (tree == &bvh ? "rebuilt" : "refit") << ": " << overlapMs * 1.0e3 / kQueries
+                  << " us per overlap query (" << hits / kQueries << " hits avg), " << rayMs * 1.0e3 / kQueries
+                  << " us per ray" << std::endl;
+        if (mismatches)
+            std::cout << "ERROR::BVH_BENCH::MISMATCH: " << mismatches << " queries differ from brute force" << std::endl;
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Common::attachMainThread();
+    const int frames = argc > 2 ? std::max(1, std::atoi(argv[2])) : 60;
+    if (argc > 1) {
+        run((size_t)std::max(1, std::atoi(argv[1])), frames);
+        return 0;
+    }
+    run(100000, frames);
+    run(1000000, frames);
+    return 0;
+}
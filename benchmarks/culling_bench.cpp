@@ -0,0 +1,105 @@
+// Benchmark: frustum culling throughput.
+//
+// 1M objects (half spheres, half boxes of random size) scattered through a
+// 400-unit cube around a camera with a 45 degree field of view, so roughly
+// one in twenty is in view. The view turns a little between repeats. A plain
+// loop testing one object at a time against an array of structs is the
+// baseline, and its visible list checks the SIMD one; then CullingSet on 1
+// thread up to every worker.
+//
+// Usage: culling_bench [objects] [repeats]
+
+#include "bench_common.hpp"
+#include "culling.hpp"
+#include "job_system.hpp"
+#include "parallel.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct Bounds {
+    glm::vec3 center;
+    glm::vec3 extent;
+    float radius;
+};
+
+Common::Frustum viewFrustum(int repeat) {
+    const float yaw = 0.05f * repeat;
+    const glm::vec3 forward(std::sin(yaw), 0.0f, -std::cos(yaw));
+    const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), forward, glm::vec3(0.0f, 1.0f, 0.0f));
+    const glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 200.0f);
+    return Common::extractFrustum(projection * view);
+}
+
+// The same test as CullingSet, one object at a time
+void scalarCull(const Common::Frustum& frustum, const std::vector<Bounds>& objects, std::vector<uint32_t>& visible) {
+    visible.clear();
+    for (size_t i = 0; i < objects.size(); ++i) {
+        const Bounds& b = objects[i];
+        bool outside = false;
+        for (const glm::vec4& plane : frustum.planes) {
+            // Summed in the SIMD kernel's order, so both agree to the last bit
+            const float distance = plane.x * b.center.x + (plane.y * b.center.y + (plane.z * b.center.z + plane.w));
+            const float reach = std::min(std::fabs(plane.x) * b.extent.x +
+                                         (std::fabs(plane.y) * b.extent.y + std::fabs(plane.z) * b.extent.z),
+                                         b.radius);
+            if (distance + reach < 0.0f) {
+                outside = true;
+                break;
+            }
+        }
+        if (!outside)
+            visible.push_back((uint32_t)i);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Common::attachMainThread();
+    const size_t count = argc > 1 ? (size_t)std::max(1, std::atoi(argv[1])) : 1000000;
+    const int repeats = argc > 2 ? std::max(1, std::atoi(argv[2])) : 10;
+
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> position(-200.0f, 200.0f), size(0.1f, 2.0f);
+    std::vector<Bounds> objects(count);
+    Common::CullingSet set;
+    set.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        const glm::vec3 center(position(rng), position(rng), position(rng));
+        if (i % 2 == 0) {
+            const float radius = size(rng);
+            objects[i] = { center, glm::vec3(radius), radius };
+            set.setSphere(i, center, radius);
+        } else {
+            const glm::vec3 extent(size(rng), size(rng), size(rng));
+            objects[i] = { center, extent, glm::length(extent) };
+            set.setBox(i, center - extent, center + extent);
+        }
+    }
+    std::cout << count << " objects, " << Common::workerCount() << " workers" << std::endl;
+
+    std::vector<uint32_t> expected, visible;
+    const double scalarMs = bestOf(repeats, [&](int repeat) { scalarCull(viewFrustum(repeat), objects, expected); });
+    report("scalar, array of structs", scalarMs, count, "object");
+    std::cout << expected.size() << " visible" << std::endl;
+
+    const std::vector<unsigned int> threadCounts = benchThreadCounts();
+    for (unsigned int threads : threadCounts) {
+        const double ms = bestOf(repeats, [&](int repeat) { set.cull(viewFrustum(repeat), visible, threads); });
+        report(threadLabel("CullingSet", threads), ms, count, "object");
+        if (visible != expected)
+            std::cout << "ERROR::CULLING_BENCH::MISMATCH: SIMD visible list differs from the scalar loop" << std::endl;
+    }
+    return 0;
+}
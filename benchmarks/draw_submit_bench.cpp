@@ -0,0 +1,225 @@
+// Benchmark: draw calls and CPU submit time for N static objects going
+// through the render queue, with every mesh in one GeometryArena.
+//
+//   per-draw    one glDrawElementsBaseVertex per object, transform in ObjectBlock
+//   instanced   one draw per object, transform from the instance attribute
+//   multi-draw  the instanced packets collapsed into glMultiDrawElementsIndirect
+//
+// Packets are recorded in parallel every frame, as in the app. Submit time is
+// the CPU side of RenderQueue::submit() (sort included), averaged over the
+// frames after a warm-up; glFinish between frames keeps the driver's queue
+// from piling up.
+//
+// Usage: draw_submit_bench [frames]
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "bench_common.hpp"
+#include "geometry_arena.hpp"
+#include "job_system.hpp"
+#include "program_cache.hpp"
+#include "render_queue.hpp"
+#include "shader_permutations.hpp"
+#include "uniform_blocks.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char* kPerDrawVertex = R"(
+layout (location = 0) in vec3 aPos;
+void main() { gl_Position = modelViewProjection * vec4(aPos, 1.0); }
+)";
+
+const char* kInstancedVertex = R"(
+layout (location = 0) in vec3 aPos;
+layout (location = 4) in mat4 instanceModel;
+void main() { gl_Position = viewProjection * instanceModel * vec4(aPos, 1.0); }
+)";
+
+const char* kFragment = R"(
+out vec4 FragColor;
+void main() { FragColor = vec4(1.0); }
+)";
+
+// UV sphere with the given number of rings, positions only
+void sphereMesh(int rings, std::vector<float>& vertices, std::vector<unsigned int>& indices) {
+    const int segments = rings * 2;
+    vertices.clear();
+    indices.clear();
+    for (int ring = 0; ring <= rings; ++ring) {
+        float phi = (float)M_PI * ring / rings;
+        for (int segment = 0; segment <= segments; ++segment) {
+            float theta = 2.0f * (float)M_PI * segment / segments;
+            vertices.push_back(std::sin(phi) * std::cos(theta));
+            vertices.push_back(std::cos(phi));
+            vertices.push_back(std::sin(phi) * std::sin(theta));
+        }
+    }
+    for (int ring = 0; ring < rings; ++ring) {
+        for (int segment = 0; segment < segments; ++segment) {
+            unsigned int current = ring * (segments + 1) + segment;
+            unsigned int next = current + segments + 1;
+            indices.insert(indices.end(), { current, next, current + 1, current + 1, next, next + 1 });
+        }
+    }
+}
+
+enum class Mode { PerDraw, Instanced, MultiDraw };
+
+struct Result {
+    size_t drawCalls = 0;
+    double recordMs = 0.0;
+    double submitMs = 0.0;
+    double sortMs = 0.0;
+};
+
+Result run(Mode mode, size_t objects, int frames, Common::RenderQueue& queue, Common::GeometryArena& arena,
+           const std::vector<Common::GeometryArena::MeshId>& meshes, unsigned int program,
+           Common::UniformBuffer<Common::ObjectBlock>& objectUniforms, const glm::mat4& viewProjection) {
+    queue.setMultiDraw(mode == Mode::MultiDraw);
+    const int warmUp = 2;
+    Result result;
+    for (int frame = 0; frame < warmUp + frames; ++frame) {
+        auto recordStart = std::chrono::steady_clock::now();
+        queue.beginFrame();
+        queue.record(objects, [&](Common::CommandList& list, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                // Objects on a grid of 100 x 100 x n, a mesh each from the arena
+                const Common::GeometryArena::Range& range = arena.range(meshes[i % meshes.size()]);
+                glm::vec3 position((float)(i % 100) - 50.0f, (float)(i / 100 % 100) - 50.0f, -(float)(i / 10000) - 60.0f);
+                Common::ObjectBlock object;
+                object.model = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.4f));
+                object.modelViewProjection = viewProjection * object.model;
+
+                Common::DrawPacket packet;
+                packet.key = Common::makeSortKey(0, program, 0, -position.z / 100.0f);
+                packet.program = program;
+                packet.vertexArray = arena.vertexArray();
+                packet.indexCount = range.indexCount;
+                packet.firstIndex = range.firstIndex;
+                packet.baseVertex = range.baseVertex;
+                packet.instanced = mode != Mode::PerDraw;
+                list.draw(packet, object);
+            }
+        }, 256);
+        double recordMs = msSince(recordStart);
+
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        queue.submit(objectUniforms);
+        glFinish();
+
+        if (frame >= warmUp) {
+            result.drawCalls = queue.stats().drawCalls;
+            result.recordMs += recordMs / frames;
+            result.submitMs += queue.stats().submitMs / frames;
+            result.sortMs += queue.stats().sortMs / frames;
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Common::attachMainThread();
+    const int frames = argc > 1 ? std::max(1, std::atoi(argv[1])) : 10;
+
+    if (!glfwInit()) {
+        std::cout << "Failed to initialize GLFW" << std::endl;
+        return 1;
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    GLFWwindow* window = glfwCreateWindow(256, 256, "draw_submit_bench", nullptr, nullptr);
+    if (window == nullptr) {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return 1;
+    }
+
+    // The shared block declarations, so the layouts match uniform_blocks.hpp
+    std::string blocks;
+    if (!Common::loadShaderSource(EARTH_SHADER_DIR "/include/uniform_blocks.glsl", blocks))
+        return 1;
+    const std::string header = "#version 330 core\n" + blocks;
+    unsigned int perDrawProgram = Common::compileProgram(header + kPerDrawVertex, header + kFragment);
+    unsigned int instancedProgram = Common::compileProgram(header + kInstancedVertex, header + kFragment);
+    if (!perDrawProgram || !instancedProgram)
+        return 1;
+    Common::bindUniformBlocks(perDrawProgram);
+    Common::bindUniformBlocks(instancedProgram);
+
+    // 16 spheres of different density share the arena
+    Common::GeometryArena arena(3 * sizeof(float), { { 0, 3, 0 } });
+    arena.create();
+    std::vector<Common::GeometryArena::MeshId> meshes;
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    for (int rings = 3; rings < 19; ++rings) {
+        sphereMesh(rings, vertices, indices);
+        meshes.push_back(arena.upload(vertices.data(), vertices.size() / 3, indices.data(), indices.size()));
+    }
+
+    glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 200.0f);
+    Common::UniformBuffer<Common::FrameBlock> frameUniforms;
+    Common::UniformBuffer<Common::ObjectBlock> objectUniforms;
+    frameUniforms.create(Common::FRAME_BLOCK_BINDING);
+    objectUniforms.create(Common::OBJECT_BLOCK_BINDING);
+    Common::FrameBlock frame;
+    frame.viewProjection = viewProjection;
+    frameUniforms.upload(frame);
+    glEnable(GL_DEPTH_TEST);
+
+    std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
+    std::cout << meshes.size() << " meshes in one arena, " << frames << " frames per run, multi-draw indirect "
+              << (Common::multiDrawIndirectSupported() ? "supported" : "not supported") << std::endl;
+
+    Common::RenderQueue queue;
+    for (size_t objects : { 1000u, 10000u, 100000u }) {
+        struct { Mode mode; const char* label; unsigned int program; } modes[] = {
+            { Mode::PerDraw, "per-draw", perDrawProgram },
+            { Mode::Instanced, "instanced", instancedProgram },
+            { Mode::MultiDraw, "multi-draw", instancedProgram },
+        };
+        for (const auto& mode : modes) {
+            if (mode.mode == Mode::MultiDraw && !Common::multiDrawIndirectSupported())
+                continue;
+            Result result = run(mode.mode, objects, frames, queue, arena, meshes, mode.program,
+                                objectUniforms, viewProjection);
+            std::cout << objects << " objects, " << mode.label << ": " << result.drawCalls << " draw calls, "
+                      << result.submitMs << " ms submit (" << result.sortMs << " ms sort), "
+                      << result.recordMs << " ms record" << std::endl;
+        }
+    }
+
+    queue.destroy();
+    arena.destroy();
+    frameUniforms.destroy();
+    objectUniforms.destroy();
+    glDeleteProgram(perDrawProgram);
+    glDeleteProgram(instancedProgram);
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+}
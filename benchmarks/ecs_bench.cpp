@@ -0,0 +1,102 @@
+// Benchmark: entity iteration throughput.
+//
+// 10^6 entities in three archetypes: spinning bodies (Transform, Spin,
+// WorldMatrix), static bodies (Transform, WorldMatrix) and lights
+// (Transform, Light). Times the scene systems (spin on one thread, world
+// matrices on 1 thread up to every worker) against the same loops over an
+// array of structs holding every component of an entity.
+//
+// Usage: ecs_bench [entities] [repeats]
+
+#include "bench_common.hpp"
+#include "ecs.hpp"
+#include "job_system.hpp"
+#include "scene.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+// Array-of-structs baseline: every component of one entity side by side
+struct Object {
+    Common::Transform transform;
+    Common::Spin spin;
+    Common::WorldMatrix matrix;
+    Common::Light light;
+    bool spins;
+    bool lit;
+};
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Common::attachMainThread();
+    const size_t count = argc > 1 ? (size_t)std::max(1, std::atoi(argv[1])) : 1000000;
+    const int repeats = argc > 2 ? std::max(1, std::atoi(argv[2])) : 10;
+
+    // 3 in 4 spin, 1 in 4 is static, 1 in 64 of those is a light instead
+    Common::World world;
+    std::vector<Object> objects(count);
+    size_t spinning = 0, matrices = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        Common::Transform transform;
+        transform.position = glm::vec3((float)(i % 1000), (float)(i / 1000 % 1000), 0.0f);
+        transform.spinAxis = glm::normalize(glm::vec3(1.0f, (float)(i % 7), 0.5f));
+        Object& object = objects[i];
+        object.transform = transform;
+        object.spins = i % 4 != 0;
+        object.lit = !object.spins && i % 256 == 0;
+        if (object.spins) {
+            object.spin.speed = 0.001f * (float)(i % 1000);
+            world.create(transform, object.spin, Common::WorldMatrix());
+            spinning++;
+        } else if (object.lit) {
+            world.create(transform, object.light);
+        } else {
+            world.create(transform, Common::WorldMatrix());
+        }
+        matrices += object.lit ? 0 : 1;
+    }
+    std::cout << world.size() << " entities in " << world.archetypeCount() << " archetypes, created in "
+              << msSince(start) << " ms (" << spinning << " spinning, " << matrices << " with matrices)"
+              << std::endl;
+
+    // Spin: a light loop, so it mostly measures how much memory each entity drags in
+    report("spin, chunks (SoA)", bestOf(repeats, [&](int r) {
+        Common::updateSpin(world, 1.0f + r);
+    }), spinning, "entity");
+    report("spin, array of structs", bestOf(repeats, [&](int r) {
+        const float time = 1.0f + r;
+        for (Object& object : objects) {
+            if (object.spins)
+                object.transform.spinAngle = object.spin.enabled ? object.spin.speed * time : 0.0f;
+        }
+    }), spinning, "entity");
+
+    // World matrices: enough arithmetic per entity for threads to pay off
+    const std::vector<unsigned int> threadCounts = benchThreadCounts();
+    for (unsigned int threads : threadCounts) {
+        report(threadLabel("world matrices, chunks", threads), bestOf(repeats, [&](int) {
+            Common::updateWorldMatrices(world, threads);
+        }), matrices, "entity");
+    }
+    report("world matrices, array of structs, 1 thread", bestOf(repeats, [&](int) {
+        for (Object& object : objects) {
+            if (object.lit)
+                continue;
+            const Common::Transform& transform = object.transform;
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), transform.position);
+            model = glm::rotate(model, transform.spinAngle, transform.spinAxis);
+            object.matrix.model = glm::scale(model, glm::vec3(transform.scale));
+        }
+    }), matrices, "entity");
+    return 0;
+}
@@ -0,0 +1,171 @@
+// Benchmark: job system against std::async on fine-grained tasks.
+//
+// Each task burns a fixed amount of arithmetic, at three sizes (roughly 0.1,
+// 1 and 10 us on a desktop core). For each size the same tasks run as a
+// serial loop, one std::async per task, std::async in waves of workerCount()
+// tasks, one submitJob per task waited on with a counter, and a parallelFor
+// over the tasks. Then scaling at the middle size: parallelFor held to 1, 2,
+// .. workerCount() pieces, against std::async splitting the tasks the same
+// way. Last, dependent phases: each phase reads what the previous one wrote,
+// chained with counters (all phases submitted up front) or with std::async
+// and get() between phases.
+//
+// Usage: job_bench [tasks] [phases]
+
+#include "bench_common.hpp"
+#include "job_system.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+const size_t kPhaseWidth = 64;
+
+// xorshift and a multiply-add per round, so the work cannot be folded away
+float burn(uint32_t seed, int rounds) {
+    uint32_t x = seed | 1u;
+    float sum = 0.0f;
+    for (int i = 0; i < rounds; ++i) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        sum = sum * 0.999f + (float)(x & 0xffffu) * (1.0f / 65536.0f);
+    }
+    return sum;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const size_t tasks = argc > 1 ? (size_t)std::max(1, std::atoi(argv[1])) : 20000;
+    const size_t phases = argc > 2 ? (size_t)std::max(1, std::atoi(argv[2])) : 500;
+    const unsigned int workers = Common::workerCount();
+    std::cout << tasks << " tasks, " << workers << " workers" << std::endl;
+
+    std::vector<float> results(tasks), expected(tasks);
+    for (int rounds : { 25, 250, 2500 }) {
+        auto serial = [&] {
+            for (size_t i = 0; i < tasks; ++i)
+                results[i] = burn((uint32_t)i, rounds);
+        };
+        const double serialMs = bestOf(3, serial);
+        expected = results;
+        std::cout << rounds << " rounds per task, serial " << serialMs << " ms, "
+                  << serialMs * 1.0e6 / tasks << " ns per task" << std::endl;
+
+        // One thread per task: std::async's cost for a task of any size
+        report("  std::async per task", bestOf(1, [&] {
+            std::vector<std::future<void>> futures;
+            futures.reserve(tasks);
+            for (size_t i = 0; i < tasks; ++i)
+                futures.push_back(std::async(std::launch::async, [&, i] { results[i] = burn((uint32_t)i, rounds); }));
+            for (std::future<void>& future : futures)
+                future.get();
+        }), tasks, "task", serialMs);
+
+        report("  std::async in waves of " + std::to_string(workers), bestOf(1, [&] {
+            std::vector<std::future<void>> futures;
+            for (size_t first = 0; first < tasks; first += workers) {
+                futures.clear();
+                for (size_t i = first; i < std::min(tasks, first + workers); ++i)
+                    futures.push_back(std::async(std::launch::async, [&, i] { results[i] = burn((uint32_t)i, rounds); }));
+                for (std::future<void>& future : futures)
+                    future.get();
+            }
+        }), tasks, "task", serialMs);
+
+        report("  submitJob per task", bestOf(3, [&] {
+            Common::JobCounter counter;
+            for (size_t i = 0; i < tasks; ++i)
+                Common::submitJob([&results, i, rounds] { results[i] = burn((uint32_t)i, rounds); }, &counter);
+            Common::waitForCounter(counter);
+        }), tasks, "task", serialMs);
+        if (results != expected)
+            std::cout << "ERROR::JOB_BENCH::MISMATCH: submitJob results differ from the serial loop" << std::endl;
+
+        report("  parallelFor, adaptive", bestOf(3, [&] {
+            Common::parallelFor(tasks, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i)
+                    results[i] = burn((uint32_t)i, rounds);
+            });
+        }), tasks, "task", serialMs);
+        if (results != expected)
+            std::cout << "ERROR::JOB_BENCH::MISMATCH: parallelFor results differ from the serial loop" << std::endl;
+    }
+
+    // Scaling: the same split over the job system and over std::async
+    const int scalingRounds = 250;
+    auto range = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            results[i] = burn((uint32_t)i, scalingRounds);
+    };
+    const double scalingSerialMs = bestOf(3, [&] { range(0, tasks); });
+    const std::vector<unsigned int> threadCounts = benchThreadCounts();
+    std::cout << "scaling, " << scalingRounds << " rounds per task, serial " << scalingSerialMs << " ms" << std::endl;
+    for (unsigned int threads : threadCounts) {
+        const std::string pieces = std::to_string(threads) + " piece" + (threads > 1 ? "s" : "");
+        report("  parallelFor, " + pieces, bestOf(3, [&] {
+            Common::parallelFor(tasks, range, (tasks + threads - 1) / threads);
+        }), tasks, "task", scalingSerialMs);
+        report("  std::async, " + pieces, bestOf(3, [&] {
+            std::vector<std::future<void>> futures;
+            for (unsigned int piece = 0; piece < threads; ++piece)
+                futures.push_back(std::async(std::launch::async, range, tasks * piece / threads,
+                                             tasks * (piece + 1) / threads));
+            for (std::future<void>& future : futures)
+                future.get();
+        }), tasks, "task", scalingSerialMs);
+    }
+
+    // Dependent phases: cell i of a phase mixes cells i and i + 1 of the last
+    std::vector<std::vector<float>> cells(phases + 1, std::vector<float>(kPhaseWidth));
+    for (size_t i = 0; i < kPhaseWidth; ++i)
+        cells[0][i] = (float)i;
+    auto cell = [&](size_t phase, size_t i) {
+        const std::vector<float>& last = cells[phase];
+        cells[phase + 1][i] = 0.5f * (last[i] + last[(i + 1) % kPhaseWidth]) + burn((uint32_t)(phase * kPhaseWidth + i), 25);
+    };
+    const size_t phaseTasks = phases * kPhaseWidth;
+    std::cout << "dependent phases, " << phases << " of " << kPhaseWidth << " tasks" << std::endl;
+    const double phaseSerialMs = bestOf(3, [&] {
+        for (size_t phase = 0; phase < phases; ++phase)
+            for (size_t i = 0; i < kPhaseWidth; ++i)
+                cell(phase, i);
+    });
+    const std::vector<float> expectedLast = cells[phases];
+    report("  serial", phaseSerialMs, phaseTasks, "task", phaseSerialMs);
+
+    report("  counters, submitted up front", bestOf(3, [&] {
+        std::unique_ptr<Common::JobCounter[]> counters(new Common::JobCounter[phases]);
+        for (size_t phase = 0; phase < phases; ++phase) {
+            for (size_t i = 0; i < kPhaseWidth; ++i)
+                Common::submitJob([&cell, phase, i] { cell(phase, i); }, &counters[phase],
+                                  phase ? &counters[phase - 1] : nullptr);
+        }
+        Common::waitForCounter(counters[phases - 1]);
+    }), phaseTasks, "task", phaseSerialMs);
+    if (cells[phases] != expectedLast)
+        std::cout << "ERROR::JOB_BENCH::MISMATCH: chained phases differ from the serial loop" << std::endl;
+
+    report("  std::async, get() between phases", bestOf(1, [&] {
+        std::vector<std::future<void>> futures;
+        for (size_t phase = 0; phase < phases; ++phase) {
+            futures.clear();
+            for (size_t i = 0; i < kPhaseWidth; ++i)
+                futures.push_back(std::async(std::launch::async, cell, phase, i));
+            for (std::future<void>& future : futures)
+                future.get();
+        }
+    }), phaseTasks, "task", phaseSerialMs);
+    return 0;
+}
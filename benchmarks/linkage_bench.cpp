@@ -0,0 +1,113 @@
+// Benchmark: linkage solver throughput and convergence.
+//
+// A ring of chains built with buildChainSculpture (4 rods per chain by
+// default, about 50k distance, hinge and angle constraints in all) is
+// driven by swaying its pins at 60 Hz. For 1 thread up to every worker this
+// reports solver iterations per second, then the stretch left after one
+// jerked step at 1 to 32 iterations. Colors are solved in a fixed order, so
+// every thread count should converge identically; the largest position
+// difference from the 1-thread run checks it.
+//
+// Usage: linkage_bench [constraints] [links per chain] [steps]
+
+#include "bench_common.hpp"
+#include "job_system.hpp"
+#include "kinetic_sculpture.hpp"
+#include "linkage_solver.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+const float kDt = 1.0f / 60.0f;
+const float kLinkLength = 0.12f;
+const float kJointStiffness = 0.3f;
+const float kSway = 0.1f;
+const unsigned int kIterations = 8;
+
+void drive(Common::LinkageSolver& solver, const std::vector<Common::SculptureInstance>& anchors, unsigned int links,
+           float time, float sway) {
+    for (size_t i = 0; i < anchors.size(); ++i) {
+        const glm::vec3 along = glm::cross(glm::vec3(0.0f, 1.0f, 0.0f), anchors[i].axis);
+        solver.setPosition(i * (links + 1),
+                           anchors[i].offset + along * (sway * std::sin(anchors[i].frequency * time + anchors[i].phase)));
+    }
+}
+
+float maxDifference(const Common::LinkageSolver& a, const Common::LinkageSolver& b) {
+    float difference = 0.0f;
+    for (size_t i = 0; i < a.particleCount(); ++i)
+        difference = std::max(difference, glm::length(a.position(i) - b.position(i)));
+    return difference;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Common::attachMainThread();
+    const size_t target = argc > 1 ? (size_t)std::max(1, std::atoi(argv[1])) : 50000;
+    const unsigned int links = argc > 2 ? (unsigned int)std::max(1, std::atoi(argv[2])) : 4;
+    const int steps = argc > 3 ? std::max(1, std::atoi(argv[3])) : 60;
+
+    // Each chain adds links distance and hinge constraints and links - 1 angles
+    const size_t perChain = 3 * links - 1;
+    std::vector<Common::SculptureInstance> anchors;
+    Common::layoutSculpture((target + perChain - 1) / perChain, Common::SculptureLayout(), anchors);
+
+    Common::LinkageSolver base;
+    Common::buildChainSculpture(base, anchors, links, kLinkLength, kJointStiffness);
+    base.setDamping(0.2f);
+
+    // One second of motion first, so the runs below start from a swinging sculpture
+    float time = 0.0f;
+    for (int step = 0; step < 60; ++step, time += kDt) {
+        drive(base, anchors, links, time, kSway);
+        base.step(kDt, kIterations);
+    }
+    std::cout << anchors.size() << " chains of " << links << " rods: " << base.particleCount() << " particles, "
+              << base.constraintCount() << " constraints in " << base.colorCount() << " colors, "
+              << Common::workerCount() << " workers" << std::endl;
+
+    const std::vector<unsigned int> threadCounts = benchThreadCounts();
+
+    for (unsigned int threads : threadCounts) {
+        Common::LinkageSolver solver = base;
+        float t = time;
+        auto start = std::chrono::steady_clock::now();
+        for (int step = 0; step < steps; ++step, t += kDt) {
+            drive(solver, anchors, links, t, kSway);
+            solver.step(kDt, kIterations, threads);
+        }
+        double ms = msSince(start);
+        std::cout << threads << " thread" << (threads > 1 ? "s" : "") << ": "
+                  << steps * kIterations * 1000.0 / ms << " iterations/s, "
+                  << ms * 1.0e6 / ((double)steps * kIterations * solver.constraintCount())
+                  << " ns per constraint, " << ms / steps << " ms per " << kIterations << "-iteration step"
+                  << std::endl;
+    }
+
+    // Convergence: every pin jumps to the far end of its sway in one step
+    std::cout << "stretch after one jerked step:" << std::endl;
+    for (unsigned int iterations = 1; iterations <= 32; iterations *= 2) {
+        Common::LinkageSolver reference = base;
+        for (unsigned int threads : threadCounts) {
+            Common::LinkageSolver solver = base;
+            drive(solver, anchors, links, time, -kSway);
+            solver.step(kDt, iterations, threads);
+            if (threads == 1)
+                reference = solver;
+            const std::string label = "  " + std::to_string(iterations) + " iteration" + (iterations > 1 ? "s" : "");
+            std::cout << threadLabel(label, threads) << ": " << solver.maxStretch() * 100.0f
+                      << "% (max difference from 1 thread " << maxDifference(solver, reference) << ")" << std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,210 @@
+// Benchmark: software occlusion culling.
+//
+// A wall of 32 occluder spheres (a 4 x 8 grid, 32 segments around each, a
+// little over 30k triangles) in front of the camera, and 200k small boxes
+// scattered behind and between them. The occluders are rasterized into a
+// 320x192 depth buffer by a plain loop over every triangle's pixels, as the
+// baseline and to check the tiled SIMD fill to the last bit, then by
+// OcclusionBuffer on 1 thread up to every worker. Then the boxes are tested
+// against the Hi-Z pyramid; every box it hides must also be hidden by the
+// full-resolution depth buffer.
+//
+// Usage: occlusion_bench [boxes] [repeats]
+
+#include "bench_common.hpp"
+#include "job_system.hpp"
+#include "occlusion.hpp"
+#include "parallel.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+const unsigned int kWidth = 320;
+const unsigned int kHeight = 192;
+
+// The same setup and per-pixel arithmetic as OcclusionBuffer, one pixel at a
+// time over each triangle's bounds
+void scalarRasterize(const std::vector<glm::mat4>& transforms, const std::vector<glm::vec3>& vertices,
+                     const std::vector<uint32_t>& indices, std::vector<float>& depth) {
+    depth.assign((size_t)kWidth * kHeight, 1.0f);
+    const float w = (float)kWidth, h = (float)kHeight;
+    for (const glm::mat4& transform : transforms) {
+        for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+            glm::vec3 v[3];
+            bool clipped = false;
+            for (int k = 0; k < 3 && !clipped; ++k) {
+                const glm::vec4 clip = transform * glm::vec4(vertices[indices[t + k]], 1.0f);
+                clipped = clip.w <= 0.0f || clip.z < -clip.w;
+                v[k] = glm::vec3((clip.x / clip.w * 0.5f + 0.5f) * w, (clip.y / clip.w * 0.5f + 0.5f) * h,
+                                 clip.z / clip.w);
+            }
+            const float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+            if (clipped || !(area > 0.0f))
+                continue;
+            float a[3], b[3], c[3];
+            for (int k = 0; k < 3; ++k) {
+                const glm::vec3& from = v[k];
+                const glm::vec3& to = v[(k + 1) % 3];
+                a[k] = from.y - to.y;
+                b[k] = to.x - from.x;
+                c[k] = -(a[k] * from.x + b[k] * from.y);
+            }
+            const float depthA = (a[1] * v[0].z + a[2] * v[1].z + a[0] * v[2].z) / area;
+            const float depthB = (b[1] * v[0].z + b[2] * v[1].z + b[0] * v[2].z) / area;
+            const float depthC = (c[1] * v[0].z + c[2] * v[1].z + c[0] * v[2].z) / area;
+            const float minX = std::min(v[0].x, std::min(v[1].x, v[2].x));
+            const float maxX = std::max(v[0].x, std::max(v[1].x, v[2].x));
+            const float minY = std::min(v[0].y, std::min(v[1].y, v[2].y));
+            const float maxY = std::max(v[0].y, std::max(v[1].y, v[2].y));
+            const int x0 = std::max(0, (int)std::ceil(minX - 0.5f));
+            const int x1 = std::min((int)kWidth - 1, (int)std::floor(maxX - 0.5f));
+            const int y0 = std::max(0, (int)std::ceil(minY - 0.5f));
+            const int y1 = std::min((int)kHeight - 1, (int)std::floor(maxY - 0.5f));
+            for (int y = y0; y <= y1; ++y) {
+                const float centerY = y + 0.5f;
+                for (int x = x0; x <= x1; ++x) {
+                    const float centerX = x + 0.5f;
+                    if (a[0] * centerX + (b[0] * centerY + c[0]) < 0.0f ||
+                        a[1] * centerX + (b[1] * centerY + c[1]) < 0.0f ||
+                        a[2] * centerX + (b[2] * centerY + c[2]) < 0.0f)
+                        continue;
+                    float& stored = depth[(size_t)y * kWidth + x];
+                    stored = std::min(depthA * centerX + (depthB * centerY + depthC), stored);
+                }
+            }
+        }
+    }
+}
+
+// Hidden by the full-resolution buffer: every pixel the box touches is nearer
+bool hiddenAtFullResolution(const std::vector<float>& depth, const glm::mat4& viewProjection,
+                            const Common::Aabb& box) {
+    float minX = 1e30f, maxX = -1e30f, minY = 1e30f, maxY = -1e30f, nearest = 1e30f;
+    for (int corner = 0; corner < 8; ++corner) {
+        const glm::vec3 p((corner & 1) ? box.max.x : box.min.x, (corner & 2) ? box.max.y : box.min.y,
+                          (corner & 4) ? box.max.z : box.min.z);
+        const glm::vec4 clip = viewProjection * glm::vec4(p, 1.0f);
+        if (clip.w <= 0.0f || clip.z < -clip.w)
+            return false;
+        minX = std::min(minX, clip.x / clip.w);
+        maxX = std::max(maxX, clip.x / clip.w);
+        minY = std::min(minY, clip.y / clip.w);
+        maxY = std::max(maxY, clip.y / clip.w);
+        nearest = std::min(nearest, clip.z / clip.w);
+    }
+    if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+        return false;
+    const int x0 = std::max(0, (int)std::floor((minX * 0.5f + 0.5f) * kWidth));
+    const int x1 = std::min((int)kWidth - 1, (int)std::floor((maxX * 0.5f + 0.5f) * kWidth));
+    const int y0 = std::max(0, (int)std::floor((minY * 0.5f + 0.5f) * kHeight));
+    const int y1 = std::min((int)kHeight - 1, (int)std::floor((maxY * 0.5f + 0.5f) * kHeight));
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            if (depth[(size_t)y * kWidth + x] >= nearest)
+                return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Common::attachMainThread();
+    const size_t count = argc > 1 ? (size_t)std::max(1, std::atoi(argv[1])) : 200000;
+    const int repeats = argc > 2 ? std::max(1, std::atoi(argv[2])) : 10;
+
+    const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    const glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    const glm::mat4 viewProjection = projection * view;
+
+    std::vector<glm::vec3> sphereVertices;
+    std::vector<uint32_t> sphereIndices;
+    Common::buildOccluderSphere(32, sphereVertices, sphereIndices);
+    std::vector<glm::mat4> occluders;
+    for (int row = 0; row < 4; ++row) {
+        for (int column = 0; column < 8; ++column) {
+            const glm::vec3 center(-7.0f + 2.0f * column, -3.0f + 2.0f * row, -12.0f);
+            occluders.push_back(viewProjection * glm::scale(glm::translate(glm::mat4(1.0f), center),
+                                                            glm::vec3(1.1f)));
+        }
+    }
+
+    std::mt19937 rng(17);
+    std::uniform_real_distribution<float> across(-20.0f, 20.0f), up(-10.0f, 10.0f), deep(-40.0f, -11.0f),
+        size(0.05f, 0.4f);
+    std::vector<Common::Aabb> boxes(count);
+    for (Common::Aabb& box : boxes) {
+        const glm::vec3 center(across(rng), up(rng), deep(rng));
+        const glm::vec3 extent(size(rng), size(rng), size(rng));
+        box = { center - extent, center + extent };
+    }
+    std::cout << occluders.size() * sphereIndices.size() / 3 << " occluder triangles, " << count << " boxes, "
+              << kWidth << "x" << kHeight << " depth, " << Common::workerCount() << " workers" << std::endl;
+
+    std::vector<float> expected;
+    const double scalarMs = bestOf(repeats, [&] {
+        scalarRasterize(occluders, sphereVertices, sphereIndices, expected);
+    });
+    std::cout << "scalar rasterizer, one pixel at a time: " << scalarMs << " ms" << std::endl;
+
+    Common::OcclusionBuffer buffer;
+    buffer.resize(kWidth, kHeight);
+    const std::vector<unsigned int> threadCounts = benchThreadCounts();
+    for (unsigned int threads : threadCounts) {
+        double setupMs = 1e30;
+        const double ms = bestOf(repeats, [&] {
+            auto start = std::chrono::steady_clock::now();
+            buffer.clear();
+            for (const glm::mat4& transform : occluders)
+                buffer.addOccluder(transform, sphereVertices.data(), sphereVertices.size(), sphereIndices.data(),
+                                   sphereIndices.size());
+            setupMs = std::min(setupMs, msSince(start));
+            buffer.rasterize(threads);
+        });
+        std::cout << threadLabel("OcclusionBuffer", threads) << ": " << ms
+                  << " ms (" << setupMs << " ms setup and binning, " << buffer.triangleCount()
+                  << " front-facing triangles)" << std::endl;
+        if (buffer.level(0) != expected)
+            std::cout << "ERROR::OCCLUSION_BENCH::MISMATCH: tiled depth differs from the scalar loop" << std::endl;
+    }
+
+    std::vector<uint32_t> all(count), visible;
+    for (size_t i = 0; i < count; ++i)
+        all[i] = (uint32_t)i;
+    for (unsigned int threads : threadCounts) {
+        const double ms = bestOf(repeats, [&] {
+            visible = all;
+            buffer.cull(viewProjection, boxes.data(), visible, threads);
+        });
+        std::cout << threadLabel("Hi-Z test", threads) << ": " << ms << " ms, "
+                  << ms * 1.0e6 / count << " ns per box, " << 100.0 * (count - visible.size()) / count
+                  << "% occluded" << std::endl;
+    }
+
+    // Whatever the pyramid hides, full resolution must hide too
+    std::vector<bool> kept(count, false);
+    for (uint32_t i : visible)
+        kept[i] = true;
+    size_t wrong = 0, fullHidden = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const bool hidden = hiddenAtFullResolution(expected, viewProjection, boxes[i]);
+        fullHidden += hidden;
+        wrong += !kept[i] && !hidden;
+    }
+    std::cout << "full resolution would hide " << 100.0 * fullHidden / count << "%" << std::endl;
+    if (wrong)
+        std::cout << "ERROR::OCCLUSION_BENCH::MISMATCH: " << wrong
+                  << " boxes hidden by the pyramid but not the depth buffer" << std::endl;
+    return 0;
+}
@@ -0,0 +1,118 @@
+// Benchmark: CPU pendulum solver cost per element per step.
+//
+// 1M damped, driven pendulums (random stiffness, drive phase and start angle)
+// are stepped at 60 Hz with each integrator, on 1 thread up to every worker,
+// writing the angles out as they would go into the mapped instance buffer.
+// A plain scalar loop with std::sin is the baseline, and its final angles
+// check the SIMD kernels.
+//
+// Usage: oscillator_bench [steps] [oscillators]
+
+#include "bench_common.hpp"
+#include "job_system.hpp"
+#include "oscillator_solver.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+const float kDt = 1.0f / 60.0f;
+const float kDamping = 0.02f;
+const float kDriveFrequency = 2.5f;
+
+struct Oscillator {
+    float stiffness, driveAmplitude, drivePhase, angle;
+};
+
+void setup(Common::OscillatorSolver& solver, const std::vector<Oscillator>& oscillators,
+           Common::Integrator integrator) {
+    solver.resize(oscillators.size());
+    solver.setIntegrator(integrator);
+    solver.setDamping(kDamping);
+    solver.setDriveFrequency(kDriveFrequency);
+    for (size_t i = 0; i < oscillators.size(); ++i) {
+        const Oscillator& o = oscillators[i];
+        solver.set(i, o.stiffness, o.driveAmplitude, o.drivePhase, o.angle);
+    }
+}
+
+// Semi-implicit Euler, one oscillator at a time
+double scalarRun(const std::vector<Oscillator>& oscillators, int steps, std::vector<float>& out) {
+    const size_t count = oscillators.size();
+    std::vector<float> angle(count), velocity(count, 0.0f);
+    for (size_t i = 0; i < count; ++i)
+        angle[i] = oscillators[i].angle;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int step = 0; step < steps; ++step) {
+        const float t = step * kDt;
+        for (size_t i = 0; i < count; ++i) {
+            const Oscillator& o = oscillators[i];
+            float accel = -o.stiffness * std::sin(angle[i]) - kDamping * velocity[i] +
+                          o.driveAmplitude * std::sin(kDriveFrequency * t + o.drivePhase);
+            velocity[i] += accel * kDt;
+            angle[i] += velocity[i] * kDt;
+            out[i] = angle[i];
+        }
+    }
+    return msSince(start);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Common::attachMainThread();
+    const int steps = argc > 1 ? std::max(1, std::atoi(argv[1])) : 100;
+    const size_t count = argc > 2 ? (size_t)std::max(1, std::atoi(argv[2])) : 1000000;
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<Oscillator> oscillators(count);
+    for (Oscillator& o : oscillators)
+        o = { 4.0f + 8.0f * unit(rng), 0.05f * unit(rng), 6.2831853f * unit(rng), unit(rng) - 0.5f };
+
+    std::cout << count << " oscillators, " << steps << " steps of " << kDt * 1000.0f << " ms, "
+              << Common::workerCount() << " workers" << std::endl;
+
+    std::vector<float> reference(count), out(count);
+    double scalarMs = scalarRun(oscillators, steps, reference);
+    std::cout << "scalar euler, 1 thread: " << scalarMs * 1.0e6 / ((double)steps * count)
+              << " ns per element per step" << std::endl;
+
+    const std::vector<unsigned int> threadCounts = benchThreadCounts();
+
+    struct { Common::Integrator integrator; const char* label; } integrators[] = {
+        { Common::Integrator::SemiImplicitEuler, "euler" },
+        { Common::Integrator::Verlet, "verlet" },
+    };
+    Common::OscillatorSolver solver;
+    for (const auto& integrator : integrators) {
+        for (unsigned int threads : threadCounts) {
+            setup(solver, oscillators, integrator.integrator);
+            auto start = std::chrono::steady_clock::now();
+            for (int step = 0; step < steps; ++step)
+                solver.step(kDt, out.data(), threads);
+            double ms = msSince(start);
+
+            std::cout << threadLabel(std::string("simd ") + integrator.label, threads) << ": "
+                      << ms * 1.0e6 / ((double)steps * count) << " ns per element per step, " << ms / steps
+                      << " ms per step";
+            if (integrator.integrator == Common::Integrator::SemiImplicitEuler) {
+                float error = 0.0f;
+                for (size_t i = 0; i < count; ++i)
+                    error = std::max(error, std::fabs(out[i] - reference[i]));
+                std::cout << " (max difference from scalar " << error << " rad)";
+            }
+            std::cout << std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,177 @@
+// Benchmark: kinetic sculpture frame cost against element count.
+//
+// Each run draws the sculpture as one glDrawElementsInstanced call into a
+// 1280x720 offscreen target, with animationTime advancing 1/60 s per frame,
+// for 1k to 1M elements of each shape. GPU time comes from a timer query
+// around the draw; frame time is the wall clock for clear + draw + glFinish,
+// so it includes the driver. 16.7 ms is the 60 fps line.
+//
+// Usage: sculpture_bench [frames] [max elements]
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "bench_common.hpp"
+#include "gl_state.hpp"
+#include "kinetic_sculpture.hpp"
+#include "shader_permutations.hpp"
+#include "uniform_blocks.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+const int kWidth = 1280;
+const int kHeight = 720;
+
+struct Result {
+    double gpuMs = 0.0;
+    double frameMs = 0.0;
+};
+
+Result run(Common::ElementShape shape, size_t elements, int frames, unsigned int program,
+           Common::UniformBuffer<Common::FrameBlock>& frameUniforms, Common::FrameBlock& frame,
+           unsigned int timerQuery) {
+    Common::KineticSculpture sculpture;
+    sculpture.create(shape, elements);
+    Common::GLStateCache& gl = Common::glState();
+
+    const int warmUp = 2;
+    Result result;
+    for (int i = 0; i < warmUp + frames; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        frame.animationTime = i / 60.0f;
+        frameUniforms.upload(frame);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        glBeginQuery(GL_TIME_ELAPSED, timerQuery);
+        gl.useProgram(program);
+        gl.bindVertexArray(sculpture.vertexArray());
+        glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)sculpture.indexCount(), GL_UNSIGNED_INT, nullptr,
+                                (GLsizei)sculpture.instanceCount());
+        glEndQuery(GL_TIME_ELAPSED);
+        glFinish();
+        double frameMs = msSince(start);
+
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(timerQuery, GL_QUERY_RESULT, &elapsed);
+        if (i >= warmUp) {
+            result.gpuMs += elapsed / 1.0e6 / frames;
+            result.frameMs += frameMs / frames;
+        }
+    }
+    sculpture.destroy();
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const int frames = argc > 1 ? std::max(1, std::atoi(argv[1])) : 20;
+    const size_t maxElements = argc > 2 ? (size_t)std::max(1, std::atoi(argv[2])) : 1000000;
+
+    if (!glfwInit()) {
+        std::cout << "Failed to initialize GLFW" << std::endl;
+        return 1;
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    GLFWwindow* window = glfwCreateWindow(256, 256, "sculpture_bench", nullptr, nullptr);
+    if (window == nullptr) {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return 1;
+    }
+
+    Common::ShaderPermutations shaders(EARTH_SHADER_DIR "/vs/sculpture_element.vs",
+                                       EARTH_SHADER_DIR "/fs/sculpture_element.fs", {});
+    if (!shaders.load() || !shaders.warmUp({ 0 }))
+        return 1;
+    unsigned int program = shaders.variant(0).program;
+    if (!program)
+        return 1;
+
+    // Fixed-size target, so the numbers don't depend on the (hidden) window
+    unsigned int framebuffer, color, depth;
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(1, &color);
+    glGenRenderbuffers(1, &depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, kWidth, kHeight);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, kWidth, kHeight);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+    glViewport(0, 0, kWidth, kHeight);
+    Common::glState().enable(GL_DEPTH_TEST);
+
+    // Looking down on the ring from outside it
+    Common::FrameBlock frame;
+    frame.viewPos = glm::vec3(0.0f, 2.5f, 5.0f);
+    frame.view = glm::lookAt(frame.viewPos, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    frame.projection = glm::perspective(glm::radians(45.0f), (float)kWidth / kHeight, 0.1f, 100.0f);
+    frame.viewProjection = frame.projection * frame.view;
+    frame.lightPos = glm::vec3(5.0f, 3.0f, 5.0f);
+    frame.lightColor = glm::vec3(1.0f);
+    Common::UniformBuffer<Common::FrameBlock> frameUniforms;
+    Common::UniformBuffer<Common::ObjectBlock> objectUniforms;
+    frameUniforms.create(Common::FRAME_BLOCK_BINDING);
+    objectUniforms.create(Common::OBJECT_BLOCK_BINDING);
+    Common::ObjectBlock object;
+    object.model = object.normalMatrix = glm::mat4(1.0f);
+    object.modelViewProjection = frame.viewProjection;
+    object.objectViewPos = frame.viewPos;
+    objectUniforms.upload(object);
+
+    unsigned int timerQuery;
+    glGenQueries(1, &timerQuery);
+
+    std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
+    std::cout << kWidth << "x" << kHeight << ", " << frames << " frames per run" << std::endl;
+
+    struct { Common::ElementShape shape; const char* label; } shapes[] = {
+        { Common::ElementShape::Vane, "vane" },
+        { Common::ElementShape::Rod, "rod" },
+        { Common::ElementShape::Sphere, "sphere" },
+    };
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    for (const auto& shape : shapes) {
+        Common::buildElementMesh(shape.shape, 8, 1.0f, vertices, indices);
+        for (size_t elements = 1000; elements <= maxElements; elements *= 10) {
+            Result result = run(shape.shape, elements, frames, program, frameUniforms, frame, timerQuery);
+            std::cout << elements << " " << shape.label << "s (" << elements * indices.size() / 3 / 1000
+                      << "k triangles): " << result.gpuMs << " ms GPU, " << result.frameMs << " ms frame ("
+                      << 1000.0 / result.frameMs << " fps)" << std::endl;
+        }
+    }
+
+    glDeleteQueries(1, &timerQuery);
+    frameUniforms.destroy();
+    objectUniforms.destroy();
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &color);
+    glDeleteRenderbuffers(1, &depth);
+    shaders.clear();
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+}
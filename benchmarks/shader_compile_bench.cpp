@@ -0,0 +1,151 @@
+// Benchmark: wall time to build every Earth shader variant.
+//
+//   serial      compile, link and check each program in turn, as main() used to
+//   batched xN  submit every program first, then poll GL_COMPLETION_STATUS_KHR
+//               with the driver limited to N compile threads
+//
+// Each run appends a unique comment to the sources so the driver's own shader
+// cache cannot serve a later run from an earlier one.
+//
+// Usage: shader_compile_bench [rounds]
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "bench_common.hpp"
+#include "program_cache.hpp"
+#include "shader_permutations.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const std::vector<std::string> kFeatureNames = { "NIGHT_LIGHTS", "CLOUDS", "RELIEF" };
+
+std::vector<Common::ProgramSource> variantSources(const Common::ProgramSource& expanded, int run) {
+    std::vector<Common::ProgramSource> sources;
+    const std::string salt = "\n// run " + std::to_string(run) + "\n";
+    for (uint32_t features = 0; features < (1u << kFeatureNames.size()); ++features) {
+        sources.push_back({ Common::injectDefines(expanded.vertex, features, kFeatureNames) + salt,
+                            Common::injectDefines(expanded.fragment, features, kFeatureNames) + salt });
+    }
+    return sources;
+}
+
+struct Timing {
+    double blockedMs = 0.0;    // main thread inside GL calls
+    double totalMs = 0.0;      // until every program is linked
+};
+
+Timing buildSerial(const std::vector<Common::ProgramSource>& sources) {
+    auto start = std::chrono::steady_clock::now();
+    for (const Common::ProgramSource& source : sources)
+        glDeleteProgram(Common::compileProgram(source.vertex, source.fragment));
+    Timing timing;
+    timing.totalMs = timing.blockedMs = msSince(start);
+    return timing;
+}
+
+Timing buildBatched(const std::vector<Common::ProgramSource>& sources) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Common::PendingProgram> pending;
+    for (const Common::ProgramSource& source : sources)
+        pending.push_back(Common::beginProgram(source));
+    Timing timing;
+    timing.blockedMs = msSince(start);
+
+    // Poll like a frame loop would, finishing programs as they complete
+    size_t remaining = pending.size();
+    while (remaining > 0) {
+        auto pollStart = std::chrono::steady_clock::now();
+        for (Common::PendingProgram& program : pending) {
+            if (program.program && Common::programReady(program)) {
+                glDeleteProgram(Common::finishProgram(program));
+                --remaining;
+            }
+        }
+        timing.blockedMs += msSince(pollStart);
+        if (remaining > 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    timing.totalMs = msSince(start);
+    return timing;
+}
+
+void report(const char* label, const std::vector<Timing>& runs) {
+    Timing best = runs[0];
+    for (const Timing& run : runs) {
+        best.totalMs = std::min(best.totalMs, run.totalMs);
+        best.blockedMs = std::min(best.blockedMs, run.blockedMs);
+    }
+    std::cout << label << ": " << best.totalMs << " ms wall, " << best.blockedMs
+              << " ms blocking the calling thread" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const int rounds = argc > 1 ? std::max(1, std::atoi(argv[1])) : 3;
+
+    if (!glfwInit()) {
+        std::cout << "Failed to initialize GLFW" << std::endl;
+        return 1;
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    GLFWwindow* window = glfwCreateWindow(64, 64, "shader_compile_bench", nullptr, nullptr);
+    if (window == nullptr) {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return 1;
+    }
+
+    Common::ProgramSource expanded;
+    if (!Common::loadShaderSource(EARTH_SHADER_DIR "/vs/kinetic_sculpture.vs", expanded.vertex) ||
+        !Common::loadShaderSource(EARTH_SHADER_DIR "/fs/kinetic_sculpture.fs", expanded.fragment))
+        return 1;
+
+    const unsigned int hardwareThreads = std::max(2u, std::thread::hardware_concurrency());
+    std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
+    std::cout << (1u << kFeatureNames.size()) << " variants, best of " << rounds << " rounds" << std::endl;
+
+    int run = 0;
+    std::vector<Timing> serial;
+    for (int r = 0; r < rounds; ++r)
+        serial.push_back(buildSerial(variantSources(expanded, run++)));
+    report("serial", serial);
+
+    if (!Common::parallelCompileSupported()) {
+        std::cout << "KHR_parallel_shader_compile not supported; batched runs skipped" << std::endl;
+    } else {
+        for (unsigned int threads : { 1u, hardwareThreads }) {
+            Common::setShaderCompilerThreads(threads);
+            std::vector<Timing> batched;
+            for (int r = 0; r < rounds; ++r)
+                batched.push_back(buildBatched(variantSources(expanded, run++)));
+            std::string label = "batched x" + std::to_string(threads);
+            report(label.c_str(), batched);
+        }
+    }
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+}
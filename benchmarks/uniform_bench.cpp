@@ -0,0 +1,184 @@
+// Micro-benchmark: cost of setting a uniform by name (glGetUniformLocation on a
+// std::string every call, as Common::Shader used to) versus by compile-time
+// hashed id through Common::UniformTable.
+//
+// Usage: uniform_bench [rounds]
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "uniforms.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace {
+
+// Same uniform set as the Earth pass
+const char* kVertexSource = R"(#version 330 core
+layout (location = 0) in vec3 aPos;
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+void main() { gl_Position = projection * view * model * vec4(aPos, 1.0); }
+)";
+
+const char* kFragmentSource = R"(#version 330 core
+out vec4 FragColor;
+uniform samplerCube diffuseTex;
+uniform samplerCube cloudsTex;
+uniform samplerCube nightTex;
+uniform samplerCube reliefTex;
+uniform samplerCube coastTex;
+uniform float reliefDepth;
+uniform vec3 lightPos;
+uniform vec3 lightColor;
+uniform vec3 viewPos;
+uniform vec3 ambientSH[9];
+void main() {
+    vec3 dir = normalize(lightPos - viewPos);
+    vec3 c = texture(diffuseTex, dir).rgb + texture(cloudsTex, dir).rgb + texture(nightTex, dir).rgb;
+    c += texture(reliefTex, dir).rgb * reliefDepth + texture(coastTex, dir).r;
+    FragColor = vec4(c * lightColor + ambientSH[0] + ambientSH[8], 1.0);
+}
+)";
+
+const char* kNames[] = {
+    "model", "view", "projection", "diffuseTex", "cloudsTex", "nightTex", "reliefTex",
+    "coastTex", "reliefDepth", "lightPos", "lightColor", "viewPos", "ambientSH",
+};
+const int kNameCount = sizeof(kNames) / sizeof(kNames[0]);
+
+constexpr Common::UniformId kIds[] = {
+    Common::UniformId("model"), Common::UniformId("view"), Common::UniformId("projection"),
+    Common::UniformId("diffuseTex"), Common::UniformId("cloudsTex"), Common::UniformId("nightTex"),
+    Common::UniformId("reliefTex"), Common::UniformId("coastTex"), Common::UniformId("reliefDepth"),
+    Common::UniformId("lightPos"), Common::UniformId("lightColor"), Common::UniformId("viewPos"),
+    Common::UniformId("ambientSH"),
+};
+static_assert(sizeof(kIds) / sizeof(kIds[0]) == sizeof(kNames) / sizeof(kNames[0]), "one id per name");
+
+// Hashing happens at compile time
+static_assert(Common::fnv1a("view") == 0xdba4f4f8u, "FNV-1a of \"view\"");
+
+unsigned int compileProgram() {
+    unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertex, 1, &kVertexSource, nullptr);
+    glCompileShader(vertex);
+    unsigned int fragment = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragment, 1, &kFragmentSource, nullptr);
+    glCompileShader(fragment);
+
+    unsigned int program = glCreateProgram();
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragment);
+    glLinkProgram(program);
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char infoLog[1024];
+        glGetProgramInfoLog(program, 1024, nullptr, infoLog);
+        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+        return 0;
+    }
+    return program;
+}
+
+// Upload a value of the right type for uniform i
+void setUniform(int i, int location) {
+    static const float values[9 * 3] = { 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f,
+                                         0.0f, 0.0f, 0.0f, 1.0f };
+    if (i < 3)
+        glUniformMatrix4fv(location, 1, GL_FALSE, values);
+    else if (i < 8)
+        glUniform1i(location, i - 3);
+    else if (i == 8)
+        glUniform1f(location, 0.004f);
+    else
+        glUniform3fv(location, i == 12 ? 9 : 1, values);
+}
+
+template <typename F>
+double nsPerCall(int rounds, F body) {
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r)
+        for (int i = 0; i < kNameCount; ++i)
+            body(i);
+    glFinish();
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return ns / ((double)rounds * kNameCount);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const int rounds = argc > 1 ? std::atoi(argv[1]) : 100000;
+
+    if (!glfwInit()) {
+        std::cout << "Failed to initialize GLFW" << std::endl;
+        return 1;
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    GLFWwindow* window = glfwCreateWindow(64, 64, "uniform_bench", nullptr, nullptr);
+    if (window == nullptr) {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return 1;
+    }
+
+    unsigned int program = compileProgram();
+    if (program == 0)
+        return 1;
+    glUseProgram(program);
+
+    auto reflectStart = std::chrono::steady_clock::now();
+    Common::UniformTable table;
+    table.reflect(program);
+    double reflectUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - reflectStart).count();
+
+    // Both variants issue identical, correctly typed glUniform* calls
+    volatile int sink = 0;
+    double lookupByName = nsPerCall(rounds, [&](int i) {
+        sink += glGetUniformLocation(program, std::string(kNames[i]).c_str());
+    });
+    double lookupById = nsPerCall(rounds, [&](int i) {
+        sink += table.location(kIds[i]);
+    });
+    double setByName = nsPerCall(rounds, [&](int i) {
+        setUniform(i, glGetUniformLocation(program, std::string(kNames[i]).c_str()));
+    });
+    double setById = nsPerCall(rounds, [&](int i) {
+        setUniform(i, table.location(kIds[i]));
+    });
+
+    if (glGetError() != GL_NO_ERROR)
+        std::cout << "ERROR::UNIFORM_BENCH::GL_ERROR" << std::endl;
+    std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
+    std::cout << "Reflected " << table.size() << " uniforms in " << reflectUs << " us" << std::endl;
+    std::cout << "Lookup only:   by name " << lookupByName << " ns, by id " << lookupById << " ns ("
+              << lookupByName / lookupById << "x)" << std::endl;
+    std::cout << "Lookup + set:  by name " << setByName << " ns, by id " << setById << " ns ("
+              << setByName / setById << "x)" << std::endl;
+
+    glDeleteProgram(program);
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+}
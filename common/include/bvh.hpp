@@ -0,0 +1,88 @@
+#pragma once
+
+#include "culling.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <vector>
+
+namespace Common {
+    struct Aabb {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    // Bounding volume hierarchy over boxes that move. build() splits them top
+    // down by the surface area heuristic (binned) into a 4-wide tree: each
+    // node holds its four children's boxes as structure of arrays, so a query
+    // tests all four at once (simd.hpp), and a node is two cache lines. Nodes
+    // are stored depth first, every child after its parent, and the primitives
+    // under a node are contiguous.
+    //
+    // When the boxes move, refit() recomputes the node boxes bottom up and
+    // keeps the tree, which is cheap but loosens it. degradation() tracks how
+    // far; past a threshold beginRebuild() builds a fresh tree on another
+    // thread while this one goes on being refit and queried, and
+    // finishRebuild() swaps it in once it is done.
+    class Bvh {
+    public:
+        static constexpr unsigned int WIDTH = 4;
+        static constexpr unsigned int MAX_LEAF_SIZE = 4;
+
+        // A child slot is an inner node (child >= 0), a leaf of count
+        // primitives from primitives[~child], or empty (child < 0, count 0)
+        struct alignas(64) Node {
+            float minX[WIDTH], minY[WIDTH], minZ[WIDTH];
+            float maxX[WIDTH], maxY[WIDTH], maxZ[WIDTH];
+            int32_t child[WIDTH];
+            uint32_t count[WIDTH];
+        };
+
+        // bounds[i] is primitive i's box; threads = 0 uses every worker
+        void build(const Aabb* bounds, size_t count, unsigned int threads = 0);
+        // The same primitives (count as built) at their new bounds
+        void refit(const Aabb* bounds, unsigned int threads = 0);
+
+        // SAH cost of the tree now over its cost when built: 1 after a build,
+        // growing as refits stretch boxes over primitives that have parted
+        float degradation() const { return tree.builtCost > 0.0f ? tree.cost / tree.builtCost : 1.0f; }
+
+        // Build from a copy of bounds on another thread
+        void beginRebuild(const Aabb* bounds);
+        bool rebuilding() const { return rebuild.valid(); }
+        // If the rebuild has finished, take its tree, refit it to bounds (the
+        // primitives moved while it was built) and return true
+        bool finishRebuild(const Aabb* bounds, unsigned int threads = 0);
+
+        // Primitives whose boxes overlap box, or are not wholly outside the
+        // frustum; appended to out in no particular order
+        void overlapping(const Aabb& box, std::vector<uint32_t>& out) const;
+        void inFrustum(const Frustum& frustum, std::vector<uint32_t>& out) const;
+
+        // The nearest box a ray enters within maxDistance (direction need not
+        // be unit length; distance is in multiples of it). False if none.
+        bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+                     uint32_t& primitive, float& distance) const;
+
+        size_t size() const { return tree.primitives.size(); }
+        size_t nodeCount() const { return tree.nodes.size(); }
+
+    private:
+        struct Tree {
+            std::vector<Node> nodes;
+            std::vector<uint32_t> primitives;   // primitive indices in leaf order
+            std::vector<Aabb> leafBounds;       // their boxes, in the same order
+            float cost = 0.0f;
+            float builtCost = 0.0f;
+        };
+
+        static void buildTree(const Aabb* bounds, size_t count, Tree& tree, unsigned int threads);
+        static void refitTree(Tree& tree, const Aabb* bounds, unsigned int threads);
+
+        Tree tree;
+        std::future<Tree> rebuild;
+    };
+}
@@ -6,6 +6,10 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "program_cache.hpp"
+#include "uniform_blocks.hpp"
+#include "uniforms.hpp"
+
 #include <iostream>
 #include <string>
 #include <fstream>
@@ -35,18 +39,33 @@ namespace Common {
     public:
         unsigned int ID;
         
-        Shader(const char* vertexPath, const char* fragmentPath);
+        // With a cache the linked binary is reused across runs
+        Shader(const char* vertexPath, const char* fragmentPath, ProgramCache* cache = nullptr);
         ~Shader();
         
         void use();
+        
+        // Hot path: resolved through the uniform table. Declare ids constexpr so
+        // the name is hashed at compile time:
+        //   constexpr Common::UniformId U_VIEW("view");  shader.setMat4(U_VIEW, view);
+        void setBool(UniformId id, bool value) const;
+        void setInt(UniformId id, int value) const;
+        void setFloat(UniformId id, float value) const;
+        void setVec3(UniformId id, const glm::vec3 &value) const;
+        void setMat4(UniformId id, const glm::mat4 &mat) const;
+        
+        // Convenience overloads; hash the name at run time
         void setBool(const std::string &name, bool value) const;
         void setInt(const std::string &name, int value) const;
         void setFloat(const std::string &name, float value) const;
         void setVec3(const std::string &name, const glm::vec3 &value) const;
         void setMat4(const std::string &name, const glm::mat4 &mat) const;
         
+        // Active uniforms reflected after linking
+        const UniformTable& uniforms() const { return uniformTable; }
+        
     private:
-        void checkCompileErrors(unsigned int shader, const std::string &type);
+        UniformTable uniformTable;
     };
     
     // Utility functions
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Common {
+    // One mip level of a cooked texture; data holds every face back to back
+    struct CookedLevel {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<uint8_t> data;
+    };
+
+    // Cooked texture container (.ctex) produced by the offline earth_bake tool.
+    // Holds 1 face (2D) or 6 faces (cubemap, GL face order) of 8-bit texels with a
+    // full mip chain. Levels are stored smallest-first on disk so the mip tail sits
+    // at the front of the file.
+    struct CookedTexture {
+        uint32_t channels = 4;
+        uint32_t faces = 1;
+        std::vector<CookedLevel> levels;    // levels[0] is full resolution
+
+        size_t faceBytes(size_t level) const;
+        size_t byteSize() const;
+    };
+
+    bool writeCookedTexture(const std::string& path, const CookedTexture& texture);
+
+    // Read the header and every level from firstLevel down to the smallest. Levels
+    // finer than firstLevel get their size filled in but no data, which is all a
+    // streamer needs to upload the mip tail first.
+    bool readCookedTexture(const std::string& path, CookedTexture& texture, size_t firstLevel = 0);
+
+    // Read the data of a single level (the texture must come from readCookedTexture)
+    bool readCookedLevel(const std::string& path, size_t level, CookedLevel& out);
+}
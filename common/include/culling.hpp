@@ -0,0 +1,50 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Common {
+    // The six planes of a view-projection matrix's clip volume (left, right,
+    // bottom, top, near, far), normalized and facing inwards: p is on the
+    // inner side of a plane when dot(plane.xyz, p) + plane.w >= 0
+    struct Frustum {
+        glm::vec4 planes[6];
+    };
+
+    Frustum extractFrustum(const glm::mat4& viewProjection);
+
+    // World-space bounds of many objects, tested against a frustum 4 at a
+    // time (simd.hpp). Each object has a box (center, half extents) and a
+    // sphere about the same center. It is culled when, for some plane, the
+    // tighter of the two lies wholly outside, so a sphere set with setSphere()
+    // is not loosened to its box nor a box to its sphere. Like any plane test
+    // it is conservative: an object just outside a frustum corner is kept.
+    //
+    // Stored as structure of arrays, padded to the SIMD width. Objects never
+    // set (and the padding) are always culled.
+    class CullingSet {
+    public:
+        // Drop every object and make room for count new ones
+        void resize(size_t count);
+        size_t size() const { return count; }
+
+        void setBox(size_t i, const glm::vec3& min, const glm::vec3& max);
+        void setSphere(size_t i, const glm::vec3& center, float radius);
+
+        // Replace visible with the indices of the objects that may be seen,
+        // in ascending order, and return how many there are. Spans of objects
+        // are split across worker threads (threads = 0 uses every worker).
+        size_t cull(const Frustum& frustum, std::vector<uint32_t>& visible, unsigned int threads = 0);
+
+    private:
+        size_t count = 0;
+        std::vector<float> centerX, centerY, centerZ;
+        std::vector<float> extentX, extentY, extentZ;
+        std::vector<float> radius;
+        std::vector<uint32_t> survivors;    // each span's visible indices, at the span's start
+        std::vector<size_t> spanVisible;    // how many each span kept, then where they go
+    };
+}
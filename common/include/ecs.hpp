@@ -0,0 +1,175 @@
+#pragma once
+
+#include "parallel.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace Common {
+    // Entity handle: a slot plus the slot's generation when it was handed out,
+    // so a handle to a destroyed entity goes stale instead of aliasing a new one
+    struct Entity {
+        uint32_t index = ~0u;
+        uint32_t generation = 0;
+
+        bool operator==(const Entity& other) const { return index == other.index && generation == other.generation; }
+        bool operator!=(const Entity& other) const { return !(*this == other); }
+    };
+
+    using ComponentMask = uint64_t;
+    constexpr size_t MAX_COMPONENT_TYPES = 64;
+    constexpr size_t ECS_CACHE_LINE = 64;
+    constexpr size_t ECS_CHUNK_BYTES = 16 * 1024;
+
+    namespace detail {
+        // Ids are handed out on first use, so they differ between runs
+        uint32_t registerComponent(size_t size);
+
+        template <typename T>
+        uint32_t componentId() {
+            static_assert(std::is_trivially_copyable<T>::value, "components are moved with memcpy");
+            static_assert(alignof(T) <= ECS_CACHE_LINE, "component arrays are cache-line aligned");
+            static const uint32_t id = registerComponent(sizeof(T));
+            return id;
+        }
+
+        template <typename... Ts>
+        ComponentMask componentMask() {
+            return (ComponentMask(0) | ... | (ComponentMask(1) << componentId<Ts>()));
+        }
+    }
+
+    // Entity-component store with archetype chunks. Entities with the same set
+    // of components share an archetype, which keeps them in 16 KiB chunks of
+    // structure of arrays: one cache-line aligned array per component, plus
+    // the entity handles. Systems walk those arrays directly:
+    //
+    //   world.each<Transform, Spin>([&](size_t count, Transform* t, Spin* s) { ... });
+    //
+    // Components are plain data (trivially copyable, no constructors run).
+    // Destroying an entity moves the archetype's last entity into its row, and
+    // adding or removing a component moves the entity to another archetype, so
+    // component pointers are only good until the next structural change.
+    // Structural changes are single threaded; each and parallelEach may write
+    // components but not create, destroy, add or remove.
+    class World {
+    public:
+        World() = default;
+        World(const World&) = delete;
+        World& operator=(const World&) = delete;
+        ~World();
+
+        template <typename... Ts>
+        Entity create(const Ts&... components) {
+            const ComponentMask mask = detail::componentMask<Ts...>();
+            const Entity entity = allocate(mask);
+            (writeComponent(entity, detail::componentId<Ts>(), &components), ...);
+            return entity;
+        }
+
+        void destroy(Entity entity);
+        bool alive(Entity entity) const;
+        size_t size() const { return liveCount; }
+
+        // The entity's component, null if it is dead or has no T
+        template <typename T>
+        T* get(Entity entity) {
+            return static_cast<T*>(component(entity, detail::componentId<T>()));
+        }
+
+        template <typename T>
+        void add(Entity entity, const T& value) {
+            const uint32_t id = detail::componentId<T>();
+            if (!alive(entity))
+                return;
+            move(entity, maskOf(entity) | (ComponentMask(1) << id));
+            writeComponent(entity, id, &value);
+        }
+
+        template <typename T>
+        void remove(Entity entity) {
+            if (alive(entity))
+                move(entity, maskOf(entity) & ~(ComponentMask(1) << detail::componentId<T>()));
+        }
+
+        // f(count, Ts*...) once per chunk whose entities have every one of Ts
+        template <typename... Ts, typename F>
+        void each(F&& f) {
+            const ComponentMask required = detail::componentMask<Ts...>();
+            for (const std::unique_ptr<Archetype>& archetype : archetypes) {
+                if ((archetype->mask & required) != required)
+                    continue;
+                for (const Chunk& chunk : archetype->chunks)
+                    f(chunk.count, reinterpret_cast<Ts*>(chunk.data + archetype->offsets[detail::componentId<Ts>()])...);
+            }
+        }
+
+        // The same, with chunks spread over worker threads (threads = 0 uses
+        // every worker). f must only touch the chunk it is given.
+        template <typename... Ts, typename F>
+        void parallelEach(F&& f, unsigned int threads = 0) {
+            std::vector<ChunkRef> chunks;
+            matchingChunks(detail::componentMask<Ts...>(), chunks);
+            const size_t ranges = threads ? threads : workerCount();
+            parallelFor(chunks.size(), [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    const ChunkRef& ref = chunks[i];
+                    f(ref.chunk->count,
+                      reinterpret_cast<Ts*>(ref.chunk->data + ref.archetype->offsets[detail::componentId<Ts>()])...);
+                }
+            }, (chunks.size() + ranges - 1) / ranges);
+        }
+
+        size_t archetypeCount() const { return archetypes.size(); }
+
+    private:
+        struct Chunk {
+            unsigned char* data;
+            size_t count;
+        };
+
+        struct Archetype {
+            ComponentMask mask = 0;
+            size_t capacity = 0;                        // entities per chunk
+            size_t chunkBytes = 0;
+            size_t offsets[MAX_COMPONENT_TYPES] = {};   // array offset per component id in mask
+            size_t sizes[MAX_COMPONENT_TYPES] = {};
+            std::vector<uint32_t> components;
+            std::vector<Chunk> chunks;                  // all full except the last
+        };
+
+        struct ChunkRef {
+            const Archetype* archetype;
+            const Chunk* chunk;
+        };
+
+        struct Slot {
+            uint32_t generation = 0;
+            uint32_t archetype = 0;
+            uint32_t chunk = 0;
+            uint32_t row = 0;
+            bool alive = false;
+        };
+
+        Entity allocate(ComponentMask mask);
+        uint32_t archetypeFor(ComponentMask mask);
+        void place(Entity entity, uint32_t archetype);
+        void removeRow(uint32_t archetype, uint32_t chunk, uint32_t row);
+        void move(Entity entity, ComponentMask mask);
+        ComponentMask maskOf(Entity entity) const;
+        void* component(Entity entity, uint32_t id);
+        void writeComponent(Entity entity, uint32_t id, const void* value);
+        void matchingChunks(ComponentMask required, std::vector<ChunkRef>& out) const;
+
+        std::vector<std::unique_ptr<Archetype>> archetypes;
+        std::unordered_map<ComponentMask, uint32_t> archetypeIndex;
+        std::vector<Slot> slots;
+        std::vector<uint32_t> freeSlots;
+        size_t liveCount = 0;
+    };
+}
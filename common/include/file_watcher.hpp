@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Common {
+    // Watches a set of files on a background thread and reports which ones
+    // changed. On Linux this is inotify on the files' directories, so files
+    // that do not exist yet and editors that save by renaming a temporary file
+    // are both picked up; a change is reported once the writer closes the
+    // file. Elsewhere the thread polls modification times twice a second.
+    //
+    // changes() is meant to be drained once per frame on the render thread,
+    // which then rebuilds or swaps the affected assets at a frame boundary.
+    class FileWatcher {
+    public:
+        FileWatcher();
+        ~FileWatcher();
+
+        FileWatcher(const FileWatcher&) = delete;
+        FileWatcher& operator=(const FileWatcher&) = delete;
+
+        // Start watching a file (which need not exist yet). Changes are
+        // reported with the path exactly as given here.
+        void watch(const std::string& path);
+
+        // Paths that changed since the last call, each listed once
+        std::vector<std::string> changes();
+
+    private:
+        struct Watch {
+            std::string path;           // as given to watch()
+            std::string directory;
+            std::string name;
+            long long modified = 0;     // polling fallback only
+        };
+
+        void run();
+        void notify(const std::string& directory, const std::string& name);
+
+        std::mutex mutex;
+        std::vector<Watch> watches;
+        std::vector<std::string> changed;
+        std::atomic<bool> stopping{ false };
+        int inotifyFd = -1;
+        std::vector<std::pair<int, std::string>> directoryWatches;    // inotify wd -> directory
+        std::thread worker;
+    };
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace Common {
+    // First-fit allocator over [0, capacity) in abstract units. Free blocks
+    // are kept sorted by offset and merged with their neighbours on free().
+    class FreeListAllocator {
+    public:
+        static constexpr size_t INVALID = ~size_t(0);
+
+        explicit FreeListAllocator(size_t capacity = 0);
+
+        // Offset of a free range of this size, or INVALID if none is large enough
+        size_t allocate(size_t size);
+        void free(size_t offset, size_t size);
+
+        // Extend the range; the new space joins a free block at the end
+        void grow(size_t newCapacity);
+        // Everything free again
+        void reset(size_t capacity);
+
+        size_t capacity() const { return total; }
+        size_t used() const { return inUse; }
+        size_t largestFree() const;
+        size_t freeBlockCount() const { return freeBlocks.size(); }
+
+    private:
+        std::map<size_t, size_t> freeBlocks;    // offset -> size
+        size_t total = 0;
+        size_t inUse = 0;
+    };
+
+    // A float vertex attribute inside an interleaved vertex
+    struct VertexAttribute {
+        unsigned int location;
+        int components;
+        size_t offset;      // bytes from the start of the vertex
+    };
+
+    // Static meshes with the same vertex layout, sub-allocated from one vertex
+    // buffer and one index buffer behind a single VAO. Any two meshes in the
+    // arena can be drawn without rebinding, and the whole arena can be drawn
+    // with glMultiDrawElementsIndirect.
+    //
+    // Indices are stored relative to the mesh, so a mesh is drawn with its
+    // range's baseVertex and firstIndex. Full buffers grow (doubling) by a GPU
+    // copy. defragment() repacks the live meshes when free space is scattered.
+    // Mesh ids stay valid through both; ranges may change.
+    //
+    // GL thread only.
+    class GeometryArena {
+    public:
+        using MeshId = uint32_t;
+        static constexpr MeshId INVALID_MESH = ~0u;
+
+        struct Range {
+            int baseVertex = 0;
+            unsigned int vertexCount = 0;
+            unsigned int firstIndex = 0;
+            unsigned int indexCount = 0;
+        };
+
+        GeometryArena(size_t vertexStride, std::vector<VertexAttribute> attributes,
+                      size_t vertexCapacity = 1u << 16, size_t indexCapacity = 1u << 18);
+
+        GeometryArena(const GeometryArena&) = delete;
+        GeometryArena& operator=(const GeometryArena&) = delete;
+
+        // Create the buffers and VAO; call with the context current
+        void create();
+        void destroy();
+
+        // Copy a mesh in; vertices are vertexCount * stride bytes. INVALID_MESH on failure.
+        MeshId upload(const void* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount);
+        void free(MeshId mesh);
+
+        const Range& range(MeshId mesh) const { return meshes[mesh].range; }
+        unsigned int vertexArray() const { return vao; }
+
+        // Share of free vertex and index space that is not in the largest free
+        // block (0 = all free space contiguous)
+        float fragmentation() const;
+
+        // Move every live mesh to the front of new buffers. Returns the number
+        // of meshes whose ranges changed.
+        size_t defragment();
+
+        size_t meshCount() const { return meshes.size() - freeIds.size(); }
+        size_t vertexBytesUsed() const { return vertexSpace.used() * stride; }
+        size_t indexBytesUsed() const { return indexSpace.used() * sizeof(unsigned int); }
+
+    private:
+        struct Mesh {
+            Range range;
+            bool live = false;
+        };
+
+        bool reserve(size_t vertexCount, size_t indexCount);
+        void reallocate(size_t vertexCapacity, size_t indexCapacity, bool pack);
+        void setupVertexArray();
+
+        size_t stride;
+        std::vector<VertexAttribute> attributes;
+        FreeListAllocator vertexSpace;
+        FreeListAllocator indexSpace;
+        std::vector<Mesh> meshes;
+        std::vector<MeshId> freeIds;
+        unsigned int vao = 0;
+        unsigned int vertexBuffer = 0;
+        unsigned int indexBuffer = 0;
+    };
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+
+namespace Common {
+    struct GLStateStats {
+        size_t issued = 0;      // calls that reached the driver
+        size_t elided = 0;      // calls skipped because the state was already set
+    };
+
+    // Shadow copy of the GL state the renderer touches: the bound program,
+    // textures per unit, the VAO, buffer bindings, enabled capabilities, blend,
+    // depth and polygon mode. Each setter compares against the shadow and only
+    // calls GL when the value actually changes.
+    //
+    // Everything starts out unknown, so the first call always goes through.
+    // The shadow is only right if every change goes through here; code that
+    // calls GL directly must call invalidate() afterwards. Deleting a bound
+    // texture, VAO or buffer silently unbinds it (and GL may hand the name out
+    // again), so deletions are reported with the *Deleted() functions.
+    //
+    // GL thread only.
+    class GLStateCache {
+    public:
+        GLStateCache();
+
+        void useProgram(unsigned int program);
+
+        // Bind on a texture unit (0-based), switching the active unit if needed
+        void bindTexture(unsigned int unit, unsigned int target, unsigned int texture);
+        // Bind on whichever unit is active, for code that only needs a binding
+        // to upload through
+        void bindTexture(unsigned int target, unsigned int texture);
+
+        void bindVertexArray(unsigned int vao);
+
+        // Element array bindings belong to the VAO and are forgotten when it changes
+        void bindBuffer(unsigned int target, unsigned int buffer);
+        // Indexed binding; also replaces the generic binding, as in GL
+        void bindBufferBase(unsigned int target, unsigned int index, unsigned int buffer);
+
+        void enable(unsigned int capability);
+        void disable(unsigned int capability);
+        void setEnabled(unsigned int capability, bool enabled);
+
+        void blendFunc(unsigned int source, unsigned int destination);
+        void depthFunc(unsigned int function);
+        void depthMask(bool write);
+        void polygonMode(unsigned int mode);    // GL_FRONT_AND_BACK, the only face core allows
+
+        void textureDeleted(unsigned int texture);
+        void vertexArrayDeleted(unsigned int vao);
+        void bufferDeleted(unsigned int buffer);
+
+        // Forget everything; the next call of each kind goes to GL
+        void invalidate();
+
+        // Counters since the last beginFrame()
+        void beginFrame() { frame = GLStateStats(); }
+        const GLStateStats& stats() const { return frame; }
+
+        static constexpr unsigned int MAX_TEXTURE_UNITS = 16;
+        static constexpr unsigned int MAX_UNIFORM_BINDINGS = 16;
+
+    private:
+        enum TextureTarget { TEXTURE_2D, TEXTURE_CUBE_MAP, TEXTURE_2D_ARRAY, TEXTURE_3D, TEXTURE_TARGETS };
+        enum BufferTarget { ARRAY_BUFFER, ELEMENT_ARRAY_BUFFER, UNIFORM_BUFFER, DRAW_INDIRECT_BUFFER, BUFFER_TARGETS };
+        enum Capability { DEPTH_TEST, BLEND, CULL_FACE, SEAMLESS_CUBE_MAP, CAPABILITIES };
+
+        // Returns true if the caller should issue the call, and updates the shadow
+        bool change(unsigned int& shadow, unsigned int value);
+        void activeTexture(unsigned int unit);
+
+        unsigned int program;
+        unsigned int activeUnit;
+        unsigned int textures[MAX_TEXTURE_UNITS][TEXTURE_TARGETS];
+        unsigned int vertexArray;
+        unsigned int buffers[BUFFER_TARGETS];
+        unsigned int uniformBindings[MAX_UNIFORM_BINDINGS];
+        unsigned int capabilities[CAPABILITIES];
+        unsigned int blendSource, blendDestination;
+        unsigned int depthFunction;
+        unsigned int depthWrite;
+        unsigned int polygon;
+        GLStateStats frame;
+    };
+
+    // The cache for the application's GL context. Common's own helpers
+    // (texture streamer, uniform buffers, shaders) bind through it.
+    GLStateCache& glState();
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Common {
+    struct Job;
+    class JobCounter;
+
+    namespace detail {
+        // The calling thread's next free job slot. If its ring has wrapped onto
+        // a job that has not run yet, runs jobs until that one has.
+        Job* allocateJob();
+
+        // Queue the job now, or once after reaches zero
+        void enqueueJob(Job* job, JobCounter* after);
+
+        // Take the job off its counter once it has run
+        void finishJob(JobCounter* counter);
+    }
+
+    // Counts unfinished jobs. Each job submitted with a counter adds one and
+    // takes it off when it has run; waitForCounter() returns once it is zero.
+    // A counter may be reused once it reaches zero, and must not be destroyed
+    // while jobs still count on it or wait for it.
+    class JobCounter {
+    public:
+        JobCounter() = default;
+        JobCounter(const JobCounter&) = delete;
+        JobCounter& operator=(const JobCounter&) = delete;
+
+        bool done() const {
+            return pending.load(std::memory_order_acquire) == 0 && finishing.load(std::memory_order_acquire) == 0;
+        }
+
+    private:
+        friend void detail::enqueueJob(Job* job, JobCounter* after);
+        friend void detail::finishJob(JobCounter* counter);
+
+        std::atomic<uint32_t> pending{0};
+        std::atomic<uint32_t> finishing{0};     // finishers still touching the counter
+        std::mutex waitingMutex;
+        std::vector<Job*> waiting;              // held back until pending reaches zero
+    };
+
+    constexpr size_t JOB_STORAGE_BYTES = 40;
+
+    // A callable and the counter it finishes, one cache line. Jobs live in a
+    // ring per submitting thread, so none is allocated or freed on its own.
+    struct alignas(64) Job {
+        void (*invoke)(Job& job) = nullptr;     // runs and destroys the stored callable
+        JobCounter* counter = nullptr;
+        std::atomic<bool> finished{true};
+        alignas(8) unsigned char storage[JOB_STORAGE_BYTES];
+    };
+
+    // Work-stealing scheduler. The main thread (see attachMainThread()) and
+    // workerCount() - 1 worker threads each own a Chase-Lev deque: the owner
+    // pushes and pops jobs at the bottom, idle threads steal from the top.
+    // Any other thread submits through a shared locked queue. Waiting on
+    // a counter runs queued jobs instead of blocking, so nested waits cannot
+    // deadlock and the waiting thread adds to the throughput.
+    //
+    // Jobs should be short and must block on nothing but counters: a thread
+    // waiting on a counter may pick up any queued job, so file IO or a long
+    // parse belongs on a thread of its own.
+
+    // Run f() on some thread. counter, if given, counts the job until it has
+    // run. after, if given, holds the job back until that counter reaches zero.
+    template <typename F>
+    void submitJob(F&& f, JobCounter* counter = nullptr, JobCounter* after = nullptr) {
+        using Callable = typename std::decay<F>::type;
+        Job* job = detail::allocateJob();
+        if constexpr (sizeof(Callable) <= JOB_STORAGE_BYTES && alignof(Callable) <= 8) {
+            new (job->storage) Callable(std::forward<F>(f));
+            job->invoke = [](Job& j) {
+                Callable* callable = std::launder(reinterpret_cast<Callable*>(j.storage));
+                (*callable)();
+                callable->~Callable();
+            };
+        } else {
+            // Too big to keep in the job: the job holds a pointer to it instead
+            Callable* callable = new Callable(std::forward<F>(f));
+            std::memcpy(job->storage, &callable, sizeof(callable));
+            job->invoke = [](Job& j) {
+                Callable* callable;
+                std::memcpy(&callable, j.storage, sizeof(callable));
+                (*callable)();
+                delete callable;
+            };
+        }
+        job->counter = counter;
+        detail::enqueueJob(job, after);
+    }
+
+    // Start the workers and give the calling thread the deque that is not a
+    // worker's. Call once from the main thread before starting any thread
+    // that submits jobs; later calls, from any thread, change nothing.
+    // Without it every non-worker thread uses the shared queue.
+    void attachMainThread();
+
+    // Run queued jobs on the calling thread until counter reaches zero
+    void waitForCounter(JobCounter& counter);
+
+    // Take one queued job and run it; false if there was none
+    bool runPendingJob();
+
+    // Whether jobs the calling thread queued are still waiting to be taken.
+    // parallelFor splits off more work only once its own queue has run dry.
+    bool hasQueuedJobs();
+}
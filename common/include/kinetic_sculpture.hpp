@@ -0,0 +1,127 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace Common {
+    class LinkageSolver;
+
+    // Element meshes hang from a pivot at the origin and turn about local +X:
+    //   Rod     a pendulum arm along -Y
+    //   Vane    a flat plate in the XY plane below the pivot
+    //   Sphere  a pendulum bob below the pivot
+    enum class ElementShape { Rod, Vane, Sphere };
+
+    // Interleaved position + normal (6 floats per vertex), one unit long,
+    // scaled by size. segments sets the roundness of rods and spheres.
+    void buildElementMesh(ElementShape shape, unsigned int segments, float size,
+                          std::vector<float>& vertices, std::vector<unsigned int>& indices);
+
+    // Per-instance attributes, read at these locations by sculpture_element.vs
+    constexpr unsigned int SCULPTURE_OFFSET_LOCATION = 4;     // vec4 offset, phase
+    constexpr unsigned int SCULPTURE_AXIS_LOCATION = 5;       // vec4 axis, frequency
+    constexpr unsigned int SCULPTURE_ANGLE_LOCATION = 6;      // float swing angle, simulated sculptures only
+
+    struct SculptureInstance {
+        glm::vec3 offset;       // pivot position in sculpture space
+        float phase;            // radians
+        glm::vec3 axis;         // unit pivot axis
+        float frequency;        // radians per second
+    };
+
+    // Elements spread evenly over a flat ring (golden-angle spiral), each
+    // pivoting about its spoke. The phase runs outwards and around in a
+    // spiral, so the swing travels across the ring as a wave.
+    struct SculptureLayout {
+        float innerRadius = 1.6f;
+        float outerRadius = 3.0f;
+        float frequency = 2.0f;     // radians per second
+        float radialWaves = 4.0f;   // phase turns from the inner to the outer edge
+        int spiralArms = 3;         // phase turns around the ring
+    };
+
+    void layoutSculpture(size_t count, const SculptureLayout& layout, std::vector<SculptureInstance>& instances);
+
+    // Distance between neighbouring elements for a layout and count
+    float elementSpacing(size_t count, const SculptureLayout& layout);
+
+    // Linked sculptures: one rod per instance, drawn from pivot to tip by the
+    // shader's LINKED variant, at the same locations as SculptureInstance
+    struct LinkTransform {
+        glm::vec3 pivot;
+        float unused0;
+        glm::vec3 tip;
+        float unused1;
+    };
+
+    // Articulated sculpture: a chain of `links` rods of linkLength hanging
+    // from each element of the layout (anchors, as laid out). Chain i is
+    // particles i * (links + 1) onwards, the first pinned. Every rod is a
+    // distance constraint hinged about the element's spoke, and each joint an
+    // angle constraint of jointStiffness that springs back to straight.
+    void buildChainSculpture(LinkageSolver& solver, const std::vector<SculptureInstance>& anchors, unsigned int links,
+                             float linkLength, float jointStiffness);
+
+    // The rods of every chain, in chain order (anchors.size() * links of them)
+    void writeChainTransforms(const LinkageSolver& solver, size_t chains, unsigned int links, LinkTransform* out);
+
+    // One element mesh drawn count times with glDrawElementsInstanced. The
+    // per-instance attributes never change; the motion is evaluated in the
+    // vertex shader from FrameBlock::animationTime, so the CPU cost per frame
+    // is one draw call whatever the count.
+    //
+    // A simulated sculpture instead takes each element's swing angle from a
+    // float per instance that the CPU rewrites every frame (see
+    // OscillatorSolver), drawn with the shader's SIMULATED variant. A linked
+    // sculpture rewrites whole rods (see LinkageSolver) for the LINKED variant.
+    //
+    // GL thread only.
+    class KineticSculpture {
+    public:
+        KineticSculpture() = default;
+        KineticSculpture(const KineticSculpture&) = delete;
+        KineticSculpture& operator=(const KineticSculpture&) = delete;
+
+        // Build the mesh, sized to the element spacing, and the instance
+        // buffer; replaces anything created before. False if count is 0.
+        bool create(ElementShape shape, size_t count, const SculptureLayout& layout = SculptureLayout(),
+                    bool simulated = false);
+        // The same from instances laid out elsewhere, meshes sized to spacing
+        bool create(ElementShape shape, const std::vector<SculptureInstance>& instances, float spacing,
+                    bool simulated = false);
+        // count rods linkLength long, placed each frame through mapTransforms
+        bool createLinked(size_t count, float linkLength);
+        void destroy();
+
+        // Simulated sculptures: the angle buffer for the next draw, orphaned and
+        // mapped write-only (instanceCount() floats, null on failure). Map and
+        // unmap on the GL thread; in between any thread may fill it.
+        float* mapAngles();
+        void unmapAngles();
+        bool simulated() const { return angleBuffer != 0; }
+
+        // Linked sculptures: the rods for the next draw, mapped the same way
+        LinkTransform* mapTransforms();
+        void unmapTransforms();
+        bool linked() const { return linkedInstances; }
+
+        unsigned int vertexArray() const { return vao; }
+        unsigned int indexCount() const { return elementIndexCount; }
+        size_t instanceCount() const { return instances; }
+
+    private:
+        void createBuffers(const std::vector<float>& vertices, const std::vector<unsigned int>& indices,
+                           const void* instanceData, size_t count, bool streamed);
+
+        unsigned int vao = 0;
+        unsigned int vertexBuffer = 0;
+        unsigned int indexBuffer = 0;
+        unsigned int instanceBuffer = 0;
+        unsigned int angleBuffer = 0;
+        unsigned int elementIndexCount = 0;
+        size_t instances = 0;
+        bool linkedInstances = false;
+    };
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Common {
+    // Position-based dynamics for linkages: particles joined by constraints
+    // that are each projected in turn, a few iterations per step.
+    //
+    //   Distance  keeps two particles at their starting distance (a rod)
+    //   Hinge     keeps the rod from a to b at its starting offset along an
+    //             axis, so it only swings about that axis
+    //   Angle     keeps the bend at b between b->a and b->c, measured about an
+    //             axis, at its starting value
+    //
+    // Constraints are graph colored so that no two in a color share a
+    // particle. Each color is then solved in parallel across worker threads
+    // without locks. Colors run in a fixed order, so the result is the same
+    // for any thread count.
+    class LinkageSolver {
+    public:
+        enum class ConstraintType : uint8_t { Distance, Hinge, Angle };
+
+        void clear();
+
+        // inverseMass 0 pins the particle; pinned particles are moved with setPosition
+        size_t addParticle(const glm::vec3& position, float inverseMass = 1.0f);
+        void setPosition(size_t i, const glm::vec3& position);
+        const glm::vec3& position(size_t i) const { return positions[i]; }
+
+        // stiffness in (0, 1]: the fraction of the error removed per step,
+        // whatever the iteration count
+        void addDistance(size_t a, size_t b, float stiffness = 1.0f);
+        void addHinge(size_t a, size_t b, const glm::vec3& axis, float stiffness = 1.0f);
+        void addAngle(size_t a, size_t b, size_t c, const glm::vec3& axis, float stiffness = 1.0f);
+
+        void setGravity(const glm::vec3& value) { gravity = value; }
+        void setDamping(float value) { damping = value; }     // velocity lost per second, as a fraction
+
+        // Advance by dt, projecting every constraint iterations times.
+        // threads = 0 uses every worker.
+        void step(float dt, unsigned int iterations, unsigned int threads = 0);
+
+        size_t particleCount() const { return positions.size(); }
+        size_t constraintCount() const { return constraints.size(); }
+        // Colors of the last step (built on the first step after a change)
+        size_t colorCount() const { return colorStart.empty() ? 0 : colorStart.size() - 1; }
+
+        // Largest relative length error over the distance constraints
+        float maxStretch() const;
+
+    private:
+        struct Constraint {
+            ConstraintType type;
+            uint32_t a, b, c;
+            float rest;         // length, offset along the axis, or angle
+            float stiffness;
+            glm::vec3 axis;
+        };
+
+        void buildColors();
+        void setIterations(unsigned int iterations);
+        void project(const Constraint& constraint, float stiffness);
+
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> predicted;
+        std::vector<glm::vec3> velocities;
+        std::vector<float> inverseMasses;
+
+        std::vector<Constraint> constraints;        // in the order they were added
+        std::vector<Constraint> ordered;            // grouped by color
+        std::vector<float> orderedStiffness;        // per-iteration stiffness of ordered
+        std::vector<size_t> colorStart;             // color i is ordered[colorStart[i], colorStart[i + 1])
+        bool colorsDirty = true;
+        unsigned int stiffnessIterations = 0;
+
+        glm::vec3 gravity = glm::vec3(0.0f, -9.81f, 0.0f);
+        float damping = 0.0f;
+    };
+}
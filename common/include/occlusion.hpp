@@ -0,0 +1,96 @@
+#pragma once
+
+#include "bvh.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Common {
+    // A unit sphere of segments around and segments / 2 from pole to pole,
+    // counter-clockwise from outside. Its vertices lie on the sphere, so the
+    // mesh lies inside it: an occluder for anything round.
+    void buildOccluderSphere(unsigned int segments, std::vector<glm::vec3>& vertices,
+                             std::vector<uint32_t>& indices);
+
+    // Software occlusion culling. A few large, simple occluder meshes are
+    // rasterized on the CPU into a small depth buffer, keeping the nearest
+    // depth per pixel. The buffer is reduced to a hierarchical-Z (Hi-Z)
+    // pyramid, each texel the farthest depth of the four below it, and an
+    // occludee's box is hidden if its nearest point lies behind the farthest
+    // depth over the pixels it covers, read from the level where that is at
+    // most 2x2 texels.
+    //
+    // Triangles are set up and binned by the tiles they touch, then tiles
+    // are filled in parallel, 4 pixels at a time (simd.hpp). Depth is NDC z,
+    // -1 near to 1 far. Triangles crossing the near plane are dropped, which
+    // only loses occlusion.
+    class OcclusionBuffer {
+    public:
+        static constexpr unsigned int TILE_WIDTH = 32;
+        static constexpr unsigned int TILE_HEIGHT = 16;
+
+        // width x height pixels, rounded up to whole tiles; clears
+        void resize(unsigned int width, unsigned int height);
+        // Drop the occluders and reset every depth to far
+        void clear();
+
+        // An occluder mesh drawn with modelViewProjection: counter-clockwise
+        // triangles, back faces skipped. It must lie inside what it stands for.
+        void addOccluder(const glm::mat4& modelViewProjection, const glm::vec3* vertices, size_t vertexCount,
+                         const uint32_t* indices, size_t indexCount);
+        // Fill the tiles with every occluder added since clear() and build
+        // the pyramid; threads = 0 uses every worker
+        void rasterize(unsigned int threads = 0);
+
+        // Whether a box drawn with modelViewProjection is hidden. Boxes
+        // crossing the near plane or wholly off screen never are.
+        bool occluded(const glm::mat4& modelViewProjection, const Aabb& box) const;
+        // Remove from visible the indices whose boxes[index] are hidden,
+        // keeping the order; returns how many remain
+        size_t cull(const glm::mat4& modelViewProjection, const Aabb* boxes, std::vector<uint32_t>& visible,
+                    unsigned int threads = 0);
+
+        unsigned int width() const { return levels.empty() ? 0 : levels[0].width; }
+        unsigned int height() const { return levels.empty() ? 0 : levels[0].height; }
+        size_t triangleCount() const { return triangles.size(); }
+        // Level 0 is the depth buffer, row 0 at the bottom of the screen
+        size_t levelCount() const { return levels.size(); }
+        const std::vector<float>& level(size_t i) const { return levels[i].depth; }
+
+        // A box on screen: its NDC bounds and nearest depth
+        struct ScreenRect {
+            float minX, maxX, minY, maxY;
+            float nearest;
+        };
+
+    private:
+        // Edge functions and the depth plane over pixel coordinates, each
+        // a * x + b * y + c; a pixel center is inside where every edge is >= 0
+        struct Triangle {
+            float edgeA[3], edgeB[3], edgeC[3];
+            float depthA, depthB, depthC;
+            int minX, minY, maxX, maxY;     // pixel bounds, inclusive
+        };
+
+        struct Level {
+            unsigned int width = 0;
+            unsigned int height = 0;
+            std::vector<float> depth;
+        };
+
+        void fillTile(size_t tile);
+        void buildPyramid();
+        bool hidden(const ScreenRect& rect) const;
+
+        unsigned int tilesX = 0;
+        unsigned int tilesY = 0;
+        std::vector<glm::vec4> projected;          // addOccluder() scratch
+        std::vector<Triangle> triangles;
+        std::vector<std::vector<uint32_t>> bins;    // triangles touching each tile, in order
+        std::vector<Level> levels;
+        std::vector<uint8_t> occludedFlags;         // cull() scratch
+    };
+}
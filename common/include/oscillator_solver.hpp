@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace Common {
+    enum class Integrator { SemiImplicitEuler, Verlet };
+
+    // Many independent damped, driven pendulums, stepped together on the CPU:
+    //
+    //   angle'' = -stiffness * sin(angle) - damping * angle'
+    //             + driveAmplitude * sin(driveFrequency * t + drivePhase)
+    //
+    // stiffness is the squared natural frequency (g / length for a pendulum).
+    // Per-oscillator values differ, damping and drive frequency are shared.
+    // This covers pendulum waves (stiffness varies along the sculpture) and
+    // wind-driven vanes (the drive phase travels across it).
+    //
+    // State is stored as structure of arrays, padded to the SIMD width, and
+    // each step runs 4-wide (simd.hpp) over contiguous blocks split across
+    // worker threads. The drive is expanded with the angle-sum identity, so
+    // the only per-oscillator transcendental is the pendulum's sin(angle).
+    class OscillatorSolver {
+    public:
+        // Drop every oscillator and make room for count new ones, at rest
+        void resize(size_t count);
+        size_t size() const { return count; }
+
+        void set(size_t i, float stiffness, float driveAmplitude, float drivePhase,
+                 float angle = 0.0f, float velocity = 0.0f);
+
+        void setDamping(float value) { damping = value; }
+        void setDriveFrequency(float value) { driveFrequency = value; }
+        // Switching keeps the current angles and velocities
+        void setIntegrator(Integrator value);
+
+        // Advance every oscillator by dt and, if out is given, write the new
+        // angles to out[0, size()). out is only written, front to back, so it
+        // can be a mapped GL buffer. threads = 0 uses every worker.
+        void step(float dt, float* out = nullptr, unsigned int threads = 0);
+
+        const float* angles() const { return angle.data(); }
+        double time() const { return elapsed; }
+
+    private:
+        template <Integrator I>
+        void stepBlocks(size_t begin, size_t end, float dt, float sinDrive, float cosDrive, float* out);
+
+        size_t count = 0;
+        Integrator integrator = Integrator::SemiImplicitEuler;
+        float damping = 0.0f;
+        float driveFrequency = 0.0f;
+        double elapsed = 0.0;
+        float lastDt = 0.0f;    // Verlet: the step previousAngle was taken with
+
+        std::vector<float> angle;
+        std::vector<float> velocity;        // semi-implicit Euler
+        std::vector<float> previousAngle;   // Verlet
+        std::vector<float> stiffness;
+        std::vector<float> driveSin;        // driveAmplitude * sin(drivePhase)
+        std::vector<float> driveCos;        // driveAmplitude * cos(drivePhase)
+    };
+}
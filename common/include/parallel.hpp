@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace Common {
+    // Threads the job system runs on, the calling thread included (hardware
+    // concurrency, at least 1)
+    unsigned int workerCount();
+
+    // Split [0, count) into contiguous ranges of at least minChunk items and run
+    // body(begin, end) on them as jobs (see job_system.hpp). Ranges are split
+    // off only while other threads are taking them, so an idle machine gets
+    // many and a busy one few; there are never more than count / minChunk.
+    // The calling thread runs ranges too and blocks until all have finished.
+    // May be called from inside a job.
+    void parallelFor(size_t count, const std::function<void(size_t begin, size_t end)>& body,
+                     size_t minChunk = 1);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Common {
+    // GLSL for one vertex + fragment program
+    struct ProgramSource {
+        std::string vertex;
+        std::string fragment;
+    };
+
+    // A program whose compile and link have been issued but not checked yet.
+    // Drivers that compile on background threads only block when the status
+    // is queried, so issuing a whole batch before finishing any overlaps them.
+    struct PendingProgram {
+        unsigned int program = 0;
+        unsigned int vertex = 0;
+        unsigned int fragment = 0;
+    };
+
+    PendingProgram beginProgram(const ProgramSource& source, bool retrievable = false);
+
+    // True once the compile and link have completed, without blocking. Needs
+    // KHR_parallel_shader_compile; without it every program reports ready and
+    // finishProgram() does the waiting.
+    bool programReady(const PendingProgram& pending);
+
+    // KHR_parallel_shader_compile: GL_COMPLETION_STATUS_KHR can be polled and
+    // the driver compiles on its own threads
+    bool parallelCompileSupported();
+
+    // Number of driver compile threads (0 compiles on the calling thread,
+    // 0xFFFFFFFF lets the driver choose). False without the extension.
+    bool setShaderCompilerThreads(unsigned int count);
+
+    // Check the compile and link status, printing any log. Returns the program,
+    // or 0 (and deletes it) if linking failed.
+    unsigned int finishProgram(PendingProgram& pending);
+
+    // Abandon a program that is no longer wanted without waiting for its compile
+    void cancelProgram(PendingProgram& pending);
+
+    // Compile and link a vertex + fragment program from source, printing any
+    // compile or link log. Returns 0 if linking failed. With retrievable set the
+    // driver is asked to keep the binary around for glGetProgramBinary.
+    unsigned int compileProgram(const std::string& vertexSource, const std::string& fragmentSource,
+                                bool retrievable = false);
+
+    // Program binary cache (glGetProgramBinary / glProgramBinary).
+    //
+    // Each program is stored in <directory>/<hash>.glbin, where the hash covers
+    // the shader sources. The file header records the GL vendor, renderer and
+    // version strings it was built with; a driver update changes those, so the
+    // stale binary is ignored and overwritten on the next link. Any failure
+    // (no binary formats, unreadable file, glProgramBinary rejected) falls back
+    // to compiling from source, so callers never need to care whether the cache
+    // is available.
+    //
+    // Must be used on the GL thread with a current context.
+    class ProgramCache {
+    public:
+        explicit ProgramCache(std::string directory = "shader_cache");
+
+        // Linked program for these sources, from the cache when possible; 0 on failure
+        unsigned int link(const std::string& vertexSource, const std::string& fragmentSource);
+
+        // Link a batch: cached binaries are loaded first, then every miss is
+        // issued before any is finished. programs[i] is 0 where linking failed.
+        std::vector<unsigned int> linkAll(const std::vector<ProgramSource>& sources);
+
+        // Building blocks for callers that finish programs on their own schedule:
+        // load() returns the cached binary or 0 on a miss; a miss should be
+        // compiled with beginProgram(source, retrievable()) and handed to store()
+        // once linked.
+        unsigned int load(const ProgramSource& source);
+        void store(const ProgramSource& source, unsigned int program);
+        bool retrievable();
+
+        size_t hits() const { return hitCount; }
+        size_t misses() const { return missCount; }
+
+    private:
+        bool available();
+        std::string binaryPath(uint64_t sourceHash) const;
+        unsigned int loadBinary(const std::string& path, uint64_t sourceHash);
+        void storeBinary(const std::string& path, uint64_t sourceHash, unsigned int program);
+
+        std::string directory;
+        std::string driver;     // "vendor|renderer|version" of the current context
+        int supported = -1;     // -1 until the first link queries the driver
+        size_t hitCount = 0;
+        size_t missCount = 0;
+    };
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "uniform_blocks.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace Common {
+    // Sort key layout, most significant first:
+    //   pass (8) | program (16) | material (16) | depth (24)
+    // Packets are replayed in ascending key order, so passes run in order, and
+    // within a pass draws are grouped by program, then by material, then front
+    // to back. Only the low 16 bits of program and material ids are used; ids
+    // that collide just sort together, they never draw with the wrong state.
+    // depth is the view depth mapped to [0, 1] (clamped).
+    uint64_t makeSortKey(uint8_t pass, uint32_t program, uint32_t material, float depth);
+
+    // Key for blended passes: pass (8) | far-to-near depth (24) | program (16) | material (16)
+    uint64_t makeBackToFrontKey(uint8_t pass, float depth, uint32_t program, uint32_t material);
+
+    // Textures bound for a draw; unit i gets textures[i]
+    struct Material {
+        static constexpr unsigned int MAX_TEXTURES = 8;
+
+        uint32_t id = 0;                    // sort id, see makeSortKey()
+        unsigned int textureTarget = 0;     // e.g. GL_TEXTURE_CUBE_MAP
+        unsigned int textureCount = 0;
+        unsigned int textures[MAX_TEXTURES] = {};
+    };
+
+    // Per-instance model matrix for instanced packets: a mat4 attribute taking
+    // this location and the next three
+    constexpr unsigned int INSTANCE_MODEL_LOCATION = 4;
+
+    // One indexed draw. The material must stay alive until the queue is submitted.
+    //
+    // An instanced packet's program reads its model matrix from the attribute
+    // at INSTANCE_MODEL_LOCATION instead of ObjectBlock (only the block's model
+    // is used). Runs of instanced packets that share program, material, VAO and
+    // mode are drawn with one glMultiDrawElementsIndirect call. If the program
+    // has no mat4 at that location the packet is drawn like a non-instanced
+    // one, with its ObjectBlock, so record the block in full either way.
+    //
+    // A non-instanced packet with instanceCount > 1 draws that many instances
+    // with glDrawElementsInstanced; per-instance data comes from the packet's
+    // own VAO, and the ObjectBlock applies to all of them.
+    struct DrawPacket {
+        uint64_t key = 0;
+        unsigned int program = 0;
+        unsigned int vertexArray = 0;
+        const Material* material = nullptr;
+        unsigned int mode = 0x0004;         // GL_TRIANGLES
+        unsigned int indexCount = 0;
+        unsigned int firstIndex = 0;        // 32-bit indices
+        int baseVertex = 0;
+        unsigned int instanceCount = 1;
+        bool instanced = false;
+    };
+
+    struct RenderQueueStats {
+        size_t packets = 0;
+        size_t drawCalls = 0;       // GL draw calls issued
+        size_t multiDraws = 0;      // of which glMultiDrawElementsIndirect
+        size_t notInstanced = 0;    // instanced packets whose program lacks the attribute
+        double sortMs = 0.0;        // merging and sorting the lists
+        double submitMs = 0.0;      // CPU time in submit(), sort included
+    };
+
+    // glMultiDrawElementsIndirect with a base instance (GL 4.3, or the ARB
+    // extensions on a 3.3 context)
+    bool multiDrawIndirectSupported();
+
+    // Packets recorded by one thread, with the per-draw uniform block for each
+    class CommandList {
+    public:
+        void draw(const DrawPacket& packet, const ObjectBlock& object) {
+            packets.push_back(packet);
+            objects.push_back(object);
+        }
+
+        size_t size() const { return packets.size(); }
+
+    private:
+        friend class RenderQueue;
+
+        std::vector<DrawPacket> packets;
+        std::vector<ObjectBlock> objects;
+    };
+
+    // Draws for one frame. Systems record packets into their own command lists
+    // in parallel; submit() merges the lists, radix-sorts them by key and
+    // replays them on the GL thread through the state cache, so consecutive
+    // packets that share a program, material or VAO don't rebind it. Instanced
+    // packets are collapsed into indirect multi-draws; without driver support
+    // they fall back to one draw each.
+    //
+    // Packets with equal keys keep their recording order, and lists are merged
+    // in a fixed order, so the replay order does not depend on thread timing.
+    class RenderQueue {
+    public:
+        // Drop last frame's packets; list storage is kept
+        void beginFrame();
+
+        // Record count items across worker threads. Each call of body gets a
+        // command list of its own and a contiguous [begin, end) range.
+        void record(size_t count, const std::function<void(CommandList& list, size_t begin, size_t end)>& body,
+                    size_t minChunk = 1);
+
+        // Sort and draw everything recorded since beginFrame(), uploading each
+        // packet's ObjectBlock into objectUniforms. GL thread only; returns the
+        // number of draws issued.
+        size_t submit(UniformBuffer<ObjectBlock>& objectUniforms);
+
+        // Packets recorded this frame
+        size_t size() const;
+
+        // Use glMultiDrawElementsIndirect where supported (the default)
+        void setMultiDraw(bool enabled) { multiDrawEnabled = enabled; }
+
+        // Counters for the last submit()
+        const RenderQueueStats& stats() const { return lastStats; }
+
+        // Delete the instance and indirect buffers; call while the context is current
+        void destroy();
+
+    private:
+        struct SortItem {
+            uint64_t key;
+            uint32_t list;
+            uint32_t packet;
+        };
+
+        std::vector<CommandList> lists;
+        size_t usedLists = 0;
+        std::vector<SortItem> items;
+        std::vector<SortItem> scratch;
+        // Layout fixed by GL for GL_DRAW_INDIRECT_BUFFER
+        struct IndirectCommand {
+            uint32_t count;
+            uint32_t instanceCount;
+            uint32_t firstIndex;
+            int32_t baseVertex;
+            uint32_t baseInstance;
+        };
+
+        void drawInstanced(size_t first, size_t count, unsigned int mode, bool multiDraw);
+        bool readsInstanceModel(unsigned int program);
+
+        // Programs checked this submit (ids are reused after hot reload), and
+        // those already reported as lacking the attribute
+        std::vector<std::pair<unsigned int, bool>> instanceModelPrograms;
+        std::vector<unsigned int> reportedPrograms;
+
+        std::vector<glm::mat4> instanceModels;      // one per instanced packet, in draw order
+        std::vector<IndirectCommand> indirectCommands;
+        unsigned int instanceBuffer = 0;
+        unsigned int indirectBuffer = 0;
+        bool multiDrawEnabled = true;
+        RenderQueueStats lastStats;
+    };
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "ecs.hpp"
+
+#include <glm/glm.hpp>
+
+namespace Common {
+    // Scene components: position and uniform scale, turned spinAngle radians
+    // about spinAxis
+    struct Transform {
+        glm::vec3 position = glm::vec3(0.0f);
+        float scale = 1.0f;
+        glm::vec3 spinAxis = glm::vec3(0.0f, 1.0f, 0.0f);
+        float spinAngle = 0.0f;
+    };
+
+    // Turning at speed radians per second while enabled, at rest otherwise
+    struct Spin {
+        float speed = 0.0f;
+        bool enabled = true;
+    };
+
+    // Model matrix built from Transform, read by the renderer
+    struct WorldMatrix {
+        glm::mat4 model = glm::mat4(1.0f);
+    };
+
+    // Point light at its Transform's position
+    struct Light {
+        glm::vec3 color = glm::vec3(1.0f);
+        float intensity = 1.0f;
+    };
+
+    // The model matrix updateWorldMatrices() builds: translate, spin, scale
+    glm::mat4 worldMatrix(const Transform& transform);
+
+    // t of the way from a to b, for drawing between two simulation steps. A
+    // spin that jumps by more than half a turn (switched on or off) snaps to
+    // b rather than sweeping round.
+    Transform interpolate(const Transform& a, const Transform& b, float t);
+
+    // Systems. Each walks the matching chunks; the parallel ones split them
+    // across worker threads (threads = 0 uses every worker).
+    void updateSpin(World& world, float time);
+    void updateWorldMatrices(World& world, unsigned int threads = 0);
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "program_cache.hpp"
+#include "uniforms.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Common {
+    // Read a GLSL file and splice in every #include "file" line, resolved
+    // relative to the including file. Each file is included at most once, so
+    // shared snippets need no guards and cycles terminate. #line directives keep
+    // compiler messages pointing at the original line; the second number is
+    // the file's position in `files` (0 is the top-level file).
+    bool loadShaderSource(const std::string& path, std::string& source,
+                          std::vector<std::string>* files = nullptr);
+
+    // Insert "#define NAME 1" after the #version line for every bit set in
+    // features, where bit i is names[i]
+    std::string injectDefines(const std::string& source, uint32_t features,
+                              const std::vector<std::string>& names);
+
+    // Compile-time variants of one vertex + fragment shader pair.
+    //
+    // Each optional feature is a bit; a variant's bitmask becomes a #define
+    // header, so disabled features cost nothing at run time instead of a
+    // uniform branch. Variants are cached by bitmask. warmUp() links the
+    // variants a scene can reach in one batch at startup (through the program
+    // cache when given one); anything requested later compiles on the spot
+    // and is counted in lateCompiles() so hitches show up.
+    //
+    // submit() is the non-blocking form: compiles run on the driver's threads
+    // (KHR_parallel_shader_compile) and update() picks up finished ones each
+    // frame, while bestReady() stands in with a variant that has fewer
+    // features. A variant only becomes visible once it is fully set up
+    // (reflected, blocks bound, link callback run), so the swap is atomic
+    // from the renderer's point of view.
+    //
+    // reload() re-reads the sources for hot reloading and rebuilds every
+    // variant the same way: the old program keeps drawing until update()
+    // swaps the new one in, and a variant whose new source fails to compile
+    // keeps its old program.
+    class ShaderPermutations {
+    public:
+        struct Variant {
+            unsigned int program = 0;
+            uint32_t features = 0;      // the bitmask it was built from
+            UniformTable uniforms;
+        };
+
+        // Called once per newly linked variant, with the program bound, to set
+        // uniforms that never change (sampler units, constants)
+        using LinkCallback = std::function<void(const Variant& variant)>;
+
+        ShaderPermutations(std::string vertexPath, std::string fragmentPath,
+                           std::vector<std::string> featureNames, ProgramCache* cache = nullptr);
+        ~ShaderPermutations();
+
+        ShaderPermutations(const ShaderPermutations&) = delete;
+        ShaderPermutations& operator=(const ShaderPermutations&) = delete;
+
+        // Read both stages and resolve includes; false if either is missing
+        bool load();
+
+        // Re-read the sources and rebuild every known variant in the
+        // background. False (and nothing changes) if the sources can't be read.
+        bool reload();
+
+        // Every file load() read, including #included ones, for watching
+        const std::vector<std::string>& files() const { return sourceFiles; }
+
+        void setLinkCallback(LinkCallback callback);
+
+        // Delete every variant's program; call while the context is still current
+        void clear();
+
+        // Link every listed variant that is not cached yet; false if any failed
+        bool warmUp(const std::vector<uint32_t>& variants);
+
+        // Cached variant, compiled now on a miss (program 0 if that failed)
+        const Variant& variant(uint32_t features);
+
+        // Start linking the listed variants without waiting for them
+        void submit(const std::vector<uint32_t>& variants);
+
+        // Once per frame, on the GL thread: finish submitted variants whose
+        // compile has completed. Without the extension a status query blocks,
+        // so at most one variant is finished per call. Returns the number
+        // still pending.
+        size_t update();
+
+        // The variant if it is linked, otherwise the linked variant with the
+        // most features that are a subset of the requested ones. Falls back to
+        // variant() when nothing suitable is ready.
+        const Variant& bestReady(uint32_t features);
+
+        size_t size() const { return variants.size(); }
+        size_t pending() const { return pendingVariants.size(); }
+        size_t lateCompiles() const { return lateCompileCount; }
+
+    private:
+        struct PendingVariant {
+            uint32_t features = 0;
+            ProgramSource source;
+            PendingProgram program;
+        };
+
+        ProgramSource sourceFor(uint32_t features) const;
+        bool known(uint32_t features) const;
+        void submitVariants(const std::vector<uint32_t>& requested, bool rebuild);
+        unsigned int finishPending(PendingVariant& pending);
+        void finishVariant(uint32_t features, unsigned int program);
+
+        std::string vertexPath;
+        std::string fragmentPath;
+        std::vector<std::string> featureNames;
+        ProgramCache* cache;
+        ProgramSource expanded;     // both stages with includes resolved, no defines
+        std::vector<std::string> sourceFiles;
+        std::map<uint32_t, Variant> variants;
+        std::vector<PendingVariant> pendingVariants;
+        LinkCallback onLink;
+        size_t lateCompileCount = 0;
+    };
+}
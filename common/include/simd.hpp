@@ -0,0 +1,234 @@
+#pragma once
+
+// Minimal 4-wide float SIMD wrapper used by the CPU-side bake, culling and
+// simulation code.
+// Backed by SSE2 on x86-64, NEON on arm64 and plain scalar code elsewhere.
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define COMMON_SIMD_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define COMMON_SIMD_NEON 1
+#endif
+
+namespace Common {
+namespace simd {
+
+#if defined(COMMON_SIMD_SSE2)
+
+    struct float4 {
+        __m128 v;
+        float4() = default;
+        float4(__m128 x) : v(x) {}
+        explicit float4(float s) : v(_mm_set1_ps(s)) {}
+        float4(float a, float b, float c, float d) : v(_mm_setr_ps(a, b, c, d)) {}
+
+        static float4 load(const float* p) { return _mm_loadu_ps(p); }
+        void store(float* p) const { _mm_storeu_ps(p, v); }
+        static float4 fromBytes(const uint8_t* p) {
+            int32_t packed;
+            std::memcpy(&packed, p, 4);
+            __m128i b = _mm_cvtsi32_si128(packed);
+            __m128i zero = _mm_setzero_si128();
+            b = _mm_unpacklo_epi16(_mm_unpacklo_epi8(b, zero), zero);
+            return _mm_cvtepi32_ps(b);
+        }
+        void storeBytes(uint8_t* p) const {
+            __m128i i = _mm_cvtps_epi32(v);
+            i = _mm_packs_epi32(i, i);
+            i = _mm_packus_epi16(i, i);
+            int32_t packed = _mm_cvtsi128_si32(i);
+            std::memcpy(p, &packed, 4);
+        }
+    };
+
+    inline float4 operator+(float4 a, float4 b) { return _mm_add_ps(a.v, b.v); }
+    inline float4 operator-(float4 a, float4 b) { return _mm_sub_ps(a.v, b.v); }
+    inline float4 operator*(float4 a, float4 b) { return _mm_mul_ps(a.v, b.v); }
+    inline float4 operator/(float4 a, float4 b) { return _mm_div_ps(a.v, b.v); }
+    inline float4 operator&(float4 a, float4 b) { return _mm_and_ps(a.v, b.v); }
+    inline float4 operator|(float4 a, float4 b) { return _mm_or_ps(a.v, b.v); }
+    inline float4 operator^(float4 a, float4 b) { return _mm_xor_ps(a.v, b.v); }
+    inline float4 operator<(float4 a, float4 b) { return _mm_cmplt_ps(a.v, b.v); }
+    inline float4 operator>(float4 a, float4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+    inline float4 min(float4 a, float4 b) { return _mm_min_ps(a.v, b.v); }
+    inline float4 max(float4 a, float4 b) { return _mm_max_ps(a.v, b.v); }
+    inline float4 sqrt(float4 a) { return _mm_sqrt_ps(a.v); }
+    inline float4 abs(float4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+    inline float4 signBit(float4 a) { return _mm_and_ps(_mm_set1_ps(-0.0f), a.v); }
+    inline float4 floor(float4 a) {
+        // Round-to-nearest then correct downwards; valid for |a| < 2^31
+        float4 r = _mm_cvtepi32_ps(_mm_cvtps_epi32(a.v));
+        return r - (_mm_and_ps(_mm_cmpgt_ps(r.v, a.v), _mm_set1_ps(1.0f)));
+    }
+    // Per-lane mask ? a : b
+    inline float4 select(float4 mask, float4 a, float4 b) {
+        return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+    }
+    inline int moveMask(float4 mask) { return _mm_movemask_ps(mask.v); }
+
+#elif defined(COMMON_SIMD_NEON)
+
+    struct float4 {
+        float32x4_t v;
+        float4() = default;
+        float4(float32x4_t x) : v(x) {}
+        explicit float4(float s) : v(vdupq_n_f32(s)) {}
+        float4(float a, float b, float c, float d) {
+            const float tmp[4] = { a, b, c, d };
+            v = vld1q_f32(tmp);
+        }
+
+        static float4 load(const float* p) { return vld1q_f32(p); }
+        void store(float* p) const { vst1q_f32(p, v); }
+        static float4 fromBytes(const uint8_t* p) {
+            uint32_t packed;
+            std::memcpy(&packed, p, 4);
+            uint8x8_t b = vreinterpret_u8_u32(vdup_n_u32(packed));
+            uint32x4_t w = vmovl_u16(vget_low_u16(vmovl_u8(b)));
+            return vcvtq_f32_u32(w);
+        }
+        void storeBytes(uint8_t* p) const {
+            uint32x4_t w = vcvtnq_u32_f32(vmaxq_f32(v, vdupq_n_f32(0.0f)));
+            uint16x4_t h = vqmovn_u32(w);
+            uint8x8_t b = vqmovn_u16(vcombine_u16(h, h));
+            uint32_t packed = vget_lane_u32(vreinterpret_u32_u8(b), 0);
+            std::memcpy(p, &packed, 4);
+        }
+    };
+
+    inline float4 operator+(float4 a, float4 b) { return vaddq_f32(a.v, b.v); }
+    inline float4 operator-(float4 a, float4 b) { return vsubq_f32(a.v, b.v); }
+    inline float4 operator*(float4 a, float4 b) { return vmulq_f32(a.v, b.v); }
+    inline float4 operator/(float4 a, float4 b) { return vdivq_f32(a.v, b.v); }
+    inline float4 operator&(float4 a, float4 b) {
+        return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v)));
+    }
+    inline float4 operator|(float4 a, float4 b) {
+        return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v)));
+    }
+    inline float4 operator^(float4 a, float4 b) {
+        return vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v)));
+    }
+    inline float4 operator<(float4 a, float4 b) { return vreinterpretq_f32_u32(vcltq_f32(a.v, b.v)); }
+    inline float4 operator>(float4 a, float4 b) { return vreinterpretq_f32_u32(vcgtq_f32(a.v, b.v)); }
+    inline float4 min(float4 a, float4 b) { return vminq_f32(a.v, b.v); }
+    inline float4 max(float4 a, float4 b) { return vmaxq_f32(a.v, b.v); }
+    inline float4 sqrt(float4 a) { return vsqrtq_f32(a.v); }
+    inline float4 abs(float4 a) { return vabsq_f32(a.v); }
+    inline float4 signBit(float4 a) { return a & float4(-0.0f); }
+    inline float4 floor(float4 a) { return vrndmq_f32(a.v); }
+    inline float4 select(float4 mask, float4 a, float4 b) {
+        return vbslq_f32(vreinterpretq_u32_f32(mask.v), a.v, b.v);
+    }
+    inline int moveMask(float4 mask) {
+        uint32x4_t m = vshrq_n_u32(vreinterpretq_u32_f32(mask.v), 31);
+        return (int)(vgetq_lane_u32(m, 0) | (vgetq_lane_u32(m, 1) << 1) |
+                     (vgetq_lane_u32(m, 2) << 2) | (vgetq_lane_u32(m, 3) << 3));
+    }
+
+#else
+
+    struct float4 {
+        float v[4];
+        float4() = default;
+        explicit float4(float s) : v{ s, s, s, s } {}
+        float4(float a, float b, float c, float d) : v{ a, b, c, d } {}
+
+        static float4 load(const float* p) { return float4(p[0], p[1], p[2], p[3]); }
+        void store(float* p) const { std::memcpy(p, v, sizeof(v)); }
+        static float4 fromBytes(const uint8_t* p) { return float4(p[0], p[1], p[2], p[3]); }
+        void storeBytes(uint8_t* p) const {
+            for (int i = 0; i < 4; ++i) {
+                float c = v[i] < 0.0f ? 0.0f : (v[i] > 255.0f ? 255.0f : v[i]);
+                p[i] = (uint8_t)std::lround(c);
+            }
+        }
+    };
+
+    namespace detail {
+        template <typename F>
+        inline float4 map(float4 a, float4 b, F f) {
+            return float4(f(a.v[0], b.v[0]), f(a.v[1], b.v[1]), f(a.v[2], b.v[2]), f(a.v[3], b.v[3]));
+        }
+        inline float bits(uint32_t u) { float f; std::memcpy(&f, &u, 4); return f; }
+        inline uint32_t bits(float f) { uint32_t u; std::memcpy(&u, &f, 4); return u; }
+        inline float mask(bool b) { return bits(b ? 0xFFFFFFFFu : 0u); }
+    }
+
+    inline float4 operator+(float4 a, float4 b) { return detail::map(a, b, [](float x, float y) { return x + y; }); }
+    inline float4 operator-(float4 a, float4 b) { return detail::map(a, b, [](float x, float y) { return x - y; }); }
+    inline float4 operator*(float4 a, float4 b) { return detail::map(a, b, [](float x, float y) { return x * y; }); }
+    inline float4 operator/(float4 a, float4 b) { return detail::map(a, b, [](float x, float y) { return x / y; }); }
+    inline float4 operator&(float4 a, float4 b) { return detail::map(a, b, [](float x, float y) { return detail::bits(detail::bits(x) & detail::bits(y)); }); }
+    inline float4 operator|(float4 a, float4 b) { return detail::map(a, b, [](float x, float y) { return detail::bits(detail::bits(x) | detail::bits(y)); }); }
+    inline float4 operator^(float4 a, float4 b) { return detail::map(a, b, [](float x, float y) { return detail::bits(detail::bits(x) ^ detail::bits(y)); }); }
+    inline float4 operator<(float4 a, float4 b) { return detail::map(a, b, [](float x, float y) { return detail::mask(x < y); }); }
+    inline float4 operator>(float4 a, float4 b) { return detail::map(a, b, [](float x, float y) { return detail::mask(x > y); }); }
+    inline float4 min(float4 a, float4 b) { return detail::map(a, b, [](float x, float y) { return x < y ? x : y; }); }
+    inline float4 max(float4 a, float4 b) { return detail::map(a, b, [](float x, float y) { return x > y ? x : y; }); }
+    inline float4 sqrt(float4 a) { return detail::map(a, a, [](float x, float) { return std::sqrt(x); }); }
+    inline float4 abs(float4 a) { return detail::map(a, a, [](float x, float) { return std::fabs(x); }); }
+    inline float4 signBit(float4 a) { return a & float4(-0.0f); }
+    inline float4 floor(float4 a) { return detail::map(a, a, [](float x, float) { return std::floor(x); }); }
+    inline float4 select(float4 mask, float4 a, float4 b) { return (mask & a) | detail::map(mask, b, [](float m, float y) { return detail::bits(~detail::bits(m) & detail::bits(y)); }); }
+    inline int moveMask(float4 mask) {
+        int m = 0;
+        for (int i = 0; i < 4; ++i)
+            m |= (int)(detail::bits(mask.v[i]) >> 31) << i;
+        return m;
+    }
+
+#endif
+
+    // Shared helpers built on top of the backend primitives
+
+    inline float4 madd(float4 a, float4 b, float4 c) { return a * b + c; }
+
+    // atan2 with ~1e-5 rad max error (minimax polynomial on [0, 1] plus octant fix-up)
+    inline float4 atan2(float4 y, float4 x) {
+        const float4 ax = abs(x), ay = abs(y);
+        const float4 hi = max(ax, ay), lo = min(ax, ay);
+        const float4 a = lo / max(hi, float4(1e-30f));
+        const float4 s = a * a;
+        float4 r = float4(-0.01172120f);
+        r = madd(r, s, float4(0.05265332f));
+        r = madd(r, s, float4(-0.11643287f));
+        r = madd(r, s, float4(0.19354346f));
+        r = madd(r, s, float4(-0.33262347f));
+        r = madd(r, s, float4(0.99997726f));
+        r = r * a;
+        r = select(ay > ax, float4(1.57079637f) - r, r);
+        r = select(x < float4(0.0f), float4(3.14159274f) - r, r);
+        return r ^ signBit(y);
+    }
+
+    // sin with ~4e-6 max error for |x| up to a few thousand radians (range
+    // reduction to [-pi, pi], fold to [-pi/2, pi/2], degree-9 Taylor polynomial)
+    inline float4 sin(float4 x) {
+        const float4 pi(3.14159265f), halfPi(1.57079633f);
+        x = x - floor(madd(x, float4(0.159154943f), float4(0.5f))) * float4(6.28318531f);
+        x = select(x > halfPi, pi - x, x);
+        x = select(x < float4(0.0f) - halfPi, float4(0.0f) - pi - x, x);
+        const float4 s = x * x;
+        float4 r = float4(2.75573192e-6f);
+        r = madd(r, s, float4(-1.98412698e-4f));
+        r = madd(r, s, float4(8.33333333e-3f));
+        r = madd(r, s, float4(-1.66666667e-1f));
+        r = madd(r, s, float4(1.0f));
+        return r * x;
+    }
+
+    inline float horizontalSum(float4 a) {
+        float tmp[4];
+        a.store(tmp);
+        return (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+    }
+
+} // namespace simd
+} // namespace Common
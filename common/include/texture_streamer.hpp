@@ -0,0 +1,130 @@
+#pragma once
+
+#include "cooked_texture.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Common {
+    // Residency counters, refreshed by TextureStreamer::update()
+    struct TextureResidencyStats {
+        size_t residentBytes = 0;       // all faces and resident mips
+        size_t budgetBytes = 0;
+        size_t evictionsThisFrame = 0;  // mip levels dropped during the last update
+        size_t totalEvictions = 0;
+        size_t reloads = 0;             // evicted textures streamed back to their target
+        double lastReloadMs = 0.0;      // time from re-request to target resident
+        double averageReloadMs = 0.0;
+    };
+
+    // Progressive loader and residency manager for cooked (.ctex) textures.
+    //
+    // load() uploads only the mip tail (levels no larger than tailSize) and returns
+    // a usable texture straight away. A background thread (started by the first
+    // load(), so constructing a streamer before main() starts nothing) then
+    // reads finer levels from disk one at a time, and update() uploads whatever
+    // has arrived, lowering GL_TEXTURE_BASE_LEVEL so the GPU never samples a
+    // level that is not resident.
+    // Textures covering more of the screen stream first; among equals, cheaper
+    // levels go first so every texture sharpens at a similar rate.
+    //
+    // Every texture has a target level that its resident chain streams towards,
+    // and the targets together never exceed the byte budget. When a visible
+    // texture wants a finer level that does not fit, textures that were not
+    // visible this frame give up their finest mips, least recently used first.
+    // If the budget shrinks below what is resident, mips are dropped from
+    // whatever is cheapest to lose. The mip tail always stays resident.
+    //
+    // All GL calls happen in load(), update() and unload(), which must run on the
+    // GL thread.
+    class TextureStreamer {
+    public:
+        explicit TextureStreamer(size_t budgetBytes = 256u << 20, uint32_t tailSize = 64,
+                                 size_t maxPendingBytes = 64u << 20);
+        ~TextureStreamer();
+
+        TextureStreamer(const TextureStreamer&) = delete;
+        TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+        // Create a 2D or cubemap texture with its mip tail resident; 0 on failure
+        unsigned int load(const std::string& path);
+
+        // Delete the GL texture and forget it
+        void unload(unsigned int texture);
+
+        // Fraction of the screen covered by objects using this texture, in [0, 1].
+        // Call every frame; a texture counts as visible this frame if coverage > 0.
+        void setCoverage(unsigned int texture, float coverage);
+
+        void setBudget(size_t budgetBytes);
+
+        // Once per frame: rebalance targets against the budget, then upload levels
+        // that finished loading, up to maxBytes (at least one level). Leaves the
+        // last touched texture bound on the active unit.
+        void update(size_t maxBytes = 8u << 20);
+
+        // True once every texture has reached its target level (or gave up)
+        bool fullyResident() const;
+
+        // Finest resident level of a texture (0 = full resolution), -1 if unknown
+        int residentLevel(unsigned int texture) const;
+
+        size_t residentBytes() const;
+        TextureResidencyStats stats() const;
+
+    private:
+        struct Entry {
+            unsigned int texture = 0;
+            std::string path;
+            uint32_t channels = 4;
+            uint32_t faces = 1;
+            std::vector<size_t> levelBytes;
+            int tailLevel = 0;          // coarsest level that is always resident
+            int targetLevel = 0;        // finest level the budget allows
+            int residentLevel = 0;      // finest level uploaded to GL
+            int requestedLevel = 0;     // finest level read or being read
+            uint32_t generation = 0;    // bumped when queued reads become stale
+            float coverage = 1.0f;
+            uint64_t lastVisibleFrame = 0;
+            bool evicted = false;       // lost levels it will want back
+            double reloadStartMs = -1.0;
+            bool failed = false;        // a level failed to read; streaming stopped
+        };
+
+        struct ReadyLevel {
+            unsigned int texture = 0;
+            uint32_t generation = 0;
+            int level = 0;
+            CookedLevel data;
+        };
+
+        void workerLoop();
+        Entry* find(unsigned int texture);
+        const Entry* find(unsigned int texture) const;
+        size_t chainBytes(const Entry& entry, int level) const;
+        size_t committedBytes() const;
+        void rebalance();
+        void raiseTarget(Entry& entry);
+        void uploadLevel(const Entry& entry, int level, const CookedLevel& data);
+
+        uint32_t tailSize;
+        size_t maxPendingBytes;
+
+        mutable std::mutex mutex;
+        std::condition_variable wake;
+        std::vector<Entry> entries;
+        std::deque<ReadyLevel> ready;
+        size_t pendingBytes = 0;
+        uint64_t frame = 0;
+        TextureResidencyStats counters;
+        double reloadTotalMs = 0.0;
+        bool stopping = false;
+        std::thread worker;
+    };
+}
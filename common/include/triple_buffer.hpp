@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace Common {
+    // Hands whole values from one producer thread to one consumer thread
+    // without either ever waiting. The producer fills back() and publish()es
+    // it; the consumer's acquire() swaps the newest published value into
+    // front(), which stays put until the next acquire(). Values published in
+    // between are skipped, never torn. Slots are reused rather than rebuilt,
+    // so containers inside T keep their capacity from one round to the next.
+    template <typename T>
+    class TripleBuffer {
+    public:
+        // Producer side
+        T& back() { return slots[backIndex]; }
+
+        void publish() {
+            backIndex = middle.exchange(backIndex | FRESH, std::memory_order_acq_rel) & INDEX;
+        }
+
+        // Consumer side: true if a newer value replaced front()
+        bool acquire() {
+            if (!(middle.load(std::memory_order_relaxed) & FRESH))
+                return false;
+            frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX;
+            return true;
+        }
+
+        const T& front() const { return slots[frontIndex]; }
+
+    private:
+        static constexpr uint8_t INDEX = 3;
+        static constexpr uint8_t FRESH = 4;     // middle holds a value the consumer has not taken
+
+        T slots[3];
+        uint8_t backIndex = 0;                  // producer only
+        uint8_t frontIndex = 1;                 // consumer only
+        std::atomic<uint8_t> middle{2};
+    };
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "gl_state.hpp"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+namespace Common {
+    // std140 layout rules evaluated at compile time. A block struct lists its
+    // member types once; static_asserts then compare the std140 offsets with
+    // offsetof() so a struct that drifts from the GLSL layout fails to build.
+    namespace std140 {
+        enum class Type { Float, Int, Vec2, Vec3, Vec4, Mat4 };
+
+        constexpr size_t alignment(Type type) {
+            switch (type) {
+            case Type::Float:
+            case Type::Int: return 4;
+            case Type::Vec2: return 8;
+            default: return 16;
+            }
+        }
+
+        constexpr size_t size(Type type) {
+            switch (type) {
+            case Type::Float:
+            case Type::Int: return 4;
+            case Type::Vec2: return 8;
+            case Type::Vec3: return 12;
+            case Type::Vec4: return 16;
+            default: return 64;
+            }
+        }
+
+        template <size_t N>
+        struct Layout {
+            size_t offsets[N] = {};
+            size_t size = 0;    // rounded up to the block's 16-byte base alignment
+        };
+
+        // Member offsets of a block in declaration order
+        template <size_t N>
+        constexpr Layout<N> layout(const Type (&members)[N]) {
+            Layout<N> result;
+            size_t offset = 0;
+            for (size_t i = 0; i < N; ++i) {
+                const size_t align = alignment(members[i]);
+                offset = (offset + align - 1) / align * align;
+                result.offsets[i] = offset;
+                offset += size(members[i]);
+            }
+            result.size = (offset + 15) / 16 * 16;
+            return result;
+        }
+    }
+
+    // Uniform block binding points shared by every program
+    const unsigned int FRAME_BLOCK_BINDING = 0;
+    const unsigned int OBJECT_BLOCK_BINDING = 1;
+
+    // layout(std140) uniform FrameBlock: camera and lights, written once per frame
+    struct FrameBlock {
+        alignas(16) glm::mat4 view;
+        alignas(16) glm::mat4 projection;
+        alignas(16) glm::mat4 viewProjection;
+        alignas(16) glm::vec3 viewPos;
+        alignas(16) glm::vec3 lightPos;
+        alignas(16) glm::vec3 lightColor;
+        float animationTime;                    // seconds; packs into lightColor's padding
+    };
+
+    // layout(std140) uniform ObjectBlock: per-draw transforms precomputed on the CPU
+    struct ObjectBlock {
+        alignas(16) glm::mat4 model;
+        alignas(16) glm::mat4 modelViewProjection;
+        alignas(16) glm::mat4 normalMatrix;     // inverse-transpose of model; GLSL uses mat3(normalMatrix)
+        alignas(16) glm::vec3 objectViewPos;    // camera position in object space
+    };
+
+    namespace std140 {
+        constexpr Type kFrameBlockMembers[] = { Type::Mat4, Type::Mat4, Type::Mat4, Type::Vec3, Type::Vec3, Type::Vec3, Type::Float };
+        constexpr Layout<7> kFrameBlockLayout = layout(kFrameBlockMembers);
+        static_assert(offsetof(FrameBlock, view) == kFrameBlockLayout.offsets[0], "FrameBlock.view is not std140");
+        static_assert(offsetof(FrameBlock, projection) == kFrameBlockLayout.offsets[1], "FrameBlock.projection is not std140");
+        static_assert(offsetof(FrameBlock, viewProjection) == kFrameBlockLayout.offsets[2], "FrameBlock.viewProjection is not std140");
+        static_assert(offsetof(FrameBlock, viewPos) == kFrameBlockLayout.offsets[3], "FrameBlock.viewPos is not std140");
+        static_assert(offsetof(FrameBlock, lightPos) == kFrameBlockLayout.offsets[4], "FrameBlock.lightPos is not std140");
+        static_assert(offsetof(FrameBlock, lightColor) == kFrameBlockLayout.offsets[5], "FrameBlock.lightColor is not std140");
+        static_assert(offsetof(FrameBlock, animationTime) == kFrameBlockLayout.offsets[6], "FrameBlock.animationTime is not std140");
+        static_assert(sizeof(FrameBlock) == kFrameBlockLayout.size, "FrameBlock size is not std140");
+
+        constexpr Type kObjectBlockMembers[] = { Type::Mat4, Type::Mat4, Type::Mat4, Type::Vec3 };
+        constexpr Layout<4> kObjectBlockLayout = layout(kObjectBlockMembers);
+        static_assert(offsetof(ObjectBlock, model) == kObjectBlockLayout.offsets[0], "ObjectBlock.model is not std140");
+        static_assert(offsetof(ObjectBlock, modelViewProjection) == kObjectBlockLayout.offsets[1], "ObjectBlock.modelViewProjection is not std140");
+        static_assert(offsetof(ObjectBlock, normalMatrix) == kObjectBlockLayout.offsets[2], "ObjectBlock.normalMatrix is not std140");
+        static_assert(offsetof(ObjectBlock, objectViewPos) == kObjectBlockLayout.offsets[3], "ObjectBlock.objectViewPos is not std140");
+        static_assert(sizeof(ObjectBlock) == kObjectBlockLayout.size, "ObjectBlock size is not std140");
+    }
+
+    // Point a program's FrameBlock / ObjectBlock at the shared binding points and
+    // check the driver's block sizes against the C++ structs. Blocks the program
+    // does not use are skipped; returns false on a size mismatch.
+    bool bindUniformBlocks(unsigned int program);
+
+    // One uniform buffer holding a single T, attached to a fixed binding point
+    template <typename T>
+    class UniformBuffer {
+    public:
+        void create(unsigned int binding) {
+            glGenBuffers(1, &buffer);
+            glState().bindBuffer(GL_UNIFORM_BUFFER, buffer);
+            glBufferData(GL_UNIFORM_BUFFER, sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+            glState().bindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+        }
+
+        void upload(const T& data) {
+            glState().bindBuffer(GL_UNIFORM_BUFFER, buffer);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+        }
+
+        void destroy() {
+            glDeleteBuffers(1, &buffer);
+            glState().bufferDeleted(buffer);
+            buffer = 0;
+        }
+
+    private:
+        unsigned int buffer = 0;
+    };
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace Common {
+    // 32-bit FNV-1a; constexpr so uniform names can be hashed at compile time
+    constexpr uint32_t fnv1a(std::string_view text) {
+        uint32_t hash = 2166136261u;
+        for (char c : text) {
+            hash ^= (uint8_t)c;
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    // Uniform name hashed at compile time when declared constexpr:
+    //   constexpr Common::UniformId U_VIEW("view");
+    struct UniformId {
+        uint32_t hash;
+        constexpr explicit UniformId(std::string_view name) : hash(fnv1a(name)) {}
+    };
+
+    // Active uniform locations of one program, reflected once after linking with
+    // glGetActiveUniform. Lookups are a binary search over a small sorted array,
+    // so setting a uniform needs no string handling and no driver query.
+    // Arrays are registered under their base name ("ambientSH", not "ambientSH[0]").
+    class UniformTable {
+    public:
+        // Rebuild the table for a linked program; reports hash collisions
+        void reflect(unsigned int program);
+
+        // Location of an active uniform, -1 if the program does not use it
+        int location(UniformId id) const;
+
+        size_t size() const { return slots.size(); }
+
+    private:
+        struct Slot {
+            uint32_t hash;
+            int location;
+        };
+        std::vector<Slot> slots;    // sorted by hash
+    };
+}
@@ -0,0 +1,461 @@
+#include "bvh.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <utility>
+
+namespace Common {
+
+namespace {
+
+// Centroid bins per axis for the SAH split
+const int SAH_BINS = 16;
+
+// Nodes per refit range at the least; the leaf boxes are the work
+const size_t MIN_NODES_PER_RANGE = 256;
+
+Aabb emptyBox() {
+    return { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+}
+
+void grow(Aabb& box, const Aabb& other) {
+    box.min = glm::min(box.min, other.min);
+    box.max = glm::max(box.max, other.max);
+}
+
+void grow(Aabb& box, const glm::vec3& point) {
+    box.min = glm::min(box.min, point);
+    box.max = glm::max(box.max, point);
+}
+
+// Half the surface area, 0 for an empty box
+float halfArea(const Aabb& box) {
+    const glm::vec3 d = glm::max(box.max - box.min, glm::vec3(0.0f));
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+// What the build moves around: a primitive's box and centroid side by side,
+// so splits stream through memory rather than gathering by index
+struct BuildPrimitive {
+    Aabb box;
+    glm::vec3 centroid;
+    uint32_t index;
+};
+
+struct Builder {
+    std::vector<BuildPrimitive> primitives;
+    std::vector<Bvh::Node>& nodes;
+
+    // Split primitives [begin, end) in two by the binned SAH, binning all
+    // three axes in one pass, falling back to the median of the widest axis
+    // when every centroid lands in one bin. Returns where the second half starts.
+    size_t split(size_t begin, size_t end) {
+        Aabb centroidBox = emptyBox();
+        for (size_t i = begin; i < end; ++i)
+            grow(centroidBox, primitives[i].centroid);
+        const glm::vec3 extent = centroidBox.max - centroidBox.min;
+        glm::vec3 scale(0.0f);
+        for (int axis = 0; axis < 3; ++axis)
+            scale[axis] = extent[axis] > 0.0f ? SAH_BINS / extent[axis] : 0.0f;
+        auto binOf = [&](const glm::vec3& centroid, int axis) {
+            return std::min(SAH_BINS - 1, (int)((centroid[axis] - centroidBox.min[axis]) * scale[axis]));
+        };
+
+        Aabb binBox[3][SAH_BINS];
+        size_t binCount[3][SAH_BINS] = {};
+        for (int axis = 0; axis < 3; ++axis) {
+            for (Aabb& box : binBox[axis])
+                box = emptyBox();
+        }
+        for (size_t i = begin; i < end; ++i) {
+            const BuildPrimitive& primitive = primitives[i];
+            for (int axis = 0; axis < 3; ++axis) {
+                const int bin = binOf(primitive.centroid, axis);
+                grow(binBox[axis][bin], primitive.box);
+                binCount[axis][bin]++;
+            }
+        }
+
+        // Cost of each split plane: area times count on either side
+        float bestCost = FLT_MAX;
+        int bestAxis = -1, bestBin = 0;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (extent[axis] <= 0.0f)
+                continue;
+            float rightCost[SAH_BINS] = {};
+            Aabb right = emptyBox();
+            size_t rightCount = 0;
+            for (int bin = SAH_BINS - 1; bin > 0; --bin) {
+                grow(right, binBox[axis][bin]);
+                rightCount += binCount[axis][bin];
+                rightCost[bin] = halfArea(right) * rightCount;
+            }
+            Aabb left = emptyBox();
+            size_t leftCount = 0;
+            for (int bin = 1; bin < SAH_BINS; ++bin) {
+                grow(left, binBox[axis][bin - 1]);
+                leftCount += binCount[axis][bin - 1];
+                const float cost = halfArea(left) * leftCount + rightCost[bin];
+                if (leftCount > 0 && leftCount < end - begin && cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = bin;
+                }
+            }
+        }
+
+        const auto first = primitives.begin() + begin, last = primitives.begin() + end;
+        if (bestAxis < 0) {
+            const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+            const size_t middle = (begin + end) / 2;
+            std::nth_element(first, primitives.begin() + middle, last,
+                             [axis](const BuildPrimitive& a, const BuildPrimitive& b) {
+                                 return a.centroid[axis] < b.centroid[axis];
+                             });
+            return middle;
+        }
+        auto middle = std::partition(first, last, [&](const BuildPrimitive& primitive) {
+            return binOf(primitive.centroid, bestAxis) < bestBin;
+        });
+        return (size_t)(middle - primitives.begin());
+    }
+
+    // Split [begin, end) into up to WIDTH ranges, the largest first, and
+    // give each a leaf or a node of its own. Returns the node's index.
+    int32_t buildNode(size_t begin, size_t end) {
+        std::pair<size_t, size_t> ranges[Bvh::WIDTH] = { { begin, end } };
+        unsigned int rangeCount = 1;
+        while (rangeCount < Bvh::WIDTH) {
+            unsigned int largest = 0;
+            for (unsigned int i = 1; i < rangeCount; ++i) {
+                if (ranges[i].second - ranges[i].first > ranges[largest].second - ranges[largest].first)
+                    largest = i;
+            }
+            const std::pair<size_t, size_t> range = ranges[largest];
+            if (range.second - range.first <= Bvh::MAX_LEAF_SIZE)
+                break;
+            const size_t middle = split(range.first, range.second);
+            ranges[largest] = { range.first, middle };
+            ranges[rangeCount++] = { middle, range.second };
+        }
+
+        // Children are built after their parent's slot is taken, so they sit
+        // after it. nodes may grow meanwhile, so slots are written by index.
+        const int32_t index = (int32_t)nodes.size();
+        nodes.emplace_back();
+        for (unsigned int slot = 0; slot < Bvh::WIDTH; ++slot) {
+            int32_t child = -1;
+            uint32_t count = 0;
+            if (slot < rangeCount) {
+                const size_t first = ranges[slot].first, size = ranges[slot].second - first;
+                if (size <= Bvh::MAX_LEAF_SIZE) {
+                    child = ~(int32_t)first;
+                    count = (uint32_t)size;
+                } else {
+                    child = buildNode(first, ranges[slot].second);
+                }
+            }
+            nodes[index].child[slot] = child;
+            nodes[index].count[slot] = count;
+        }
+        return index;
+    }
+};
+
+void setSlot(Bvh::Node& node, unsigned int slot, const Aabb& box) {
+    node.minX[slot] = box.min.x;
+    node.minY[slot] = box.min.y;
+    node.minZ[slot] = box.min.z;
+    node.maxX[slot] = box.max.x;
+    node.maxY[slot] = box.max.y;
+    node.maxZ[slot] = box.max.z;
+}
+
+Aabb nodeBox(const Bvh::Node& node) {
+    Aabb box = emptyBox();
+    for (unsigned int slot = 0; slot < Bvh::WIDTH; ++slot) {
+        grow(box, Aabb{ glm::vec3(node.minX[slot], node.minY[slot], node.minZ[slot]),
+                        glm::vec3(node.maxX[slot], node.maxY[slot], node.maxZ[slot]) });
+    }
+    return box;
+}
+
+bool slotUsed(const Bvh::Node& node, unsigned int slot) {
+    return node.child[slot] >= 0 || node.count[slot] > 0;
+}
+
+// Signed distance of the box corner furthest along (nearest) the plane's normal
+float farDistance(const glm::vec4& plane, const Aabb& box) {
+    return plane.x * (plane.x >= 0.0f ? box.max.x : box.min.x) +
+           plane.y * (plane.y >= 0.0f ? box.max.y : box.min.y) +
+           plane.z * (plane.z >= 0.0f ? box.max.z : box.min.z) + plane.w;
+}
+
+bool outsideFrustum(const Frustum& frustum, const Aabb& box) {
+    for (const glm::vec4& plane : frustum.planes) {
+        if (farDistance(plane, box) < 0.0f)
+            return true;
+    }
+    return false;
+}
+
+bool overlaps(const Aabb& a, const Aabb& b) {
+    return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y && a.max.y >= b.min.y &&
+           a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+// Where a ray enters and leaves a box, the entry clamped to the origin
+void raySlabs(const Aabb& box, const glm::vec3& origin, const glm::vec3& inverse, float& enter, float& leave) {
+    const glm::vec3 t0 = (box.min - origin) * inverse, t1 = (box.max - origin) * inverse;
+    const glm::vec3 entries = glm::min(t0, t1), exits = glm::max(t0, t1);
+    enter = std::max(std::max(entries.x, entries.y), std::max(entries.z, 0.0f));
+    leave = std::min(exits.x, std::min(exits.y, exits.z));
+}
+
+} // namespace
+
+void Bvh::buildTree(const Aabb* bounds, size_t count, Tree& tree, unsigned int threads) {
+    tree.nodes.clear();
+    tree.primitives.resize(count);
+    tree.leafBounds.resize(count);
+    if (count > 0) {
+        Builder builder{ std::vector<BuildPrimitive>(count), tree.nodes };
+        for (size_t i = 0; i < count; ++i)
+            builder.primitives[i] = { bounds[i], (bounds[i].min + bounds[i].max) * 0.5f, (uint32_t)i };
+        builder.buildNode(0, count);
+        for (size_t i = 0; i < count; ++i)
+            tree.primitives[i] = builder.primitives[i].index;
+    }
+
+    // The build only places the primitives; the boxes come from a refit
+    refitTree(tree, bounds, threads);
+    tree.builtCost = tree.cost;
+}
+
+void Bvh::refitTree(Tree& tree, const Aabb* bounds, unsigned int threads) {
+    std::vector<Node>& nodes = tree.nodes;
+    if (nodes.empty()) {
+        tree.cost = 0.0f;
+        return;
+    }
+
+    // Leaf slots first, in parallel: they read every primitive's box, and
+    // copy it into leaf order so queries find the boxes side by side
+    const size_t ranges = threads ? threads : workerCount();
+    parallelFor(nodes.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            Node& node = nodes[i];
+            for (unsigned int slot = 0; slot < WIDTH; ++slot) {
+                if (node.child[slot] >= 0)
+                    continue;
+                Aabb box = emptyBox();
+                const size_t first = (size_t)~node.child[slot];
+                for (size_t k = first; k < first + node.count[slot]; ++k) {
+                    tree.leafBounds[k] = bounds[tree.primitives[k]];
+                    grow(box, tree.leafBounds[k]);
+                }
+                setSlot(node, slot, box);
+            }
+        }
+    }, std::max(MIN_NODES_PER_RANGE, (nodes.size() + ranges - 1) / ranges));
+
+    // Then inner slots from the back, children before parents, summing the
+    // SAH cost: one per node visited and one per primitive tested, each
+    // weighted by the chance a ray through the root hits its box
+    float cost = 0.0f;
+    for (size_t i = nodes.size(); i-- > 0;) {
+        Node& node = nodes[i];
+        for (unsigned int slot = 0; slot < WIDTH; ++slot) {
+            if (node.child[slot] >= 0) {
+                const Aabb box = nodeBox(nodes[node.child[slot]]);
+                setSlot(node, slot, box);
+                cost += halfArea(box);
+            } else if (node.count[slot] > 0) {
+                cost += halfArea(Aabb{ glm::vec3(node.minX[slot], node.minY[slot], node.minZ[slot]),
+                                       glm::vec3(node.maxX[slot], node.maxY[slot], node.maxZ[slot]) }) *
+                        node.count[slot];
+            }
+        }
+    }
+    const float rootArea = halfArea(nodeBox(nodes[0]));
+    tree.cost = rootArea > 0.0f ? 1.0f + cost / rootArea : 1.0f;
+}
+
+void Bvh::build(const Aabb* bounds, size_t count, unsigned int threads) {
+    buildTree(bounds, count, tree, threads);
+}
+
+void Bvh::refit(const Aabb* bounds, unsigned int threads) {
+    refitTree(tree, bounds, threads);
+}
+
+void Bvh::beginRebuild(const Aabb* bounds) {
+    if (rebuild.valid())
+        return;
+    std::vector<Aabb> snapshot(bounds, bounds + size());
+    rebuild = std::async(std::launch::async, [snapshot = std::move(snapshot)] {
+        Tree fresh;
+        buildTree(snapshot.data(), snapshot.size(), fresh, 1);
+        return fresh;
+    });
+}
+
+bool Bvh::finishRebuild(const Aabb* bounds, unsigned int threads) {
+    if (!rebuild.valid() || rebuild.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return false;
+    tree = rebuild.get();
+    refitTree(tree, bounds, threads);
+    return true;
+}
+
+void Bvh::overlapping(const Aabb& box, std::vector<uint32_t>& out) const {
+    using simd::float4;
+    if (tree.nodes.empty())
+        return;
+    const float4 qMinX(box.min.x), qMinY(box.min.y), qMinZ(box.min.z);
+    const float4 qMaxX(box.max.x), qMaxY(box.max.y), qMaxZ(box.max.z);
+    std::vector<int32_t> stack(1, 0);
+    while (!stack.empty()) {
+        const Node& node = tree.nodes[stack.back()];
+        stack.pop_back();
+        const float4 apart = (float4::load(node.minX) > qMaxX) | (float4::load(node.maxX) < qMinX) |
+                             (float4::load(node.minY) > qMaxY) | (float4::load(node.maxY) < qMinY) |
+                             (float4::load(node.minZ) > qMaxZ) | (float4::load(node.maxZ) < qMinZ);
+        const int hits = ~simd::moveMask(apart);
+        for (unsigned int slot = 0; slot < WIDTH; ++slot) {
+            if (!((hits >> slot) & 1) || !slotUsed(node, slot))
+                continue;
+            if (node.child[slot] >= 0) {
+                stack.push_back(node.child[slot]);
+                continue;
+            }
+            const size_t first = (size_t)~node.child[slot];
+            for (size_t k = first; k < first + node.count[slot]; ++k) {
+                if (overlaps(tree.leafBounds[k], box))
+                    out.push_back(tree.primitives[k]);
+            }
+        }
+    }
+}
+
+void Bvh::inFrustum(const Frustum& frustum, std::vector<uint32_t>& out) const {
+    using simd::float4;
+    if (tree.nodes.empty())
+        return;
+
+    // Stack entries carry a flag for subtrees already known to be inside
+    // every plane, which are then taken whole without testing
+    const uint32_t INSIDE = 1u << 31;
+    std::vector<uint32_t> stack(1, 0);
+    while (!stack.empty()) {
+        const uint32_t entry = stack.back();
+        stack.pop_back();
+        const Node& node = tree.nodes[entry & ~INSIDE];
+        int outside = 0, straddling = 0;
+        if (!(entry & INSIDE)) {
+            // Per plane, the corner furthest along the normal decides outside
+            // and the nearest decides whether the box crosses the plane
+            const float4 minX = float4::load(node.minX), minY = float4::load(node.minY), minZ = float4::load(node.minZ);
+            const float4 maxX = float4::load(node.maxX), maxY = float4::load(node.maxY), maxZ = float4::load(node.maxZ);
+            const float4 zero(0.0f);
+            float4 out4 = zero > zero, cross4 = zero > zero;
+            for (const glm::vec4& plane : frustum.planes) {
+                const float4 nx(plane.x), ny(plane.y), nz(plane.z), w(plane.w);
+                const float4 farX = plane.x >= 0.0f ? maxX : minX, nearX = plane.x >= 0.0f ? minX : maxX;
+                const float4 farY = plane.y >= 0.0f ? maxY : minY, nearY = plane.y >= 0.0f ? minY : maxY;
+                const float4 farZ = plane.z >= 0.0f ? maxZ : minZ, nearZ = plane.z >= 0.0f ? minZ : maxZ;
+                out4 = out4 | (madd(nx, farX, madd(ny, farY, madd(nz, farZ, w))) < zero);
+                cross4 = cross4 | (madd(nx, nearX, madd(ny, nearY, madd(nz, nearZ, w))) < zero);
+            }
+            outside = simd::moveMask(out4);
+            straddling = simd::moveMask(cross4);
+        }
+
+        for (unsigned int slot = 0; slot < WIDTH; ++slot) {
+            if (((outside >> slot) & 1) || !slotUsed(node, slot))
+                continue;
+            const bool inside = (entry & INSIDE) || !((straddling >> slot) & 1);
+            if (node.child[slot] >= 0) {
+                stack.push_back((uint32_t)node.child[slot] | (inside ? INSIDE : 0u));
+                continue;
+            }
+            const size_t first = (size_t)~node.child[slot];
+            for (size_t k = first; k < first + node.count[slot]; ++k) {
+                if (inside || !outsideFrustum(frustum, tree.leafBounds[k]))
+                    out.push_back(tree.primitives[k]);
+            }
+        }
+    }
+}
+
+bool Bvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+                  uint32_t& primitive, float& distance) const {
+    using simd::float4;
+    if (tree.nodes.empty())
+        return false;
+    const glm::vec3 inverse = 1.0f / direction;
+    const float4 ox(origin.x), oy(origin.y), oz(origin.z);
+    const float4 ix(inverse.x), iy(inverse.y), iz(inverse.z);
+
+    // raySlabs() for four boxes
+    auto slabs = [&](float4 minX, float4 minY, float4 minZ, float4 maxX, float4 maxY, float4 maxZ, float4& enter,
+                     float4& leave) {
+        const float4 x0 = (minX - ox) * ix, x1 = (maxX - ox) * ix;
+        const float4 y0 = (minY - oy) * iy, y1 = (maxY - oy) * iy;
+        const float4 z0 = (minZ - oz) * iz, z1 = (maxZ - oz) * iz;
+        enter = simd::max(simd::max(simd::min(x0, x1), simd::min(y0, y1)), simd::max(simd::min(z0, z1), float4(0.0f)));
+        leave = simd::min(simd::max(x0, x1), simd::min(simd::max(y0, y1), simd::max(z0, z1)));
+    };
+
+    float best = maxDistance;
+    bool found = false;
+    std::vector<std::pair<float, int32_t>> stack(1, { 0.0f, 0 });
+    while (!stack.empty()) {
+        const std::pair<float, int32_t> entry = stack.back();
+        stack.pop_back();
+        if (entry.first > best)
+            continue;
+        const Node& node = tree.nodes[entry.second];
+        float4 enter, leave;
+        slabs(float4::load(node.minX), float4::load(node.minY), float4::load(node.minZ), float4::load(node.maxX),
+              float4::load(node.maxY), float4::load(node.maxZ), enter, leave);
+        const int missed = simd::moveMask((enter > leave) | (enter > float4(best)));
+        float enterAt[WIDTH];
+        enter.store(enterAt);
+
+        // Children nearest first: pushed furthest first
+        std::pair<float, int32_t> children[WIDTH];
+        unsigned int childCount = 0;
+        for (unsigned int slot = 0; slot < WIDTH; ++slot) {
+            if (((missed >> slot) & 1) || !slotUsed(node, slot))
+                continue;
+            if (node.child[slot] >= 0) {
+                children[childCount++] = { enterAt[slot], node.child[slot] };
+                continue;
+            }
+            const size_t first = (size_t)~node.child[slot];
+            for (size_t k = first; k < first + node.count[slot]; ++k) {
+                float enterK, leaveK;
+                raySlabs(tree.leafBounds[k], origin, inverse, enterK, leaveK);
+                if (enterK <= leaveK && enterK < best) {
+                    best = enterK;
+                    primitive = tree.primitives[k];
+                    found = true;
+                }
+            }
+        }
+        for (unsigned int i = 1; i < childCount; ++i) {
+            for (unsigned int j = i; j > 0 && children[j - 1].first < children[j].first; --j)
+                std::swap(children[j - 1], children[j]);
+        }
+        stack.insert(stack.end(), children, children + childCount);
+    }
+    if (found)
+        distance = best;
+    return found;
+}
+
+} // namespace Common
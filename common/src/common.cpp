@@ -1,4 +1,5 @@
 #include "common.hpp"
+#include "gl_state.hpp"
 
 namespace Common {
 
@@ -32,7 +33,7 @@ Window::Window(int width, int height, const char* title) : width(width), height(
     }
     
     // Enable depth testing
-    glEnable(GL_DEPTH_TEST);
+    glState().enable(GL_DEPTH_TEST);
     
     printOpenGLInfo();
 }
@@ -63,35 +64,16 @@ void Window::framebufferSizeCallback(GLFWwindow* window, int width, int height)
 }
 
 // Shader implementation
-Shader::Shader(const char* vertexPath, const char* fragmentPath) {
+Shader::Shader(const char* vertexPath, const char* fragmentPath, ProgramCache* cache) {
     std::string vertexCode = readFile(vertexPath);
     std::string fragmentCode = readFile(fragmentPath);
     
-    const char* vShaderCode = vertexCode.c_str();
-    const char* fShaderCode = fragmentCode.c_str();
-    
-    // Compile vertex shader
-    unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vShaderCode, nullptr);
-    glCompileShader(vertex);
-    checkCompileErrors(vertex, "VERTEX");
-    
-    // Compile fragment shader
-    unsigned int fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, nullptr);
-    glCompileShader(fragment);
-    checkCompileErrors(fragment, "FRAGMENT");
-    
-    // Create shader program
-    ID = glCreateProgram();
-    glAttachShader(ID, vertex);
-    glAttachShader(ID, fragment);
-    glLinkProgram(ID);
-    checkCompileErrors(ID, "PROGRAM");
-    
-    // Delete shaders
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
+    // Compile and link, or load the program binary cached by an earlier run
+    ID = cache ? cache->link(vertexCode, fragmentCode) : compileProgram(vertexCode, fragmentCode);
+    if (ID) {
+        uniformTable.reflect(ID);
+        bindUniformBlocks(ID);
+    }
 }
 
 Shader::~Shader() {
@@ -99,45 +81,47 @@ Shader::~Shader() {
 }
 
 void Shader::use() {
-    glUseProgram(ID);
+    glState().useProgram(ID);
+}
+
+void Shader::setBool(UniformId id, bool value) const {
+    glUniform1i(uniformTable.location(id), (int)value);
+}
+
+void Shader::setInt(UniformId id, int value) const {
+    glUniform1i(uniformTable.location(id), value);
+}
+
+void Shader::setFloat(UniformId id, float value) const {
+    glUniform1f(uniformTable.location(id), value);
+}
+
+void Shader::setVec3(UniformId id, const glm::vec3 &value) const {
+    glUniform3fv(uniformTable.location(id), 1, &value[0]);
+}
+
+void Shader::setMat4(UniformId id, const glm::mat4 &mat) const {
+    glUniformMatrix4fv(uniformTable.location(id), 1, GL_FALSE, &mat[0][0]);
 }
 
 void Shader::setBool(const std::string &name, bool value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    setBool(UniformId(name), value);
 }
 
 void Shader::setInt(const std::string &name, int value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    setInt(UniformId(name), value);
 }
 
 void Shader::setFloat(const std::string &name, float value) const {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    setFloat(UniformId(name), value);
 }
 
 void Shader::setVec3(const std::string &name, const glm::vec3 &value) const {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    setVec3(UniformId(name), value);
 }
 
 void Shader::setMat4(const std::string &name, const glm::mat4 &mat) const {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
-}
-
-void Shader::checkCompileErrors(unsigned int shader, const std::string &type) {
-    int success;
-    char infoLog[1024];
-    if (type != "PROGRAM") {
-        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            glGetShaderInfoLog(shader, 1024, nullptr, infoLog);
-            std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
-        }
-    } else {
-        glGetProgramiv(shader, GL_LINK_STATUS, &success);
-        if (!success) {
-            glGetProgramInfoLog(shader, 1024, nullptr, infoLog);
-            std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
-        }
-    }
+    setMat4(UniformId(name), mat);
 }
 
 // Utility functions
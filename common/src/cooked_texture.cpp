@@ -0,0 +1,165 @@
+#include "cooked_texture.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+namespace Common {
+
+namespace {
+
+const char kMagic[4] = { 'C', 'T', 'E', 'X' };
+const uint32_t kVersion = 1;
+const uint32_t kMaxLevels = 32;
+
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t channels;
+    uint32_t faces;
+    uint32_t levelCount;
+};
+
+struct LevelEntry {
+    uint32_t level;
+    uint32_t width;
+    uint32_t height;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+};
+
+bool readHeader(std::ifstream& file, const std::string& path, FileHeader& header,
+                std::vector<LevelEntry>& entries) {
+    if (!file.is_open()) {
+        std::cout << "ERROR::COOKED_TEXTURE::CANNOT_OPEN: " << path << std::endl;
+        return false;
+    }
+
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    // Nothing from the file is trusted before it is checked: it may be
+    // truncated or half rewritten (hot reload), and the sizes drive reads
+    // and uploads
+    if (!file || !std::equal(kMagic, kMagic + 4, header.magic) || header.version != kVersion ||
+        (header.faces != 1 && header.faces != 6) || header.channels < 1 || header.channels > 4 ||
+        header.levelCount > kMaxLevels) {
+        std::cout << "ERROR::COOKED_TEXTURE::BAD_HEADER: " << path << std::endl;
+        return false;
+    }
+
+    entries.resize(header.levelCount);
+    file.read(reinterpret_cast<char*>(entries.data()), entries.size() * sizeof(LevelEntry));
+    for (const LevelEntry& entry : entries) {
+        const uint64_t expected = (uint64_t)entry.width * entry.height * header.channels * header.faces;
+        if (!file || entry.level >= header.levelCount || entry.size != expected) {
+            std::cout << "ERROR::COOKED_TEXTURE::BAD_HEADER: " << path << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+size_t CookedTexture::faceBytes(size_t level) const {
+    return (size_t)levels[level].width * levels[level].height * channels;
+}
+
+size_t CookedTexture::byteSize() const {
+    size_t total = 0;
+    for (const auto& level : levels)
+        total += level.data.size();
+    return total;
+}
+
+bool writeCookedTexture(const std::string& path, const CookedTexture& texture) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "ERROR::COOKED_TEXTURE::CANNOT_WRITE: " << path << std::endl;
+        return false;
+    }
+
+    FileHeader header = {};
+    std::copy(kMagic, kMagic + 4, header.magic);
+    header.version = kVersion;
+    header.channels = texture.channels;
+    header.faces = texture.faces;
+    header.levelCount = (uint32_t)texture.levels.size();
+
+    // Smallest level first
+    std::vector<LevelEntry> entries;
+    uint64_t offset = sizeof(FileHeader) + texture.levels.size() * sizeof(LevelEntry);
+    for (size_t i = texture.levels.size(); i-- > 0;) {
+        const CookedLevel& level = texture.levels[i];
+        LevelEntry entry = {};
+        entry.level = (uint32_t)i;
+        entry.width = level.width;
+        entry.height = level.height;
+        entry.offset = offset;
+        entry.size = level.data.size();
+        entries.push_back(entry);
+        offset += entry.size;
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(LevelEntry));
+    for (const LevelEntry& entry : entries) {
+        const CookedLevel& level = texture.levels[entry.level];
+        file.write(reinterpret_cast<const char*>(level.data.data()), level.data.size());
+    }
+    return file.good();
+}
+
+bool readCookedTexture(const std::string& path, CookedTexture& texture, size_t firstLevel) {
+    std::ifstream file(path, std::ios::binary);
+    FileHeader header = {};
+    std::vector<LevelEntry> entries;
+    if (!readHeader(file, path, header, entries))
+        return false;
+
+    texture.channels = header.channels;
+    texture.faces = header.faces;
+    texture.levels.assign(header.levelCount, CookedLevel());
+    for (const LevelEntry& entry : entries) {
+        CookedLevel& level = texture.levels[entry.level];
+        level.width = entry.width;
+        level.height = entry.height;
+        if (entry.level < firstLevel)
+            continue;
+        level.data.resize(entry.size);
+        file.seekg((std::streamoff)entry.offset);
+        file.read(reinterpret_cast<char*>(level.data.data()), entry.size);
+    }
+
+    if (!file) {
+        std::cout << "ERROR::COOKED_TEXTURE::TRUNCATED: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool readCookedLevel(const std::string& path, size_t level, CookedLevel& out) {
+    std::ifstream file(path, std::ios::binary);
+    FileHeader header = {};
+    std::vector<LevelEntry> entries;
+    if (!readHeader(file, path, header, entries))
+        return false;
+
+    for (const LevelEntry& entry : entries) {
+        if (entry.level != level)
+            continue;
+        out.width = entry.width;
+        out.height = entry.height;
+        out.data.resize(entry.size);
+        file.seekg((std::streamoff)entry.offset);
+        file.read(reinterpret_cast<char*>(out.data.data()), entry.size);
+        if (!file) {
+            std::cout << "ERROR::COOKED_TEXTURE::TRUNCATED: " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+    return false;
+}
+
+} // namespace Common
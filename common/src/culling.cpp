@@ -0,0 +1,147 @@
+#include "culling.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace Common {
+
+namespace {
+
+// Objects per span: the unit of parallel work and of compaction. A multiple
+// of 4, large enough that spans never share a cache line of output.
+const size_t SPAN_OBJECTS = 4096;
+
+// Test objects [begin, end) (begin a multiple of 4) and write the indices
+// that survive to out, in order. Returns how many.
+size_t cullSpan(const Frustum& frustum, const float* cx, const float* cy, const float* cz,
+                const float* ex, const float* ey, const float* ez, const float* r,
+                size_t begin, size_t end, uint32_t* out) {
+    using simd::float4;
+    float4 nx[6], ny[6], nz[6], w[6], ax[6], ay[6], az[6];
+    for (int p = 0; p < 6; ++p) {
+        const glm::vec4& plane = frustum.planes[p];
+        nx[p] = float4(plane.x);
+        ny[p] = float4(plane.y);
+        nz[p] = float4(plane.z);
+        w[p] = float4(plane.w);
+        ax[p] = float4(std::fabs(plane.x));
+        ay[p] = float4(std::fabs(plane.y));
+        az[p] = float4(std::fabs(plane.z));
+    }
+
+    const float4 zero(0.0f);
+    size_t kept = 0;
+    for (size_t i = begin; i < end; i += 4) {
+        const float4 x = float4::load(cx + i), y = float4::load(cy + i), z = float4::load(cz + i);
+        const float4 hx = float4::load(ex + i), hy = float4::load(ey + i), hz = float4::load(ez + i);
+        const float4 radius = float4::load(r + i);
+        float4 outside = zero > radius;
+        for (int p = 0; p < 6; ++p) {
+            // Signed distance of the center, and how far the volume reaches
+            // towards the plane: the box's projected half extent or the radius
+            const float4 distance = madd(nx[p], x, madd(ny[p], y, madd(nz[p], z, w[p])));
+            const float4 reach = simd::min(madd(ax[p], hx, madd(ay[p], hy, az[p] * hz)), radius);
+            outside = outside | (distance + reach < zero);
+        }
+
+        // Store every lane and advance past the kept ones. Writes never run
+        // ahead of the object being tested, so they stay inside the span.
+        const int visible = ~simd::moveMask(outside) & 0xF;
+        for (int lane = 0; lane < 4; ++lane) {
+            out[kept] = (uint32_t)(i + lane);
+            kept += (visible >> lane) & 1;
+        }
+    }
+    return kept;
+}
+
+} // namespace
+
+Frustum extractFrustum(const glm::mat4& m) {
+    // Gribb and Hartmann: each plane is the last row of the matrix plus or
+    // minus one of the others (GLM is column-major, so row i is m[*][i])
+    const glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    const glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    const glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    const glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+    Frustum frustum;
+    frustum.planes[0] = row3 + row0;
+    frustum.planes[1] = row3 - row0;
+    frustum.planes[2] = row3 + row1;
+    frustum.planes[3] = row3 - row1;
+    frustum.planes[4] = row3 + row2;
+    frustum.planes[5] = row3 - row2;
+    for (glm::vec4& plane : frustum.planes)
+        plane /= glm::length(glm::vec3(plane));
+    return frustum;
+}
+
+void CullingSet::resize(size_t newCount) {
+    count = newCount;
+    const size_t padded = (count + 3) & ~size_t(3);
+    for (std::vector<float>* array : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ })
+        array->assign(padded, 0.0f);
+    // A negative radius reaches nowhere, so unset objects are outside every plane
+    radius.assign(padded, -FLT_MAX);
+    survivors.resize(padded);
+}
+
+void CullingSet::setBox(size_t i, const glm::vec3& min, const glm::vec3& max) {
+    const glm::vec3 center = (min + max) * 0.5f;
+    const glm::vec3 extent = (max - min) * 0.5f;
+    centerX[i] = center.x;
+    centerY[i] = center.y;
+    centerZ[i] = center.z;
+    extentX[i] = extent.x;
+    extentY[i] = extent.y;
+    extentZ[i] = extent.z;
+    radius[i] = glm::length(extent);
+}
+
+void CullingSet::setSphere(size_t i, const glm::vec3& center, float sphereRadius) {
+    centerX[i] = center.x;
+    centerY[i] = center.y;
+    centerZ[i] = center.z;
+    extentX[i] = extentY[i] = extentZ[i] = sphereRadius;
+    radius[i] = sphereRadius;
+}
+
+size_t CullingSet::cull(const Frustum& frustum, std::vector<uint32_t>& visible, unsigned int threads) {
+    const size_t padded = radius.size();
+    const size_t spans = (padded + SPAN_OBJECTS - 1) / SPAN_OBJECTS;
+    spanVisible.assign(spans, 0);
+    const size_t ranges = threads ? threads : workerCount();
+
+    // Each span writes its survivors over the start of its own part of survivors
+    parallelFor(spans, [&](size_t begin, size_t end) {
+        for (size_t span = begin; span < end; ++span) {
+            const size_t first = span * SPAN_OBJECTS;
+            const size_t last = std::min(padded, first + SPAN_OBJECTS);
+            spanVisible[span] = cullSpan(frustum, centerX.data(), centerY.data(), centerZ.data(), extentX.data(),
+                                         extentY.data(), extentZ.data(), radius.data(), first, last,
+                                         survivors.data() + first);
+        }
+    }, (spans + ranges - 1) / ranges);
+
+    // Then the spans are packed together, each at the sum of those before it
+    size_t total = 0;
+    for (size_t& kept : spanVisible) {
+        const size_t spanTotal = kept;
+        kept = total;
+        total += spanTotal;
+    }
+    visible.resize(total);
+    parallelFor(spans, [&](size_t begin, size_t end) {
+        for (size_t span = begin; span < end; ++span) {
+            const size_t next = span + 1 < spans ? spanVisible[span + 1] : total;
+            const uint32_t* first = survivors.data() + span * SPAN_OBJECTS;
+            std::copy(first, first + (next - spanVisible[span]), visible.data() + spanVisible[span]);
+        }
+    }, (spans + ranges - 1) / ranges);
+    return total;
+}
+
+} // namespace Common
@@ -0,0 +1,219 @@
+#include "ecs.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <new>
+
+namespace Common {
+
+namespace {
+
+std::mutex registryMutex;
+std::vector<size_t> componentSizes;     // by component id
+
+size_t componentSize(uint32_t id) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    return componentSizes[id];
+}
+
+size_t alignUp(size_t value) {
+    return (value + ECS_CACHE_LINE - 1) & ~(ECS_CACHE_LINE - 1);
+}
+
+unsigned char* allocateChunk(size_t bytes) {
+    return static_cast<unsigned char*>(::operator new(bytes, std::align_val_t(ECS_CACHE_LINE)));
+}
+
+void freeChunk(unsigned char* data) {
+    ::operator delete(data, std::align_val_t(ECS_CACHE_LINE));
+}
+
+} // namespace
+
+namespace detail {
+
+uint32_t registerComponent(size_t size) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    if (componentSizes.size() >= MAX_COMPONENT_TYPES) {
+        std::cout << "ERROR::ECS::TOO_MANY_COMPONENTS: more than " << MAX_COMPONENT_TYPES
+                  << " component types" << std::endl;
+        std::abort();
+    }
+    componentSizes.push_back(size);
+    return (uint32_t)componentSizes.size() - 1;
+}
+
+} // namespace detail
+
+World::~World() {
+    for (const std::unique_ptr<Archetype>& archetype : archetypes) {
+        for (const Chunk& chunk : archetype->chunks)
+            freeChunk(chunk.data);
+    }
+}
+
+// Chunk layout: the Entity array, then one array per component, each
+// starting on a cache line. As many entities as fit in ECS_CHUNK_BYTES, and
+// at least one for very large components.
+uint32_t World::archetypeFor(ComponentMask mask) {
+    auto found = archetypeIndex.find(mask);
+    if (found != archetypeIndex.end())
+        return found->second;
+
+    std::unique_ptr<Archetype> archetype(new Archetype());
+    archetype->mask = mask;
+    size_t bytesPerEntity = sizeof(Entity);
+    for (uint32_t id = 0; id < MAX_COMPONENT_TYPES; ++id) {
+        if (mask >> id & 1u) {
+            archetype->components.push_back(id);
+            archetype->sizes[id] = componentSize(id);
+            bytesPerEntity += archetype->sizes[id];
+        }
+    }
+    const size_t padding = (archetype->components.size() + 1) * ECS_CACHE_LINE;
+    archetype->capacity = std::max<size_t>(1, (ECS_CHUNK_BYTES - std::min(padding, ECS_CHUNK_BYTES)) / bytesPerEntity);
+
+    size_t offset = alignUp(archetype->capacity * sizeof(Entity));
+    for (uint32_t id : archetype->components) {
+        archetype->offsets[id] = offset;
+        offset = alignUp(offset + archetype->capacity * archetype->sizes[id]);
+    }
+    archetype->chunkBytes = offset;
+
+    archetypes.push_back(std::move(archetype));
+    const uint32_t index = (uint32_t)archetypes.size() - 1;
+    archetypeIndex[mask] = index;
+    return index;
+}
+
+Entity World::allocate(ComponentMask mask) {
+    Entity entity;
+    if (!freeSlots.empty()) {
+        entity.index = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        entity.index = (uint32_t)slots.size();
+        slots.emplace_back();
+    }
+    Slot& slot = slots[entity.index];
+    entity.generation = slot.generation;
+    slot.alive = true;
+    place(entity, archetypeFor(mask));
+    liveCount++;
+    return entity;
+}
+
+// Append to the archetype's last chunk, starting a new one when it is full
+void World::place(Entity entity, uint32_t archetypeIndex) {
+    Archetype& archetype = *archetypes[archetypeIndex];
+    if (archetype.chunks.empty() || archetype.chunks.back().count == archetype.capacity)
+        archetype.chunks.push_back({ allocateChunk(archetype.chunkBytes), 0 });
+
+    Chunk& chunk = archetype.chunks.back();
+    const uint32_t row = (uint32_t)chunk.count++;
+    reinterpret_cast<Entity*>(chunk.data)[row] = entity;
+
+    Slot& slot = slots[entity.index];
+    slot.archetype = archetypeIndex;
+    slot.chunk = (uint32_t)archetype.chunks.size() - 1;
+    slot.row = row;
+}
+
+// Fill the hole with the archetype's last entity, keeping chunks packed
+void World::removeRow(uint32_t archetypeIndex, uint32_t chunkIndex, uint32_t row) {
+    Archetype& archetype = *archetypes[archetypeIndex];
+    Chunk& last = archetype.chunks.back();
+    const uint32_t lastChunk = (uint32_t)archetype.chunks.size() - 1;
+    const uint32_t lastRow = (uint32_t)last.count - 1;
+
+    if (chunkIndex != lastChunk || row != lastRow) {
+        Chunk& chunk = archetype.chunks[chunkIndex];
+        const Entity moved = reinterpret_cast<Entity*>(last.data)[lastRow];
+        reinterpret_cast<Entity*>(chunk.data)[row] = moved;
+        for (uint32_t id : archetype.components) {
+            const size_t size = archetype.sizes[id];
+            std::memcpy(chunk.data + archetype.offsets[id] + row * size,
+                        last.data + archetype.offsets[id] + lastRow * size, size);
+        }
+        slots[moved.index].chunk = chunkIndex;
+        slots[moved.index].row = row;
+    }
+
+    if (--last.count == 0) {
+        freeChunk(last.data);
+        archetype.chunks.pop_back();
+    }
+}
+
+void World::destroy(Entity entity) {
+    if (!alive(entity))
+        return;
+    Slot& slot = slots[entity.index];
+    removeRow(slot.archetype, slot.chunk, slot.row);
+    slot.alive = false;
+    slot.generation++;
+    freeSlots.push_back(entity.index);
+    liveCount--;
+}
+
+bool World::alive(Entity entity) const {
+    return entity.index < slots.size() && slots[entity.index].alive &&
+           slots[entity.index].generation == entity.generation;
+}
+
+ComponentMask World::maskOf(Entity entity) const {
+    return archetypes[slots[entity.index].archetype]->mask;
+}
+
+void World::move(Entity entity, ComponentMask mask) {
+    const Slot from = slots[entity.index];
+    if (archetypes[from.archetype]->mask == mask)
+        return;
+
+    const uint32_t target = archetypeFor(mask);
+    place(entity, target);
+
+    // Copy the components both archetypes have, then close the old row
+    const Archetype& source = *archetypes[from.archetype];
+    const Archetype& destination = *archetypes[target];
+    const Slot& to = slots[entity.index];
+    const unsigned char* sourceData = source.chunks[from.chunk].data;
+    unsigned char* destinationData = destination.chunks[to.chunk].data;
+    for (uint32_t id : source.components) {
+        if (mask >> id & 1u) {
+            const size_t size = source.sizes[id];
+            std::memcpy(destinationData + destination.offsets[id] + to.row * size,
+                        sourceData + source.offsets[id] + from.row * size, size);
+        }
+    }
+    removeRow(from.archetype, from.chunk, from.row);
+}
+
+void* World::component(Entity entity, uint32_t id) {
+    if (!alive(entity))
+        return nullptr;
+    const Slot& slot = slots[entity.index];
+    const Archetype& archetype = *archetypes[slot.archetype];
+    if (!(archetype.mask >> id & 1u))
+        return nullptr;
+    return archetype.chunks[slot.chunk].data + archetype.offsets[id] + slot.row * archetype.sizes[id];
+}
+
+void World::writeComponent(Entity entity, uint32_t id, const void* value) {
+    if (void* destination = component(entity, id))
+        std::memcpy(destination, value, archetypes[slots[entity.index].archetype]->sizes[id]);
+}
+
+void World::matchingChunks(ComponentMask required, std::vector<ChunkRef>& out) const {
+    out.clear();
+    for (const std::unique_ptr<Archetype>& archetype : archetypes) {
+        if ((archetype->mask & required) != required)
+            continue;
+        for (const Chunk& chunk : archetype->chunks)
+            out.push_back({ archetype.get(), &chunk });
+    }
+}
+
+} // namespace Common
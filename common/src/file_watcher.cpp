@@ -0,0 +1,135 @@
+#include "file_watcher.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace Common {
+
+namespace {
+
+// Modification time as a plain number, 0 if the file is missing
+long long modifiedTime(const std::string& path) {
+    std::error_code error;
+    auto time = std::filesystem::last_write_time(path, error);
+    return error ? 0 : (long long)time.time_since_epoch().count();
+}
+
+} // namespace
+
+FileWatcher::FileWatcher() {
+#ifdef __linux__
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0)
+        std::cout << "ERROR::FILE_WATCHER::INOTIFY_UNAVAILABLE: falling back to polling" << std::endl;
+#endif
+    worker = std::thread(&FileWatcher::run, this);
+}
+
+FileWatcher::~FileWatcher() {
+    stopping = true;
+    worker.join();
+#ifdef __linux__
+    if (inotifyFd >= 0)
+        close(inotifyFd);
+#endif
+}
+
+void FileWatcher::watch(const std::string& path) {
+    std::filesystem::path full = std::filesystem::absolute(path).lexically_normal();
+    Watch entry;
+    entry.path = path;
+    entry.directory = full.parent_path().string();
+    entry.name = full.filename().string();
+    entry.modified = modifiedTime(path);
+
+    std::lock_guard<std::mutex> lock(mutex);
+#ifdef __linux__
+    if (inotifyFd >= 0) {
+        bool known = std::any_of(directoryWatches.begin(), directoryWatches.end(),
+                                 [&](const auto& watch) { return watch.second == entry.directory; });
+        if (!known) {
+            int wd = inotify_add_watch(inotifyFd, entry.directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+            if (wd < 0)
+                std::cout << "ERROR::FILE_WATCHER::CANNOT_WATCH: " << entry.directory << std::endl;
+            else
+                directoryWatches.emplace_back(wd, entry.directory);
+        }
+    }
+#endif
+    watches.push_back(entry);
+}
+
+std::vector<std::string> FileWatcher::changes() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::string> result;
+    result.swap(changed);
+    return result;
+}
+
+void FileWatcher::notify(const std::string& directory, const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const Watch& watch : watches) {
+        if (watch.directory == directory && watch.name == name &&
+            std::find(changed.begin(), changed.end(), watch.path) == changed.end())
+            changed.push_back(watch.path);
+    }
+}
+
+void FileWatcher::run() {
+#ifdef __linux__
+    if (inotifyFd >= 0) {
+        alignas(inotify_event) char buffer[4096];
+        while (!stopping) {
+            // Wake up regularly to notice the destructor
+            pollfd fd = { inotifyFd, POLLIN, 0 };
+            if (poll(&fd, 1, 100) <= 0)
+                continue;
+
+            ssize_t length;
+            while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+                for (char* at = buffer; at < buffer + length;) {
+                    const inotify_event* event = reinterpret_cast<const inotify_event*>(at);
+                    at += sizeof(inotify_event) + event->len;
+                    if (event->len == 0)
+                        continue;
+
+                    std::string directory;
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        for (const auto& watch : directoryWatches) {
+                            if (watch.first == event->wd)
+                                directory = watch.second;
+                        }
+                    }
+                    notify(directory, event->name);
+                }
+            }
+        }
+        return;
+    }
+#endif
+
+    while (!stopping) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Watch& watch : watches) {
+            long long modified = modifiedTime(watch.path);
+            if (modified == watch.modified)
+                continue;
+            watch.modified = modified;
+            if (modified != 0 && std::find(changed.begin(), changed.end(), watch.path) == changed.end())
+                changed.push_back(watch.path);
+        }
+    }
+}
+
+} // namespace Common
@@ -0,0 +1,286 @@
+#include "geometry_arena.hpp"
+#include "gl_state.hpp"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <iostream>
+
+namespace Common {
+
+FreeListAllocator::FreeListAllocator(size_t capacity) {
+    reset(capacity);
+}
+
+void FreeListAllocator::reset(size_t capacity) {
+    freeBlocks.clear();
+    total = capacity;
+    inUse = 0;
+    if (capacity > 0)
+        freeBlocks[0] = capacity;
+}
+
+size_t FreeListAllocator::allocate(size_t size) {
+    if (size == 0)
+        return INVALID;
+    for (auto block = freeBlocks.begin(); block != freeBlocks.end(); ++block) {
+        if (block->second < size)
+            continue;
+        const size_t offset = block->first;
+        const size_t remaining = block->second - size;
+        freeBlocks.erase(block);
+        if (remaining > 0)
+            freeBlocks[offset + size] = remaining;
+        inUse += size;
+        return offset;
+    }
+    return INVALID;
+}
+
+void FreeListAllocator::free(size_t offset, size_t size) {
+    if (size == 0)
+        return;
+    inUse -= size;
+    auto next = freeBlocks.lower_bound(offset);
+
+    // Merge with the block before, then with the one after
+    if (next != freeBlocks.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            offset = previous->first;
+            size += previous->second;
+            freeBlocks.erase(previous);
+        }
+    }
+    if (next != freeBlocks.end() && offset + size == next->first) {
+        size += next->second;
+        freeBlocks.erase(next);
+    }
+    freeBlocks[offset] = size;
+}
+
+void FreeListAllocator::grow(size_t newCapacity) {
+    if (newCapacity <= total)
+        return;
+    const size_t added = newCapacity - total;
+    const size_t oldTotal = total;
+    total = newCapacity;
+    inUse += added;             // free() below takes it back off
+    free(oldTotal, added);
+}
+
+size_t FreeListAllocator::largestFree() const {
+    size_t largest = 0;
+    for (const auto& block : freeBlocks)
+        largest = std::max(largest, block.second);
+    return largest;
+}
+
+GeometryArena::GeometryArena(size_t vertexStride, std::vector<VertexAttribute> attributes,
+                             size_t vertexCapacity, size_t indexCapacity)
+    : stride(vertexStride), attributes(std::move(attributes)),
+      vertexSpace(vertexCapacity), indexSpace(indexCapacity) {
+}
+
+void GeometryArena::create() {
+    GLStateCache& gl = glState();
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vertexBuffer);
+    glGenBuffers(1, &indexBuffer);
+
+    gl.bindVertexArray(vao);
+    gl.bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertexSpace.capacity() * stride, nullptr, GL_STATIC_DRAW);
+    gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexSpace.capacity() * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+    setupVertexArray();
+    gl.bindVertexArray(0);
+}
+
+void GeometryArena::destroy() {
+    GLStateCache& gl = glState();
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vertexBuffer);
+    glDeleteBuffers(1, &indexBuffer);
+    gl.vertexArrayDeleted(vao);
+    gl.bufferDeleted(vertexBuffer);
+    gl.bufferDeleted(indexBuffer);
+    vao = vertexBuffer = indexBuffer = 0;
+    meshes.clear();
+    freeIds.clear();
+    vertexSpace.reset(vertexSpace.capacity());
+    indexSpace.reset(indexSpace.capacity());
+}
+
+// Attribute pointers for the current vertex buffer; the arena's VAO must be bound
+void GeometryArena::setupVertexArray() {
+    glState().bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    for (const VertexAttribute& attribute : attributes) {
+        glVertexAttribPointer(attribute.location, attribute.components, GL_FLOAT, GL_FALSE, (GLsizei)stride,
+                              (const void*)attribute.offset);
+        glEnableVertexAttribArray(attribute.location);
+    }
+    glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+}
+
+// Copy every live mesh into new buffers of the given capacity. With pack set
+// the meshes are laid out back to back; otherwise they keep their offsets.
+void GeometryArena::reallocate(size_t vertexCapacity, size_t indexCapacity, bool pack) {
+    GLStateCache& gl = glState();
+    unsigned int newVertexBuffer = 0, newIndexBuffer = 0;
+    glGenBuffers(1, &newVertexBuffer);
+    glGenBuffers(1, &newIndexBuffer);
+
+    // The copy targets keep the VAO's element binding out of the way
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newVertexBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, vertexCapacity * stride, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, vertexBuffer);
+    if (pack) {
+        size_t offset = 0;
+        for (Mesh& mesh : meshes) {
+            if (!mesh.live)
+                continue;
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)(mesh.range.baseVertex * stride),
+                                (GLintptr)(offset * stride), (GLsizeiptr)(mesh.range.vertexCount * stride));
+            mesh.range.baseVertex = (int)offset;
+            offset += mesh.range.vertexCount;
+        }
+    } else {
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                            (GLsizeiptr)(vertexSpace.capacity() * stride));
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newIndexBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, indexCapacity * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, indexBuffer);
+    if (pack) {
+        size_t offset = 0;
+        for (Mesh& mesh : meshes) {
+            if (!mesh.live)
+                continue;
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                                (GLintptr)(mesh.range.firstIndex * sizeof(unsigned int)),
+                                (GLintptr)(offset * sizeof(unsigned int)),
+                                (GLsizeiptr)(mesh.range.indexCount * sizeof(unsigned int)));
+            mesh.range.firstIndex = (unsigned int)offset;
+            offset += mesh.range.indexCount;
+        }
+    } else {
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                            (GLsizeiptr)(indexSpace.capacity() * sizeof(unsigned int)));
+    }
+
+    glDeleteBuffers(1, &vertexBuffer);
+    glDeleteBuffers(1, &indexBuffer);
+    gl.bufferDeleted(vertexBuffer);
+    gl.bufferDeleted(indexBuffer);
+    vertexBuffer = newVertexBuffer;
+    indexBuffer = newIndexBuffer;
+    gl.bindVertexArray(vao);
+    setupVertexArray();
+    gl.bindVertexArray(0);
+
+    if (pack) {
+        // Rebuild both free lists with the live meshes packed at the front
+        vertexSpace.reset(vertexCapacity);
+        indexSpace.reset(indexCapacity);
+        for (const Mesh& mesh : meshes) {
+            if (mesh.live) {
+                vertexSpace.allocate(mesh.range.vertexCount);
+                indexSpace.allocate(mesh.range.indexCount);
+            }
+        }
+    } else {
+        vertexSpace.grow(vertexCapacity);
+        indexSpace.grow(indexCapacity);
+    }
+}
+
+bool GeometryArena::reserve(size_t vertexCount, size_t indexCount) {
+    if (vertexSpace.largestFree() >= vertexCount && indexSpace.largestFree() >= indexCount)
+        return true;
+
+    // Packing may be enough; otherwise grow to at least twice the size
+    if (vertexSpace.capacity() - vertexSpace.used() >= vertexCount &&
+        indexSpace.capacity() - indexSpace.used() >= indexCount) {
+        defragment();
+        if (vertexSpace.largestFree() >= vertexCount && indexSpace.largestFree() >= indexCount)
+            return true;
+    }
+    size_t vertexCapacity = std::max(vertexSpace.capacity() * 2, vertexSpace.capacity() + vertexCount);
+    size_t indexCapacity = std::max(indexSpace.capacity() * 2, indexSpace.capacity() + indexCount);
+    reallocate(vertexCapacity, indexCapacity, false);
+    return vertexSpace.largestFree() >= vertexCount && indexSpace.largestFree() >= indexCount;
+}
+
+GeometryArena::MeshId GeometryArena::upload(const void* vertices, size_t vertexCount,
+                                            const unsigned int* indices, size_t indexCount) {
+    if (!vao || vertexCount == 0 || indexCount == 0 || !reserve(vertexCount, indexCount)) {
+        std::cout << "ERROR::GEOMETRY_ARENA::UPLOAD_FAILED: " << vertexCount << " vertices, "
+                  << indexCount << " indices" << std::endl;
+        return INVALID_MESH;
+    }
+
+    Mesh mesh;
+    mesh.live = true;
+    mesh.range.vertexCount = (unsigned int)vertexCount;
+    mesh.range.indexCount = (unsigned int)indexCount;
+    mesh.range.baseVertex = (int)vertexSpace.allocate(vertexCount);
+    mesh.range.firstIndex = (unsigned int)indexSpace.allocate(indexCount);
+
+    GLStateCache& gl = glState();
+    gl.bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)(mesh.range.baseVertex * stride),
+                    (GLsizeiptr)(vertexCount * stride), vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)(mesh.range.firstIndex * sizeof(unsigned int)),
+                    (GLsizeiptr)(indexCount * sizeof(unsigned int)), indices);
+
+    MeshId id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+        meshes[id] = mesh;
+    } else {
+        id = (MeshId)meshes.size();
+        meshes.push_back(mesh);
+    }
+    return id;
+}
+
+void GeometryArena::free(MeshId id) {
+    if (id >= meshes.size() || !meshes[id].live)
+        return;
+    Mesh& mesh = meshes[id];
+    vertexSpace.free((size_t)mesh.range.baseVertex, mesh.range.vertexCount);
+    indexSpace.free(mesh.range.firstIndex, mesh.range.indexCount);
+    mesh = Mesh();
+    freeIds.push_back(id);
+}
+
+float GeometryArena::fragmentation() const {
+    auto scattered = [](const FreeListAllocator& space) {
+        size_t free = space.capacity() - space.used();
+        return free == 0 ? 0.0f : 1.0f - (float)space.largestFree() / (float)free;
+    };
+    return std::max(scattered(vertexSpace), scattered(indexSpace));
+}
+
+size_t GeometryArena::defragment() {
+    if (vertexSpace.freeBlockCount() <= 1 && indexSpace.freeBlockCount() <= 1)
+        return 0;
+    std::vector<Range> before;
+    for (const Mesh& mesh : meshes)
+        before.push_back(mesh.range);
+    reallocate(vertexSpace.capacity(), indexSpace.capacity(), true);
+
+    size_t moved = 0;
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        if (meshes[i].live && (meshes[i].range.baseVertex != before[i].baseVertex ||
+                               meshes[i].range.firstIndex != before[i].firstIndex))
+            ++moved;
+    }
+    return moved;
+}
+
+} // namespace Common
@@ -0,0 +1,229 @@
+#include "gl_state.hpp"
+
+#include <glad/glad.h>
+
+namespace Common {
+
+namespace {
+
+// Shadow value for state that has not been set through the cache yet
+constexpr unsigned int UNKNOWN = ~0u;
+
+int textureTargetIndex(GLenum target) {
+    switch (target) {
+    case GL_TEXTURE_2D: return 0;
+    case GL_TEXTURE_CUBE_MAP: return 1;
+    case GL_TEXTURE_2D_ARRAY: return 2;
+    case GL_TEXTURE_3D: return 3;
+    default: return -1;
+    }
+}
+
+int bufferTargetIndex(GLenum target) {
+    switch (target) {
+    case GL_ARRAY_BUFFER: return 0;
+    case GL_ELEMENT_ARRAY_BUFFER: return 1;
+    case GL_UNIFORM_BUFFER: return 2;
+    case GL_DRAW_INDIRECT_BUFFER: return 3;
+    default: return -1;
+    }
+}
+
+int capabilityIndex(GLenum capability) {
+    switch (capability) {
+    case GL_DEPTH_TEST: return 0;
+    case GL_BLEND: return 1;
+    case GL_CULL_FACE: return 2;
+    case GL_TEXTURE_CUBE_MAP_SEAMLESS: return 3;
+    default: return -1;
+    }
+}
+
+} // namespace
+
+GLStateCache::GLStateCache() {
+    invalidate();
+}
+
+void GLStateCache::invalidate() {
+    program = UNKNOWN;
+    activeUnit = UNKNOWN;
+    for (auto& unit : textures) {
+        for (unsigned int& texture : unit)
+            texture = UNKNOWN;
+    }
+    vertexArray = UNKNOWN;
+    for (unsigned int& buffer : buffers)
+        buffer = UNKNOWN;
+    for (unsigned int& binding : uniformBindings)
+        binding = UNKNOWN;
+    for (unsigned int& capability : capabilities)
+        capability = UNKNOWN;
+    blendSource = blendDestination = UNKNOWN;
+    depthFunction = UNKNOWN;
+    depthWrite = UNKNOWN;
+    polygon = UNKNOWN;
+}
+
+bool GLStateCache::change(unsigned int& shadow, unsigned int value) {
+    if (shadow == value) {
+        frame.elided++;
+        return false;
+    }
+    shadow = value;
+    frame.issued++;
+    return true;
+}
+
+void GLStateCache::useProgram(unsigned int id) {
+    if (change(program, id))
+        glUseProgram(id);
+}
+
+void GLStateCache::activeTexture(unsigned int unit) {
+    if (change(activeUnit, unit))
+        glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void GLStateCache::bindTexture(unsigned int unit, unsigned int target, unsigned int texture) {
+    const int index = textureTargetIndex(target);
+    if (index < 0 || unit >= MAX_TEXTURE_UNITS) {
+        activeTexture(unit);
+        frame.issued++;
+        glBindTexture(target, texture);
+        return;
+    }
+    // Switching units costs a call of its own, so check the binding first
+    if (textures[unit][index] == texture) {
+        frame.elided++;
+        return;
+    }
+    activeTexture(unit);
+    change(textures[unit][index], texture);
+    glBindTexture(target, texture);
+}
+
+void GLStateCache::bindTexture(unsigned int target, unsigned int texture) {
+    const int index = textureTargetIndex(target);
+    if (index < 0 || activeUnit >= MAX_TEXTURE_UNITS) {
+        frame.issued++;
+        glBindTexture(target, texture);
+        return;
+    }
+    if (change(textures[activeUnit][index], texture))
+        glBindTexture(target, texture);
+}
+
+void GLStateCache::bindVertexArray(unsigned int vao) {
+    if (change(vertexArray, vao)) {
+        glBindVertexArray(vao);
+        buffers[ELEMENT_ARRAY_BUFFER] = UNKNOWN;
+    }
+}
+
+void GLStateCache::bindBuffer(unsigned int target, unsigned int buffer) {
+    const int index = bufferTargetIndex(target);
+    if (index < 0) {
+        frame.issued++;
+        glBindBuffer(target, buffer);
+        return;
+    }
+    if (change(buffers[index], buffer))
+        glBindBuffer(target, buffer);
+}
+
+void GLStateCache::bindBufferBase(unsigned int target, unsigned int index, unsigned int buffer) {
+    const int generic = bufferTargetIndex(target);
+    if (target != GL_UNIFORM_BUFFER || index >= MAX_UNIFORM_BINDINGS) {
+        frame.issued++;
+        glBindBufferBase(target, index, buffer);
+        if (generic >= 0)
+            buffers[generic] = buffer;
+        return;
+    }
+    if (change(uniformBindings[index], buffer)) {
+        glBindBufferBase(target, index, buffer);
+        buffers[generic] = buffer;
+    }
+}
+
+void GLStateCache::setEnabled(unsigned int capability, bool enabled) {
+    const int index = capabilityIndex(capability);
+    if (index >= 0 && !change(capabilities[index], enabled ? 1u : 0u))
+        return;
+    if (index < 0)
+        frame.issued++;
+    if (enabled)
+        glEnable(capability);
+    else
+        glDisable(capability);
+}
+
+void GLStateCache::enable(unsigned int capability) {
+    setEnabled(capability, true);
+}
+
+void GLStateCache::disable(unsigned int capability) {
+    setEnabled(capability, false);
+}
+
+void GLStateCache::blendFunc(unsigned int source, unsigned int destination) {
+    if (blendSource == source && blendDestination == destination) {
+        frame.elided++;
+        return;
+    }
+    blendSource = source;
+    blendDestination = destination;
+    frame.issued++;
+    glBlendFunc(source, destination);
+}
+
+void GLStateCache::depthFunc(unsigned int function) {
+    if (change(depthFunction, function))
+        glDepthFunc(function);
+}
+
+void GLStateCache::depthMask(bool write) {
+    if (change(depthWrite, write ? 1u : 0u))
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+}
+
+void GLStateCache::polygonMode(unsigned int mode) {
+    if (change(polygon, mode))
+        glPolygonMode(GL_FRONT_AND_BACK, mode);
+}
+
+void GLStateCache::textureDeleted(unsigned int texture) {
+    // GL resets the binding to 0 on every unit the texture was bound to
+    for (auto& unit : textures) {
+        for (unsigned int& bound : unit) {
+            if (bound == texture)
+                bound = 0;
+        }
+    }
+}
+
+void GLStateCache::vertexArrayDeleted(unsigned int vao) {
+    if (vertexArray == vao) {
+        vertexArray = 0;
+        buffers[ELEMENT_ARRAY_BUFFER] = UNKNOWN;
+    }
+}
+
+void GLStateCache::bufferDeleted(unsigned int buffer) {
+    for (unsigned int& bound : buffers) {
+        if (bound == buffer)
+            bound = 0;
+    }
+    for (unsigned int& bound : uniformBindings) {
+        if (bound == buffer)
+            bound = 0;
+    }
+}
+
+GLStateCache& glState() {
+    static GLStateCache cache;
+    return cache;
+}
+
+} // namespace Common
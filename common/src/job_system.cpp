@@ -0,0 +1,316 @@
+#include "job_system.hpp"
+#include "parallel.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <thread>
+
+namespace Common {
+
+namespace {
+
+// Chase-Lev work-stealing deque over a fixed ring (the C11 formulation of
+// Lê, Pop, Cohen and Zappa Nardelli). Only the owning thread pushes and pops,
+// at the bottom; any thread may steal from the top. A full deque refuses the
+// push and the job goes to the shared queue instead.
+class WorkDeque {
+public:
+    static constexpr int64_t CAPACITY = 4096;
+
+    bool push(Job* job) {
+        const int64_t b = bottom.load(std::memory_order_relaxed);
+        const int64_t t = top.load(std::memory_order_acquire);
+        if (b - t >= CAPACITY)
+            return false;
+        slots[b & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_release);
+        return true;
+    }
+
+    Job* pop() {
+        const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        Job* job = slots[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+        if (t == b) {
+            // The last job: race the thieves for it
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                job = nullptr;
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    Job* steal() {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return nullptr;
+        Job* job = slots[t & (CAPACITY - 1)].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+        return job;
+    }
+
+    bool empty() const {
+        return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+    }
+
+private:
+    alignas(64) std::atomic<int64_t> top{0};
+    alignas(64) std::atomic<int64_t> bottom{0};
+    alignas(64) std::atomic<Job*> slots[CAPACITY] = {};
+};
+
+// Deque 0 belongs to the thread that called attachMainThread(), 1.. to
+// workers. -1 for every other thread.
+thread_local int ownDeque = -1;
+
+class Scheduler {
+public:
+    Scheduler() {
+        const unsigned int threads = workerCount();
+        for (unsigned int i = 0; i < threads; ++i)
+            deques.emplace_back(new WorkDeque());
+        for (unsigned int i = 1; i < threads; ++i)
+            workers.emplace_back(&Scheduler::workerLoop, this, (int)i);
+    }
+
+    ~Scheduler() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    void push(Job* job) {
+        if (ownDeque < 0 || !deques[ownDeque]->push(job)) {
+            std::lock_guard<std::mutex> lock(sharedMutex);
+            shared.push_back(job);
+            sharedCount.fetch_add(1, std::memory_order_release);
+        }
+
+        // Pairs with the check in workerLoop: either the sleeper sees the new
+        // signal, or this sees it sleeping and wakes it
+        signal.fetch_add(1, std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_seq_cst) > 0) {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            wake.notify_one();
+        }
+    }
+
+    Job* find() {
+        if (ownDeque >= 0) {
+            if (Job* job = deques[ownDeque]->pop())
+                return job;
+        }
+        if (sharedCount.load(std::memory_order_acquire) > 0) {
+            std::lock_guard<std::mutex> lock(sharedMutex);
+            if (!shared.empty()) {
+                Job* job = shared.front();
+                shared.pop_front();
+                sharedCount.fetch_sub(1, std::memory_order_relaxed);
+                return job;
+            }
+        }
+
+        // Steal, starting from a random victim so thieves spread out
+        thread_local uint32_t seed = 0x9e3779b9u ^ (uint32_t)(size_t)&seed;
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        const size_t count = deques.size();
+        const size_t start = seed % count;
+        for (size_t i = 0; i < count; ++i) {
+            const size_t victim = (start + i) % count;
+            if ((int)victim == ownDeque)
+                continue;
+            if (Job* job = deques[victim]->steal())
+                return job;
+        }
+        return nullptr;
+    }
+
+    void attachMain() {
+        if (!mainAttached.exchange(true, std::memory_order_acq_rel))
+            ownDeque = 0;
+    }
+
+    bool ownQueueEmpty() const {
+        if (ownDeque >= 0)
+            return deques[ownDeque]->empty();
+        return sharedCount.load(std::memory_order_relaxed) == 0;
+    }
+
+    // The slot is free for reuse once finished is set, so the counter is read first
+    static void run(Job* job) {
+        job->invoke(*job);
+        JobCounter* counter = job->counter;
+        job->finished.store(true, std::memory_order_release);
+        detail::finishJob(counter);
+    }
+
+private:
+    // Spin on the queues briefly before sleeping; new work mostly arrives in bursts
+    static constexpr int IDLE_SPINS = 64;
+
+    void workerLoop(int index) {
+        ownDeque = index;
+        int idle = 0;
+        for (;;) {
+            if (Job* job = find()) {
+                run(job);
+                idle = 0;
+                continue;
+            }
+            if (++idle < IDLE_SPINS) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            const uint64_t seen = signal.load(std::memory_order_seq_cst);
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleeping.fetch_add(1, std::memory_order_seq_cst);
+            wake.wait(lock, [&] { return stopping || signal.load(std::memory_order_seq_cst) != seen || !quiet(); });
+            sleeping.fetch_sub(1, std::memory_order_seq_cst);
+            if (stopping)
+                return;
+            idle = 0;
+        }
+    }
+
+    // No job anywhere; checked under the sleep lock so a push just before
+    // the sleeper registered is not missed
+    bool quiet() const {
+        if (sharedCount.load(std::memory_order_acquire) > 0)
+            return false;
+        for (const std::unique_ptr<WorkDeque>& deque : deques) {
+            if (!deque->empty())
+                return false;
+        }
+        return true;
+    }
+
+    std::vector<std::unique_ptr<WorkDeque>> deques;
+    std::vector<std::thread> workers;
+    std::atomic<bool> mainAttached{false};
+
+    std::mutex sharedMutex;
+    std::deque<Job*> shared;
+    std::atomic<size_t> sharedCount{0};
+
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<uint64_t> signal{0};
+    std::atomic<int> sleeping{0};
+    bool stopping = false;
+};
+
+Scheduler& scheduler() {
+    static Scheduler instance;
+    return instance;
+}
+
+// Run jobs until done() holds, yielding when there is nothing to take
+template <typename Done>
+void helpUntil(Done done) {
+    while (!done()) {
+        if (!runPendingJob())
+            std::this_thread::yield();
+    }
+}
+
+// Job slots for one submitting thread. JOB_RING_SIZE jobs may be in flight
+// per thread before submitting waits for the oldest.
+const size_t JOB_RING_SIZE = 4096;
+
+struct JobRing {
+    std::unique_ptr<Job[]> jobs{new Job[JOB_RING_SIZE]};
+    size_t next = 0;
+
+    // A thread's jobs must all have run before it exits
+    ~JobRing() {
+        for (size_t i = 0; i < JOB_RING_SIZE; ++i)
+            helpUntil([&] { return jobs[i].finished.load(std::memory_order_acquire); });
+    }
+};
+
+} // namespace
+
+namespace detail {
+
+Job* allocateJob() {
+    thread_local JobRing ring;
+    Job& job = ring.jobs[ring.next++ & (JOB_RING_SIZE - 1)];
+    helpUntil([&] { return job.finished.load(std::memory_order_acquire); });
+    job.finished.store(false, std::memory_order_relaxed);
+    return &job;
+}
+
+void enqueueJob(Job* job, JobCounter* after) {
+    if (job->counter)
+        job->counter->pending.fetch_add(1, std::memory_order_relaxed);
+    if (after) {
+        // Checked under the lock finishJob takes to release the waiting
+        // jobs, so the job is either held or after has already reached zero
+        std::lock_guard<std::mutex> lock(after->waitingMutex);
+        if (after->pending.load(std::memory_order_acquire) > 0) {
+            after->waiting.push_back(job);
+            return;
+        }
+    }
+    scheduler().push(job);
+}
+
+void finishJob(JobCounter* counter) {
+    if (!counter)
+        return;
+    // finishing keeps a waiter from returning (and maybe destroying the
+    // counter) until the last finisher has released the waiting jobs
+    counter->finishing.fetch_add(1, std::memory_order_seq_cst);
+    if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::vector<Job*> released;
+        {
+            std::lock_guard<std::mutex> lock(counter->waitingMutex);
+            if (counter->pending.load(std::memory_order_acquire) == 0)
+                released.swap(counter->waiting);
+        }
+        for (Job* job : released)
+            scheduler().push(job);
+    }
+    counter->finishing.fetch_sub(1, std::memory_order_release);
+}
+
+} // namespace detail
+
+void attachMainThread() {
+    scheduler().attachMain();
+}
+
+void waitForCounter(JobCounter& counter) {
+    helpUntil([&] { return counter.done(); });
+}
+
+bool runPendingJob() {
+    Job* job = scheduler().find();
+    if (!job)
+        return false;
+    Scheduler::run(job);
+    return true;
+}
+
+bool hasQueuedJobs() {
+    return !scheduler().ownQueueEmpty();
+}
+
+} // namespace Common
@@ -0,0 +1,299 @@
+#include "kinetic_sculpture.hpp"
+#include "gl_state.hpp"
+#include "linkage_solver.hpp"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+
+namespace Common {
+
+namespace {
+
+static_assert(sizeof(SculptureInstance) == 8 * sizeof(float), "SculptureInstance must be two tightly packed vec4s");
+static_assert(sizeof(LinkTransform) == sizeof(SculptureInstance) && offsetof(LinkTransform, tip) == offsetof(SculptureInstance, axis),
+              "LinkTransform must share SculptureInstance's attribute layout");
+
+const float PI = 3.14159265358979f;
+
+void addVertex(std::vector<float>& vertices, const glm::vec3& position, const glm::vec3& normal) {
+    vertices.insert(vertices.end(), { position.x, position.y, position.z, normal.x, normal.y, normal.z });
+}
+
+unsigned int vertexCount(const std::vector<float>& vertices) {
+    return (unsigned int)(vertices.size() / 6);
+}
+
+// Cylinder along -Y from the pivot, capped at both ends
+void addRod(unsigned int segments, float radius, float length, std::vector<float>& vertices,
+            std::vector<unsigned int>& indices) {
+    const unsigned int side = vertexCount(vertices);
+    for (unsigned int s = 0; s <= segments; ++s) {
+        const float angle = 2.0f * PI * s / segments;
+        const glm::vec3 normal(std::cos(angle), 0.0f, -std::sin(angle));
+        addVertex(vertices, normal * radius, normal);
+        addVertex(vertices, normal * radius - glm::vec3(0.0f, length, 0.0f), normal);
+    }
+    for (unsigned int s = 0; s < segments; ++s) {
+        const unsigned int top = side + s * 2, bottom = top + 1;
+        indices.insert(indices.end(), { top, bottom, bottom + 2, top, bottom + 2, top + 2 });
+    }
+
+    for (float y : { 0.0f, -length }) {
+        const glm::vec3 normal(0.0f, y == 0.0f ? 1.0f : -1.0f, 0.0f);
+        const unsigned int center = vertexCount(vertices);
+        addVertex(vertices, glm::vec3(0.0f, y, 0.0f), normal);
+        for (unsigned int s = 0; s <= segments; ++s) {
+            const float angle = 2.0f * PI * s / segments;
+            addVertex(vertices, glm::vec3(std::cos(angle) * radius, y, -std::sin(angle) * radius), normal);
+        }
+        for (unsigned int s = 0; s < segments; ++s) {
+            if (normal.y > 0.0f)
+                indices.insert(indices.end(), { center, center + 1 + s, center + 2 + s });
+            else
+                indices.insert(indices.end(), { center, center + 2 + s, center + 1 + s });
+        }
+    }
+}
+
+void addSphere(unsigned int segments, const glm::vec3& center, float radius, std::vector<float>& vertices,
+               std::vector<unsigned int>& indices) {
+    const unsigned int rings = std::max(segments / 2, 2u);
+    const unsigned int first = vertexCount(vertices);
+    for (unsigned int ring = 0; ring <= rings; ++ring) {
+        const float phi = PI * ring / rings;
+        for (unsigned int s = 0; s <= segments; ++s) {
+            const float theta = 2.0f * PI * s / segments;
+            const glm::vec3 normal(std::sin(phi) * std::cos(theta), std::cos(phi), -std::sin(phi) * std::sin(theta));
+            addVertex(vertices, center + normal * radius, normal);
+        }
+    }
+    for (unsigned int ring = 0; ring < rings; ++ring) {
+        for (unsigned int s = 0; s < segments; ++s) {
+            const unsigned int current = first + ring * (segments + 1) + s;
+            const unsigned int next = current + segments + 1;
+            indices.insert(indices.end(), { current, next, next + 1, current, next + 1, current + 1 });
+        }
+    }
+}
+
+// Invalidating lets the driver hand out fresh storage instead of waiting for
+// the draw that still reads last frame's contents
+void* mapStream(unsigned int buffer, size_t bytes) {
+    glState().bindBuffer(GL_ARRAY_BUFFER, buffer);
+    return glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+}
+
+void unmapStream(unsigned int buffer) {
+    glState().bindBuffer(GL_ARRAY_BUFFER, buffer);
+    if (!glUnmapBuffer(GL_ARRAY_BUFFER))
+        std::cout << "ERROR::SCULPTURE::STREAM_LOST: buffer contents were corrupted" << std::endl;
+}
+
+} // namespace
+
+void buildElementMesh(ElementShape shape, unsigned int segments, float size,
+                      std::vector<float>& vertices, std::vector<unsigned int>& indices) {
+    vertices.clear();
+    indices.clear();
+    segments = std::max(segments, 3u);
+    switch (shape) {
+    case ElementShape::Rod:
+        addRod(segments, 0.06f, 1.0f, vertices, indices);
+        break;
+    case ElementShape::Vane: {
+        // A single quad; the fragment shader lights whichever side faces the camera
+        const glm::vec3 normal(0.0f, 0.0f, 1.0f);
+        addVertex(vertices, glm::vec3(-0.5f, -0.8f, 0.0f), normal);
+        addVertex(vertices, glm::vec3(0.5f, -0.8f, 0.0f), normal);
+        addVertex(vertices, glm::vec3(0.5f, 0.0f, 0.0f), normal);
+        addVertex(vertices, glm::vec3(-0.5f, 0.0f, 0.0f), normal);
+        indices.insert(indices.end(), { 0, 1, 2, 0, 2, 3 });
+        break;
+    }
+    case ElementShape::Sphere:
+        addSphere(segments, glm::vec3(0.0f, -0.6f, 0.0f), 0.3f, vertices, indices);
+        break;
+    }
+    for (size_t i = 0; i < vertices.size(); i += 6) {
+        vertices[i] *= size;
+        vertices[i + 1] *= size;
+        vertices[i + 2] *= size;
+    }
+}
+
+void layoutSculpture(size_t count, const SculptureLayout& layout, std::vector<SculptureInstance>& instances) {
+    const float goldenAngle = PI * (3.0f - std::sqrt(5.0f));
+    const float inner2 = layout.innerRadius * layout.innerRadius;
+    const float outer2 = layout.outerRadius * layout.outerRadius;
+    const float width = std::max(layout.outerRadius - layout.innerRadius, 1e-6f);
+
+    instances.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        // Equal area per element: the radius goes with the square root of the index
+        const float radius = std::sqrt(inner2 + (outer2 - inner2) * (i + 0.5f) / count);
+        const float angle = std::fmod(i * goldenAngle, 2.0f * PI);
+        const glm::vec3 spoke(std::cos(angle), 0.0f, std::sin(angle));
+
+        SculptureInstance& instance = instances[i];
+        instance.offset = spoke * radius;
+        instance.axis = spoke;
+        instance.phase = 2.0f * PI * layout.radialWaves * (radius - layout.innerRadius) / width -
+                         layout.spiralArms * angle;
+        instance.frequency = layout.frequency;
+    }
+}
+
+float elementSpacing(size_t count, const SculptureLayout& layout) {
+    const float area = PI * (layout.outerRadius * layout.outerRadius - layout.innerRadius * layout.innerRadius);
+    return std::sqrt(area / std::max<size_t>(count, 1));
+}
+
+void buildChainSculpture(LinkageSolver& solver, const std::vector<SculptureInstance>& anchors, unsigned int links,
+                         float linkLength, float jointStiffness) {
+    solver.clear();
+    for (const SculptureInstance& anchor : anchors) {
+        const size_t first = solver.addParticle(anchor.offset, 0.0f);
+        for (unsigned int j = 1; j <= links; ++j)
+            solver.addParticle(anchor.offset - glm::vec3(0.0f, linkLength * j, 0.0f));
+        for (unsigned int j = 0; j < links; ++j) {
+            solver.addDistance(first + j, first + j + 1);
+            solver.addHinge(first + j, first + j + 1, anchor.axis);
+        }
+        for (unsigned int j = 1; j < links; ++j)
+            solver.addAngle(first + j - 1, first + j, first + j + 1, anchor.axis, jointStiffness);
+    }
+}
+
+void writeChainTransforms(const LinkageSolver& solver, size_t chains, unsigned int links, LinkTransform* out) {
+    for (size_t chain = 0; chain < chains; ++chain) {
+        const size_t first = chain * (links + 1);
+        for (unsigned int j = 0; j < links; ++j, ++out) {
+            out->pivot = solver.position(first + j);
+            out->tip = solver.position(first + j + 1);
+        }
+    }
+}
+
+bool KineticSculpture::create(ElementShape shape, size_t count, const SculptureLayout& layout, bool simulated) {
+    std::vector<SculptureInstance> data;
+    layoutSculpture(count, layout, data);
+    return create(shape, data, elementSpacing(count, layout), simulated);
+}
+
+bool KineticSculpture::create(ElementShape shape, const std::vector<SculptureInstance>& data, float spacing,
+                              bool simulated) {
+    const size_t count = data.size();
+    if (count == 0)
+        return false;
+    destroy();
+
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    buildElementMesh(shape, 8, 0.9f * spacing, vertices, indices);
+    createBuffers(vertices, indices, data.data(), count, false);
+
+    if (simulated) {
+        GLStateCache& gl = glState();
+        gl.bindVertexArray(vao);
+        glGenBuffers(1, &angleBuffer);
+        gl.bindBuffer(GL_ARRAY_BUFFER, angleBuffer);
+        glBufferData(GL_ARRAY_BUFFER, count * sizeof(float), nullptr, GL_STREAM_DRAW);
+        glVertexAttribPointer(SCULPTURE_ANGLE_LOCATION, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)0);
+        glVertexAttribDivisor(SCULPTURE_ANGLE_LOCATION, 1);
+        glEnableVertexAttribArray(SCULPTURE_ANGLE_LOCATION);
+        gl.bindVertexArray(0);
+    }
+    return true;
+}
+
+bool KineticSculpture::createLinked(size_t count, float linkLength) {
+    if (count == 0)
+        return false;
+    destroy();
+
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    buildElementMesh(ElementShape::Rod, 8, linkLength, vertices, indices);
+    createBuffers(vertices, indices, nullptr, count, true);
+    linkedInstances = true;
+    return true;
+}
+
+void KineticSculpture::createBuffers(const std::vector<float>& vertices, const std::vector<unsigned int>& indices,
+                                     const void* instanceData, size_t count, bool streamed) {
+    GLStateCache& gl = glState();
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vertexBuffer);
+    glGenBuffers(1, &indexBuffer);
+    glGenBuffers(1, &instanceBuffer);
+    gl.bindVertexArray(vao);
+
+    gl.bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+
+    gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+    // SculptureInstance or, streamed, LinkTransform: two vec4s either way
+    gl.bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, count * sizeof(SculptureInstance), instanceData,
+                 streamed ? GL_STREAM_DRAW : GL_STATIC_DRAW);
+    glVertexAttribPointer(SCULPTURE_OFFSET_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(SculptureInstance),
+                          (void*)offsetof(SculptureInstance, offset));
+    glVertexAttribDivisor(SCULPTURE_OFFSET_LOCATION, 1);
+    glEnableVertexAttribArray(SCULPTURE_OFFSET_LOCATION);
+    glVertexAttribPointer(SCULPTURE_AXIS_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(SculptureInstance),
+                          (void*)offsetof(SculptureInstance, axis));
+    glVertexAttribDivisor(SCULPTURE_AXIS_LOCATION, 1);
+    glEnableVertexAttribArray(SCULPTURE_AXIS_LOCATION);
+    gl.bindVertexArray(0);
+
+    elementIndexCount = (unsigned int)indices.size();
+    instances = count;
+}
+
+float* KineticSculpture::mapAngles() {
+    return angleBuffer ? (float*)mapStream(angleBuffer, instances * sizeof(float)) : nullptr;
+}
+
+void KineticSculpture::unmapAngles() {
+    unmapStream(angleBuffer);
+}
+
+LinkTransform* KineticSculpture::mapTransforms() {
+    return linkedInstances ? (LinkTransform*)mapStream(instanceBuffer, instances * sizeof(LinkTransform)) : nullptr;
+}
+
+void KineticSculpture::unmapTransforms() {
+    unmapStream(instanceBuffer);
+}
+
+void KineticSculpture::destroy() {
+    if (!vao)
+        return;
+    GLStateCache& gl = glState();
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vertexBuffer);
+    glDeleteBuffers(1, &indexBuffer);
+    glDeleteBuffers(1, &instanceBuffer);
+    glDeleteBuffers(1, &angleBuffer);
+    gl.vertexArrayDeleted(vao);
+    gl.bufferDeleted(vertexBuffer);
+    gl.bufferDeleted(indexBuffer);
+    gl.bufferDeleted(instanceBuffer);
+    gl.bufferDeleted(angleBuffer);
+    vao = vertexBuffer = indexBuffer = instanceBuffer = angleBuffer = 0;
+    elementIndexCount = 0;
+    instances = 0;
+    linkedInstances = false;
+}
+
+} // namespace Common
@@ -0,0 +1,244 @@
+#include "linkage_solver.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Common {
+
+namespace {
+
+// Colors are tracked as a 64-bit mask per particle; a constraint whose
+// particles already use all 64 goes into one last color solved serially
+const uint32_t PARALLEL_COLORS = 64;
+
+// Constraints per thread range at the least; fewer than this in a color and
+// handing a range to another thread costs more than projecting it
+const size_t MIN_CONSTRAINTS_PER_RANGE = 2048;
+
+const float PI = 3.14159265358979f;
+
+float signedAngle(const glm::vec3& u, const glm::vec3& v, const glm::vec3& axis) {
+    return std::atan2(glm::dot(axis, glm::cross(u, v)), glm::dot(u, v) - glm::dot(axis, u) * glm::dot(axis, v));
+}
+
+} // namespace
+
+void LinkageSolver::clear() {
+    positions.clear();
+    predicted.clear();
+    velocities.clear();
+    inverseMasses.clear();
+    constraints.clear();
+    ordered.clear();
+    orderedStiffness.clear();
+    colorStart.clear();
+    colorsDirty = true;
+}
+
+size_t LinkageSolver::addParticle(const glm::vec3& position, float inverseMass) {
+    positions.push_back(position);
+    predicted.push_back(position);
+    velocities.push_back(glm::vec3(0.0f));
+    inverseMasses.push_back(inverseMass);
+    return positions.size() - 1;
+}
+
+void LinkageSolver::setPosition(size_t i, const glm::vec3& position) {
+    positions[i] = position;
+    predicted[i] = position;
+}
+
+void LinkageSolver::addDistance(size_t a, size_t b, float stiffness) {
+    constraints.push_back({ ConstraintType::Distance, (uint32_t)a, (uint32_t)b, 0,
+                            glm::length(positions[b] - positions[a]), stiffness, glm::vec3(0.0f) });
+    colorsDirty = true;
+}
+
+void LinkageSolver::addHinge(size_t a, size_t b, const glm::vec3& axis, float stiffness) {
+    const glm::vec3 n = glm::normalize(axis);
+    constraints.push_back({ ConstraintType::Hinge, (uint32_t)a, (uint32_t)b, 0,
+                            glm::dot(positions[b] - positions[a], n), stiffness, n });
+    colorsDirty = true;
+}
+
+void LinkageSolver::addAngle(size_t a, size_t b, size_t c, const glm::vec3& axis, float stiffness) {
+    const glm::vec3 n = glm::normalize(axis);
+    constraints.push_back({ ConstraintType::Angle, (uint32_t)a, (uint32_t)b, (uint32_t)c,
+                            signedAngle(positions[a] - positions[b], positions[c] - positions[b], n), stiffness, n });
+    colorsDirty = true;
+}
+
+// Greedy coloring in the order constraints were added: each takes the lowest
+// color none of its particles has yet. A chain needs a handful of colors.
+void LinkageSolver::buildColors() {
+    std::vector<uint64_t> used(positions.size(), 0);
+    std::vector<uint32_t> colors(constraints.size());
+    uint32_t colorTotal = 0;
+    for (size_t i = 0; i < constraints.size(); ++i) {
+        const Constraint& constraint = constraints[i];
+        uint64_t taken = used[constraint.a] | used[constraint.b];
+        if (constraint.type == ConstraintType::Angle)
+            taken |= used[constraint.c];
+
+        uint32_t color = 0;
+        while (color < PARALLEL_COLORS && (taken >> color & 1u))
+            ++color;
+        if (color < PARALLEL_COLORS) {
+            const uint64_t bit = uint64_t(1) << color;
+            used[constraint.a] |= bit;
+            used[constraint.b] |= bit;
+            if (constraint.type == ConstraintType::Angle)
+                used[constraint.c] |= bit;
+        }
+        colors[i] = color;
+        colorTotal = std::max(colorTotal, color + 1);
+    }
+
+    // Counting sort by color, then by type within a color so the projection
+    // runs one kind at a time; the order inside a color changes nothing
+    const size_t TYPES = 3;
+    std::vector<size_t> start(colorTotal * TYPES + 1, 0);
+    for (size_t i = 0; i < constraints.size(); ++i)
+        start[colors[i] * TYPES + (size_t)constraints[i].type + 1]++;
+    for (size_t bucket = 0; bucket + 1 < start.size(); ++bucket)
+        start[bucket + 1] += start[bucket];
+    std::vector<size_t> next(start.begin(), start.end() - 1);
+    ordered.resize(constraints.size());
+    for (size_t i = 0; i < constraints.size(); ++i)
+        ordered[next[colors[i] * TYPES + (size_t)constraints[i].type]++] = constraints[i];
+
+    colorStart.resize(colorTotal + 1);
+    for (size_t color = 0; color <= colorTotal; ++color)
+        colorStart[color] = start[color * TYPES];
+
+    colorsDirty = false;
+    stiffnessIterations = 0;
+}
+
+// Stiffness k per step becomes 1 - (1 - k)^(1 / n) per iteration, so n
+// iterations remove the same fraction of the error as one would with k
+void LinkageSolver::setIterations(unsigned int iterations) {
+    orderedStiffness.resize(ordered.size());
+    for (size_t i = 0; i < ordered.size(); ++i) {
+        const float k = std::min(std::max(ordered[i].stiffness, 0.0f), 1.0f);
+        orderedStiffness[i] = k >= 1.0f ? 1.0f : 1.0f - std::pow(1.0f - k, 1.0f / iterations);
+    }
+    stiffnessIterations = iterations;
+}
+
+void LinkageSolver::project(const Constraint& constraint, float stiffness) {
+    glm::vec3& a = predicted[constraint.a];
+    glm::vec3& b = predicted[constraint.b];
+    const float wa = inverseMasses[constraint.a];
+    const float wb = inverseMasses[constraint.b];
+
+    switch (constraint.type) {
+    case ConstraintType::Distance: {
+        const glm::vec3 d = b - a;
+        const float length = glm::length(d);
+        if (wa + wb <= 0.0f || length < 1e-9f)
+            return;
+        const glm::vec3 correction = d * (stiffness * (length - constraint.rest) / (length * (wa + wb)));
+        a += wa * correction;
+        b -= wb * correction;
+        break;
+    }
+    case ConstraintType::Hinge: {
+        if (wa + wb <= 0.0f)
+            return;
+        const float error = glm::dot(b - a, constraint.axis) - constraint.rest;
+        const glm::vec3 correction = constraint.axis * (stiffness * error / (wa + wb));
+        a += wa * correction;
+        b -= wb * correction;
+        break;
+    }
+    case ConstraintType::Angle: {
+        glm::vec3& c = predicted[constraint.c];
+        const float wc = inverseMasses[constraint.c];
+        const glm::vec3& n = constraint.axis;
+        const glm::vec3 u = a - b, v = c - b;
+
+        // Turning a about the axis changes the angle by -1/r per unit moved
+        // (r its distance from the axis through b), turning c by +1/r
+        const float ru = glm::dot(u, u) - glm::dot(n, u) * glm::dot(n, u);
+        const float rv = glm::dot(v, v) - glm::dot(n, v) * glm::dot(n, v);
+        if (ru < 1e-12f || rv < 1e-12f)
+            return;
+        const glm::vec3 ga = -glm::cross(n, u) / ru;
+        const glm::vec3 gc = glm::cross(n, v) / rv;
+        const glm::vec3 gb = -(ga + gc);
+        const float weight = wa * glm::dot(ga, ga) + wb * glm::dot(gb, gb) + wc * glm::dot(gc, gc);
+        if (weight <= 0.0f)
+            return;
+
+        float error = signedAngle(u, v, n) - constraint.rest;
+        if (error > PI)
+            error -= 2.0f * PI;
+        else if (error < -PI)
+            error += 2.0f * PI;
+        const float lambda = -stiffness * error / weight;
+        a += lambda * wa * ga;
+        b += lambda * wb * gb;
+        c += lambda * wc * gc;
+        break;
+    }
+    }
+}
+
+void LinkageSolver::step(float dt, unsigned int iterations, unsigned int threads) {
+    if (positions.empty() || dt <= 0.0f)
+        return;
+    iterations = std::max(iterations, 1u);
+    if (colorsDirty)
+        buildColors();
+    if (stiffnessIterations != iterations)
+        setIterations(iterations);
+
+    const float keep = std::max(0.0f, 1.0f - damping * dt);
+    for (size_t i = 0; i < positions.size(); ++i) {
+        if (inverseMasses[i] > 0.0f) {
+            velocities[i] = (velocities[i] + gravity * dt) * keep;
+            predicted[i] = positions[i] + velocities[i] * dt;
+        } else {
+            predicted[i] = positions[i];
+        }
+    }
+
+    // Colors one after another; inside one no two constraints share a particle
+    const size_t ranges = threads ? threads : workerCount();
+    for (unsigned int iteration = 0; iteration < iterations; ++iteration) {
+        for (size_t color = 0; color + 1 < colorStart.size(); ++color) {
+            const size_t first = colorStart[color];
+            const size_t count = colorStart[color + 1] - first;
+            auto solve = [&](size_t begin, size_t end) {
+                for (size_t i = first + begin; i < first + end; ++i)
+                    project(ordered[i], orderedStiffness[i]);
+            };
+            if (color >= PARALLEL_COLORS)
+                solve(0, count);
+            else
+                parallelFor(count, solve, std::max(MIN_CONSTRAINTS_PER_RANGE, (count + ranges - 1) / ranges));
+        }
+    }
+
+    const float invDt = 1.0f / dt;
+    for (size_t i = 0; i < positions.size(); ++i) {
+        if (inverseMasses[i] > 0.0f)
+            velocities[i] = (predicted[i] - positions[i]) * invDt;
+        positions[i] = predicted[i];
+    }
+}
+
+float LinkageSolver::maxStretch() const {
+    float stretch = 0.0f;
+    for (const Constraint& constraint : constraints) {
+        if (constraint.type == ConstraintType::Distance && constraint.rest > 0.0f) {
+            const float length = glm::length(positions[constraint.b] - positions[constraint.a]);
+            stretch = std::max(stretch, std::fabs(length - constraint.rest) / constraint.rest);
+        }
+    }
+    return stretch;
+}
+
+} // namespace Common
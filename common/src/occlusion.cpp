@@ -0,0 +1,315 @@
+#include "occlusion.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace Common {
+
+namespace {
+
+const float PI = 3.14159265358979f;
+
+// Occludee boxes per cull() range at the least
+const size_t MIN_BOXES_PER_RANGE = 256;
+
+// A transform's elements, each in every lane, to take boxes to clip space
+// four corners at a time
+struct ClipMatrix {
+    simd::float4 m[4][4];
+
+    explicit ClipMatrix(const glm::mat4& matrix) {
+        for (int column = 0; column < 4; ++column) {
+            for (int row = 0; row < 4; ++row)
+                m[column][row] = simd::float4(matrix[column][row]);
+        }
+    }
+};
+
+// The box's bounds in NDC. False if it reaches behind the near plane or is
+// wholly off screen.
+bool projectBox(const ClipMatrix& clip, const Aabb& box, OcclusionBuffer::ScreenRect& rect) {
+    using simd::float4;
+    const float4 (&m)[4][4] = clip.m;
+    const float4 x(box.min.x, box.max.x, box.min.x, box.max.x);
+    const float4 y(box.min.y, box.min.y, box.max.y, box.max.y);
+    float4 lowX(FLT_MAX), lowY(FLT_MAX), lowZ(FLT_MAX), highX(-FLT_MAX), highY(-FLT_MAX);
+    // The near face's corners, then the far face's
+    for (float depth : { box.min.z, box.max.z }) {
+        const float4 z(depth);
+        const float4 clipX = madd(m[0][0], x, madd(m[1][0], y, madd(m[2][0], z, m[3][0])));
+        const float4 clipY = madd(m[0][1], x, madd(m[1][1], y, madd(m[2][1], z, m[3][1])));
+        const float4 clipZ = madd(m[0][2], x, madd(m[1][2], y, madd(m[2][2], z, m[3][2])));
+        const float4 clipW = madd(m[0][3], x, madd(m[1][3], y, madd(m[2][3], z, m[3][3])));
+        if (simd::moveMask((clipW < float4(FLT_MIN)) | (clipZ < float4(0.0f) - clipW)) != 0)
+            return false;
+        const float4 inverseW = float4(1.0f) / clipW;
+        const float4 ndcX = clipX * inverseW, ndcY = clipY * inverseW;
+        lowX = simd::min(lowX, ndcX);
+        highX = simd::max(highX, ndcX);
+        lowY = simd::min(lowY, ndcY);
+        highY = simd::max(highY, ndcY);
+        lowZ = simd::min(lowZ, clipZ * inverseW);
+    }
+    float lx[4], hx[4], ly[4], hy[4], lz[4];
+    lowX.store(lx);
+    highX.store(hx);
+    lowY.store(ly);
+    highY.store(hy);
+    lowZ.store(lz);
+    rect.minX = std::min(std::min(lx[0], lx[1]), std::min(lx[2], lx[3]));
+    rect.maxX = std::max(std::max(hx[0], hx[1]), std::max(hx[2], hx[3]));
+    rect.minY = std::min(std::min(ly[0], ly[1]), std::min(ly[2], ly[3]));
+    rect.maxY = std::max(std::max(hy[0], hy[1]), std::max(hy[2], hy[3]));
+    rect.nearest = std::min(std::min(lz[0], lz[1]), std::min(lz[2], lz[3]));
+    return rect.maxX >= -1.0f && rect.minX <= 1.0f && rect.maxY >= -1.0f && rect.minY <= 1.0f;
+}
+
+} // namespace
+
+void buildOccluderSphere(unsigned int segments, std::vector<glm::vec3>& vertices, std::vector<uint32_t>& indices) {
+    segments = std::max(segments, 3u);
+    const unsigned int rings = std::max(segments / 2, 2u);
+    vertices.clear();
+    indices.clear();
+
+    // Poles first and last, rings of segments vertices between
+    vertices.push_back(glm::vec3(0.0f, 1.0f, 0.0f));
+    for (unsigned int r = 1; r < rings; ++r) {
+        const float theta = PI * r / rings;
+        for (unsigned int s = 0; s < segments; ++s) {
+            const float phi = 2.0f * PI * s / segments;
+            vertices.push_back(glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta),
+                                         std::sin(theta) * std::sin(phi)));
+        }
+    }
+    vertices.push_back(glm::vec3(0.0f, -1.0f, 0.0f));
+    const uint32_t bottom = (uint32_t)vertices.size() - 1;
+
+    auto ring = [&](unsigned int r, unsigned int s) { return 1 + (r - 1) * segments + s % segments; };
+    // Wound to face away from the center, whichever order it comes in
+    auto triangle = [&](uint32_t a, uint32_t b, uint32_t c) {
+        const glm::vec3 normal = glm::cross(vertices[b] - vertices[a], vertices[c] - vertices[a]);
+        if (glm::dot(normal, vertices[a] + vertices[b] + vertices[c]) < 0.0f)
+            std::swap(b, c);
+        indices.insert(indices.end(), { a, b, c });
+    };
+    for (unsigned int s = 0; s < segments; ++s) {
+        triangle(0, ring(1, s), ring(1, s + 1));
+        for (unsigned int r = 1; r + 1 < rings; ++r) {
+            triangle(ring(r, s), ring(r + 1, s), ring(r + 1, s + 1));
+            triangle(ring(r, s), ring(r + 1, s + 1), ring(r, s + 1));
+        }
+        triangle(ring(rings - 1, s), bottom, ring(rings - 1, s + 1));
+    }
+}
+
+void OcclusionBuffer::resize(unsigned int newWidth, unsigned int newHeight) {
+    tilesX = std::max(1u, (newWidth + TILE_WIDTH - 1) / TILE_WIDTH);
+    tilesY = std::max(1u, (newHeight + TILE_HEIGHT - 1) / TILE_HEIGHT);
+    bins.assign((size_t)tilesX * tilesY, std::vector<uint32_t>());
+
+    // Halving, rounded up, down to a single texel
+    levels.clear();
+    Level level;
+    level.width = tilesX * TILE_WIDTH;
+    level.height = tilesY * TILE_HEIGHT;
+    while (true) {
+        levels.push_back(level);
+        if (level.width == 1 && level.height == 1)
+            break;
+        level.width = (level.width + 1) / 2;
+        level.height = (level.height + 1) / 2;
+    }
+    for (Level& l : levels)
+        l.depth.resize((size_t)l.width * l.height);
+    clear();
+}
+
+void OcclusionBuffer::clear() {
+    triangles.clear();
+    for (std::vector<uint32_t>& bin : bins)
+        bin.clear();
+    for (Level& level : levels)
+        std::fill(level.depth.begin(), level.depth.end(), 1.0f);
+}
+
+void OcclusionBuffer::addOccluder(const glm::mat4& modelViewProjection, const glm::vec3* vertices,
+                                  size_t vertexCount, const uint32_t* indices, size_t indexCount) {
+    // Each vertex to pixels and NDC depth once; w = 0 marks those in front
+    // of the near plane
+    const float w = (float)width(), h = (float)height();
+    projected.resize(vertexCount);
+    for (size_t i = 0; i < vertexCount; ++i) {
+        const glm::vec4 clip = modelViewProjection * glm::vec4(vertices[i], 1.0f);
+        const bool clipped = clip.w <= 0.0f || clip.z < -clip.w;
+        projected[i] = glm::vec4((clip.x / clip.w * 0.5f + 0.5f) * w, (clip.y / clip.w * 0.5f + 0.5f) * h,
+                                 clip.z / clip.w, clipped ? 0.0f : 1.0f);
+    }
+
+    for (size_t t = 0; t + 2 < indexCount; t += 3) {
+        const glm::vec4& p0 = projected[indices[t]];
+        const glm::vec4& p1 = projected[indices[t + 1]];
+        const glm::vec4& p2 = projected[indices[t + 2]];
+        if (p0.w == 0.0f || p1.w == 0.0f || p2.w == 0.0f)
+            continue;
+        const glm::vec3 v[3] = { glm::vec3(p0), glm::vec3(p1), glm::vec3(p2) };
+
+        // Twice the signed area: counter-clockwise on screen is positive
+        const float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+        if (!(area > 0.0f))
+            continue;
+
+        // Pixels whose centers the bounds take in, on screen
+        Triangle tri;
+        const float minX = std::min(v[0].x, std::min(v[1].x, v[2].x));
+        const float maxX = std::max(v[0].x, std::max(v[1].x, v[2].x));
+        const float minY = std::min(v[0].y, std::min(v[1].y, v[2].y));
+        const float maxY = std::max(v[0].y, std::max(v[1].y, v[2].y));
+        tri.minX = std::max(0, (int)std::ceil(minX - 0.5f));
+        tri.maxX = std::min((int)width() - 1, (int)std::floor(maxX - 0.5f));
+        tri.minY = std::max(0, (int)std::ceil(minY - 0.5f));
+        tri.maxY = std::min((int)height() - 1, (int)std::floor(maxY - 0.5f));
+        if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+            continue;
+
+        // Edge k runs from v[k] to v[k + 1]; its function is twice the area
+        // it spans with a point, so over area it weights the opposite vertex
+        for (int k = 0; k < 3; ++k) {
+            const glm::vec3& from = v[k];
+            const glm::vec3& to = v[(k + 1) % 3];
+            tri.edgeA[k] = from.y - to.y;
+            tri.edgeB[k] = to.x - from.x;
+            tri.edgeC[k] = -(tri.edgeA[k] * from.x + tri.edgeB[k] * from.y);
+        }
+        tri.depthA = (tri.edgeA[1] * v[0].z + tri.edgeA[2] * v[1].z + tri.edgeA[0] * v[2].z) / area;
+        tri.depthB = (tri.edgeB[1] * v[0].z + tri.edgeB[2] * v[1].z + tri.edgeB[0] * v[2].z) / area;
+        tri.depthC = (tri.edgeC[1] * v[0].z + tri.edgeC[2] * v[1].z + tri.edgeC[0] * v[2].z) / area;
+
+        const uint32_t index = (uint32_t)triangles.size();
+        triangles.push_back(tri);
+        for (int ty = tri.minY / (int)TILE_HEIGHT; ty <= tri.maxY / (int)TILE_HEIGHT; ++ty) {
+            for (int tx = tri.minX / (int)TILE_WIDTH; tx <= tri.maxX / (int)TILE_WIDTH; ++tx)
+                bins[(size_t)ty * tilesX + tx].push_back(index);
+        }
+    }
+}
+
+void OcclusionBuffer::fillTile(size_t tile) {
+    using simd::float4;
+    Level& target = levels[0];
+    const int tileX = (int)(tile % tilesX) * (int)TILE_WIDTH;
+    const int tileY = (int)(tile / tilesX) * (int)TILE_HEIGHT;
+    const float4 zero(0.0f), centers(0.5f, 1.5f, 2.5f, 3.5f);
+
+    for (uint32_t index : bins[tile]) {
+        const Triangle& tri = triangles[index];
+        // Blocks of 4 pixels from the one holding the first column; tiles are
+        // whole blocks, so the last may run past the triangle but not the tile
+        const int x0 = std::max(tri.minX, tileX) & ~3;
+        const int x1 = std::min(tri.maxX, tileX + (int)TILE_WIDTH - 1);
+        const int y0 = std::max(tri.minY, tileY);
+        const int y1 = std::min(tri.maxY, tileY + (int)TILE_HEIGHT - 1);
+        const float4 a0(tri.edgeA[0]), a1(tri.edgeA[1]), a2(tri.edgeA[2]), depthA(tri.depthA);
+
+        for (int y = y0; y <= y1; ++y) {
+            const float centerY = y + 0.5f;
+            const float4 row0(tri.edgeB[0] * centerY + tri.edgeC[0]);
+            const float4 row1(tri.edgeB[1] * centerY + tri.edgeC[1]);
+            const float4 row2(tri.edgeB[2] * centerY + tri.edgeC[2]);
+            const float4 rowDepth(tri.depthB * centerY + tri.depthC);
+            float* depth = target.depth.data() + (size_t)y * target.width;
+            for (int x = x0; x <= x1; x += 4) {
+                const float4 centerX = float4((float)x) + centers;
+                const float4 outside = (madd(a0, centerX, row0) < zero) | (madd(a1, centerX, row1) < zero) |
+                                       (madd(a2, centerX, row2) < zero);
+                if (simd::moveMask(outside) == 0xF)
+                    continue;
+                const float4 stored = float4::load(depth + x);
+                const float4 z = madd(depthA, centerX, rowDepth);
+                simd::select(outside, stored, simd::min(z, stored)).store(depth + x);
+            }
+        }
+    }
+}
+
+void OcclusionBuffer::buildPyramid() {
+    for (size_t l = 1; l < levels.size(); ++l) {
+        const Level& below = levels[l - 1];
+        Level& level = levels[l];
+        for (unsigned int y = 0; y < level.height; ++y) {
+            const float* row0 = below.depth.data() + (size_t)(2 * y) * below.width;
+            const float* row1 = below.depth.data() + (size_t)std::min(2 * y + 1, below.height - 1) * below.width;
+            float* out = level.depth.data() + (size_t)y * level.width;
+            for (unsigned int x = 0; x < level.width; ++x) {
+                const unsigned int x0 = 2 * x, x1 = std::min(2 * x + 1, below.width - 1);
+                out[x] = std::max(std::max(row0[x0], row0[x1]), std::max(row1[x0], row1[x1]));
+            }
+        }
+    }
+}
+
+void OcclusionBuffer::rasterize(unsigned int threads) {
+    const size_t tiles = bins.size();
+    const size_t ranges = threads ? threads : workerCount();
+    parallelFor(tiles, [&](size_t begin, size_t end) {
+        for (size_t tile = begin; tile < end; ++tile)
+            fillTile(tile);
+    }, std::max<size_t>(1, (tiles + ranges - 1) / ranges));
+    buildPyramid();
+}
+
+bool OcclusionBuffer::occluded(const glm::mat4& modelViewProjection, const Aabb& box) const {
+    ScreenRect rect;
+    return projectBox(ClipMatrix(modelViewProjection), box, rect) && hidden(rect);
+}
+
+bool OcclusionBuffer::hidden(const ScreenRect& rect) const {
+    if (levels.empty())
+        return false;
+
+    // Every pixel the rectangle touches, then the level where they fit in
+    // 2x2 texels; any texel as near as the box shows it
+    const float w = (float)width(), h = (float)height();
+    const int x0 = (int)std::max(0.0f, (rect.minX * 0.5f + 0.5f) * w);
+    const int x1 = (int)std::min(w - 1.0f, (rect.maxX * 0.5f + 0.5f) * w);
+    const int y0 = (int)std::max(0.0f, (rect.minY * 0.5f + 0.5f) * h);
+    const int y1 = (int)std::min(h - 1.0f, (rect.maxY * 0.5f + 0.5f) * h);
+    size_t l = 0;
+    while (l + 1 < levels.size() && ((x1 >> l) - (x0 >> l) > 1 || (y1 >> l) - (y0 >> l) > 1))
+        ++l;
+    const Level& level = levels[l];
+    for (int ty = y0 >> l; ty <= y1 >> l; ++ty) {
+        for (int tx = x0 >> l; tx <= x1 >> l; ++tx) {
+            if (level.depth[(size_t)ty * level.width + tx] >= rect.nearest)
+                return false;
+        }
+    }
+    return true;
+}
+
+size_t OcclusionBuffer::cull(const glm::mat4& modelViewProjection, const Aabb* boxes,
+                             std::vector<uint32_t>& visible, unsigned int threads) {
+    const size_t count = visible.size();
+    occludedFlags.resize(count);
+    const ClipMatrix clip(modelViewProjection);
+    const size_t ranges = threads ? threads : workerCount();
+    parallelFor(count, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            ScreenRect rect;
+            occludedFlags[i] = projectBox(clip, boxes[visible[i]], rect) && hidden(rect);
+        }
+    }, std::max(MIN_BOXES_PER_RANGE, (count + ranges - 1) / ranges));
+
+    size_t kept = 0;
+    for (size_t i = 0; i < count; ++i) {
+        visible[kept] = visible[i];
+        kept += !occludedFlags[i];
+    }
+    visible.resize(kept);
+    return kept;
+}
+
+} // namespace Common
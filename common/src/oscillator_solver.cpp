@@ -0,0 +1,126 @@
+#include "oscillator_solver.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Common {
+
+namespace {
+
+// Blocks of 4 oscillators per thread range at the least, so small sculptures
+// stay on one thread and ranges never share a cache line
+const size_t MIN_BLOCKS_PER_RANGE = 1024;
+
+} // namespace
+
+void OscillatorSolver::resize(size_t newCount) {
+    count = newCount;
+    const size_t padded = (count + 3) & ~size_t(3);
+    for (std::vector<float>* array : { &angle, &velocity, &previousAngle, &stiffness, &driveSin, &driveCos })
+        array->assign(padded, 0.0f);
+    elapsed = 0.0;
+    lastDt = 0.0f;
+}
+
+void OscillatorSolver::set(size_t i, float oscillatorStiffness, float driveAmplitude, float drivePhase,
+                           float initialAngle, float initialVelocity) {
+    stiffness[i] = oscillatorStiffness;
+    driveSin[i] = driveAmplitude * std::sin(drivePhase);
+    driveCos[i] = driveAmplitude * std::cos(drivePhase);
+    angle[i] = initialAngle;
+    velocity[i] = initialVelocity;
+    previousAngle[i] = initialAngle - initialVelocity * lastDt;
+}
+
+void OscillatorSolver::setIntegrator(Integrator value) {
+    if (value == integrator)
+        return;
+    // Carry the motion over; before the first step the velocities are still current
+    if (lastDt > 0.0f) {
+        for (size_t i = 0; i < count; ++i) {
+            if (value == Integrator::Verlet)
+                previousAngle[i] = angle[i] - velocity[i] * lastDt;
+            else
+                velocity[i] = (angle[i] - previousAngle[i]) / lastDt;
+        }
+    }
+    integrator = value;
+}
+
+template <Integrator I>
+void OscillatorSolver::stepBlocks(size_t begin, size_t end, float dt, float sinDrive, float cosDrive, float* out) {
+    using simd::float4;
+    const float4 step(dt);
+    const float4 negDamping(-damping);
+    const float4 sinD(sinDrive), cosD(cosDrive);
+    // Verlet with a changing step: scale the carried displacement by dt / lastDt
+    const float4 carry(lastDt > 0.0f ? dt / lastDt : 1.0f);
+    const float4 invLastDt(lastDt > 0.0f ? 1.0f / lastDt : 0.0f);
+    const float4 step2(dt * dt);
+    const size_t fullBlocks = count / 4;
+
+    for (size_t block = begin; block < end; ++block) {
+        const size_t i = block * 4;
+        const float4 theta = float4::load(&angle[i]);
+        const float4 k = float4::load(&stiffness[i]);
+        const float4 drive = madd(float4::load(&driveSin[i]), cosD, float4::load(&driveCos[i]) * sinD);
+
+        float4 next;
+        if (I == Integrator::SemiImplicitEuler) {
+            float4 omega = float4::load(&velocity[i]);
+            const float4 accel = madd(negDamping, omega, drive) - k * simd::sin(theta);
+            omega = madd(accel, step, omega);
+            next = madd(omega, step, theta);
+            omega.store(&velocity[i]);
+        } else {
+            const float4 displacement = theta - float4::load(&previousAngle[i]);
+            const float4 accel = madd(negDamping, displacement * invLastDt, drive) - k * simd::sin(theta);
+            next = theta + madd(displacement, carry, accel * step2);
+            theta.store(&previousAngle[i]);
+        }
+        next.store(&angle[i]);
+
+        if (out) {
+            if (block < fullBlocks) {
+                next.store(out + i);
+            } else {
+                for (size_t j = i; j < count; ++j)
+                    out[j] = angle[j];
+            }
+        }
+    }
+}
+
+void OscillatorSolver::step(float dt, float* out, unsigned int threads) {
+    if (count == 0)
+        return;
+
+    // A Verlet run needs a previous position; take it from the velocities
+    if (integrator == Integrator::Verlet && lastDt <= 0.0f) {
+        for (size_t i = 0; i < count; ++i)
+            previousAngle[i] = angle[i] - velocity[i] * dt;
+        lastDt = dt;
+    }
+
+    // The drive's time term is shared, so its sin and cos are taken once here
+    const double drivePhase = driveFrequency * elapsed;
+    const float sinDrive = (float)std::sin(drivePhase);
+    const float cosDrive = (float)std::cos(drivePhase);
+
+    const size_t blocks = angle.size() / 4;
+    const size_t ranges = threads ? threads : workerCount();
+    const size_t minChunk = std::max(MIN_BLOCKS_PER_RANGE, (blocks + ranges - 1) / ranges);
+    parallelFor(blocks, [&](size_t begin, size_t end) {
+        if (integrator == Integrator::SemiImplicitEuler)
+            stepBlocks<Integrator::SemiImplicitEuler>(begin, end, dt, sinDrive, cosDrive, out);
+        else
+            stepBlocks<Integrator::Verlet>(begin, end, dt, sinDrive, cosDrive, out);
+    }, minChunk);
+
+    elapsed += dt;
+    lastDt = dt;
+}
+
+} // namespace Common
@@ -0,0 +1,65 @@
+#include "parallel.hpp"
+#include "job_system.hpp"
+
+#include <algorithm>
+#include <thread>
+
+namespace Common {
+
+namespace {
+
+// Pieces per worker at the finest when the caller sets no minimum, so a body
+// over single items is not called once per item
+const size_t PIECES_PER_WORKER = 16;
+
+struct RangeTask {
+    const std::function<void(size_t begin, size_t end)>* body;
+    size_t grain;
+    JobCounter* counter;
+};
+
+// Lazy binary splitting: while this thread's queue is empty (every range it
+// split off has been stolen) hand the back half of what is left to the job
+// system; otherwise run the next grain and look again. Splits fall on whole
+// grains, so there are never more than count / grain pieces.
+void runRange(const RangeTask& task, size_t begin, size_t end) {
+    while (end - begin >= 2 * task.grain) {
+        if (!hasQueuedJobs()) {
+            const size_t grains = (end - begin) / task.grain;
+            const size_t middle = begin + (grains / 2) * task.grain;
+            submitJob([task, middle, end] { runRange(task, middle, end); }, task.counter);
+            end = middle;
+        } else {
+            (*task.body)(begin, begin + task.grain);
+            begin += task.grain;
+        }
+    }
+    if (begin < end)
+        (*task.body)(begin, end);
+}
+
+} // namespace
+
+unsigned int workerCount() {
+    unsigned int n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+void parallelFor(size_t count, const std::function<void(size_t begin, size_t end)>& body, size_t minChunk) {
+    if (count == 0)
+        return;
+
+    const size_t grain = std::max<size_t>({ minChunk, 1, count / ((size_t)workerCount() * PIECES_PER_WORKER) });
+    if (workerCount() <= 1 || count < 2 * grain) {
+        body(0, count);
+        return;
+    }
+
+    // The calling thread works through the range too, then helps with
+    // whatever is left until every piece has run
+    JobCounter counter;
+    runRange({ &body, grain, &counter }, 0, count);
+    waitForCounter(counter);
+}
+
+} // namespace Common
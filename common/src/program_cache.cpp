@@ -0,0 +1,296 @@
+#include "program_cache.hpp"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <system_error>
+#include <vector>
+
+namespace Common {
+
+namespace {
+
+const char kMagic[4] = { 'G', 'L', 'P', 'B' };
+const uint32_t kVersion = 1;
+
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash;
+    uint32_t binaryFormat;
+    uint32_t driverLength;
+    uint64_t binaryLength;
+};
+
+// 64-bit FNV-1a over both stages; the separator keeps "ab"+"c" and "a"+"bc" apart
+uint64_t hashSources(const std::string& vertexSource, const std::string& fragmentSource) {
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&](const std::string& text) {
+        for (char c : text) {
+            hash ^= (uint8_t)c;
+            hash *= 1099511628211ull;
+        }
+        hash ^= 0xFF;
+        hash *= 1099511628211ull;
+    };
+    mix(vertexSource);
+    mix(fragmentSource);
+    return hash;
+}
+
+std::string glString(GLenum name) {
+    const GLubyte* value = glGetString(name);
+    return value ? reinterpret_cast<const char*>(value) : "";
+}
+
+unsigned int compileStage(GLenum type, const std::string& source) {
+    const char* code = source.c_str();
+    unsigned int shader = glCreateShader(type);
+    glShaderSource(shader, 1, &code, nullptr);
+    glCompileShader(shader);
+    return shader;
+}
+
+void checkStage(unsigned int shader, const char* label) {
+    int success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char infoLog[1024];
+        glGetShaderInfoLog(shader, 1024, nullptr, infoLog);
+        std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << label << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+    }
+}
+
+bool linked(unsigned int program) {
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    return success != 0;
+}
+
+} // namespace
+
+PendingProgram beginProgram(const ProgramSource& source, bool retrievable) {
+    PendingProgram pending;
+    pending.vertex = compileStage(GL_VERTEX_SHADER, source.vertex);
+    pending.fragment = compileStage(GL_FRAGMENT_SHADER, source.fragment);
+
+    pending.program = glCreateProgram();
+    glAttachShader(pending.program, pending.vertex);
+    glAttachShader(pending.program, pending.fragment);
+    if (retrievable)
+        glProgramParameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(pending.program);
+    return pending;
+}
+
+bool programReady(const PendingProgram& pending) {
+    if (!parallelCompileSupported())
+        return true;
+    int complete = GL_TRUE;
+    glGetProgramiv(pending.program, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete == GL_TRUE;
+}
+
+bool parallelCompileSupported() {
+    return GLAD_GL_KHR_parallel_shader_compile != 0;
+}
+
+bool setShaderCompilerThreads(unsigned int count) {
+    if (!parallelCompileSupported())
+        return false;
+    glMaxShaderCompilerThreadsKHR(count);
+    return true;
+}
+
+unsigned int finishProgram(PendingProgram& pending) {
+    unsigned int program = pending.program;
+    if (!linked(program)) {
+        checkStage(pending.vertex, "VERTEX");
+        checkStage(pending.fragment, "FRAGMENT");
+        char infoLog[1024];
+        glGetProgramInfoLog(program, 1024, nullptr, infoLog);
+        std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: PROGRAM\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+        glDeleteProgram(program);
+        program = 0;
+    }
+    glDeleteShader(pending.vertex);
+    glDeleteShader(pending.fragment);
+    pending = PendingProgram();
+    return program;
+}
+
+void cancelProgram(PendingProgram& pending) {
+    // Deleting a program the driver is still compiling is allowed; it is
+    // freed once the compile thread lets go of it
+    glDeleteProgram(pending.program);
+    glDeleteShader(pending.vertex);
+    glDeleteShader(pending.fragment);
+    pending = PendingProgram();
+}
+
+unsigned int compileProgram(const std::string& vertexSource, const std::string& fragmentSource,
+                            bool retrievable) {
+    PendingProgram pending = beginProgram({ vertexSource, fragmentSource }, retrievable);
+    return finishProgram(pending);
+}
+
+ProgramCache::ProgramCache(std::string directory) : directory(std::move(directory)) {
+}
+
+bool ProgramCache::available() {
+    if (supported < 0) {
+        // Core since 4.1; 3.3 contexts need ARB_get_program_binary, and some
+        // drivers expose the entry points but no binary formats
+        GLint formats = 0;
+        if (glGetProgramBinary && glProgramBinary && glProgramParameteri)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        supported = formats > 0 ? 1 : 0;
+
+        driver = glString(GL_VENDOR) + "|" + glString(GL_RENDERER) + "|" + glString(GL_VERSION);
+
+        std::error_code error;
+        if (supported && !std::filesystem::create_directories(directory, error) && error) {
+            std::cout << "ERROR::PROGRAM_CACHE::CANNOT_CREATE_DIRECTORY: " << directory << std::endl;
+            supported = 0;
+        }
+    }
+    return supported == 1;
+}
+
+unsigned int ProgramCache::link(const std::string& vertexSource, const std::string& fragmentSource) {
+    return linkAll({ { vertexSource, fragmentSource } })[0];
+}
+
+std::vector<unsigned int> ProgramCache::linkAll(const std::vector<ProgramSource>& sources) {
+    std::vector<unsigned int> programs(sources.size(), 0);
+    std::vector<PendingProgram> pending(sources.size());
+    for (size_t i = 0; i < sources.size(); ++i) {
+        programs[i] = load(sources[i]);
+        if (!programs[i])
+            pending[i] = beginProgram(sources[i], retrievable());
+    }
+
+    for (size_t i = 0; i < sources.size(); ++i) {
+        if (!pending[i].program)
+            continue;
+        programs[i] = finishProgram(pending[i]);
+        if (programs[i])
+            store(sources[i], programs[i]);
+    }
+    return programs;
+}
+
+unsigned int ProgramCache::load(const ProgramSource& source) {
+    if (!available())
+        return 0;
+    const uint64_t sourceHash = hashSources(source.vertex, source.fragment);
+    unsigned int program = loadBinary(binaryPath(sourceHash), sourceHash);
+    if (program)
+        ++hitCount;
+    else
+        ++missCount;
+    return program;
+}
+
+void ProgramCache::store(const ProgramSource& source, unsigned int program) {
+    if (!available() || !program)
+        return;
+    const uint64_t sourceHash = hashSources(source.vertex, source.fragment);
+    storeBinary(binaryPath(sourceHash), sourceHash, program);
+}
+
+bool ProgramCache::retrievable() {
+    return available();
+}
+
+std::string ProgramCache::binaryPath(uint64_t sourceHash) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.glbin", (unsigned long long)sourceHash);
+    return directory + "/" + name;
+}
+
+unsigned int ProgramCache::loadBinary(const std::string& path, uint64_t sourceHash) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return 0;
+
+    // Anything that does not match exactly is a miss; the file gets rewritten
+    FileHeader header = {};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || !std::equal(kMagic, kMagic + 4, header.magic) || header.version != kVersion ||
+        header.sourceHash != sourceHash || header.driverLength != driver.size())
+        return 0;
+
+    std::string fileDriver(header.driverLength, '\0');
+    file.read(&fileDriver[0], header.driverLength);
+    if (!file || fileDriver != driver)
+        return 0;
+
+    // The binary must be exactly the rest of the file, so a corrupt length
+    // is a miss rather than a huge allocation
+    const std::streampos binaryStart = file.tellg();
+    file.seekg(0, std::ios::end);
+    const std::streamoff remaining = file.tellg() - binaryStart;
+    if (!file || remaining < 0 || header.binaryLength != (uint64_t)remaining ||
+        header.binaryLength > (uint64_t)std::numeric_limits<GLsizei>::max())
+        return 0;
+    file.seekg(binaryStart);
+
+    std::vector<char> binary(header.binaryLength);
+    file.read(binary.data(), binary.size());
+    if (!file)
+        return 0;
+
+    // The driver may still refuse a binary it wrote (e.g. a changed GPU
+    // configuration behind the same strings); that is reported as a link failure
+    unsigned int program = glCreateProgram();
+    glProgramBinary(program, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+    if (!linked(program)) {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void ProgramCache::storeBinary(const std::string& path, uint64_t sourceHash, unsigned int program) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    FileHeader header = {};
+    std::copy(kMagic, kMagic + 4, header.magic);
+    header.version = kVersion;
+    header.sourceHash = sourceHash;
+    header.binaryFormat = format;
+    header.driverLength = (uint32_t)driver.size();
+    header.binaryLength = (uint64_t)length;
+
+    // Write next to the target and rename, so a crash never leaves a torn file
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(driver.data(), driver.size());
+        file.write(binary.data(), length);
+        if (!file.good()) {
+            std::cout << "ERROR::PROGRAM_CACHE::CANNOT_WRITE: " << temporary << std::endl;
+            return;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error)
+        std::cout << "ERROR::PROGRAM_CACHE::CANNOT_WRITE: " << path << std::endl;
+}
+
+} // namespace Common
@@ -0,0 +1,268 @@
+#include "render_queue.hpp"
+#include "gl_state.hpp"
+#include "parallel.hpp"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace Common {
+
+namespace {
+
+uint64_t depthBits(float depth) {
+    depth = std::min(std::max(depth, 0.0f), 1.0f);
+    return (uint64_t)(depth * 0xFFFFFF);
+}
+
+// Stable LSD radix sort on the 64-bit key, one byte per pass. All eight
+// histograms come from a single read of the keys, and a pass whose byte is
+// the same for every key (common in the high pass/program bytes) is skipped.
+template <typename Item>
+void radixSort(std::vector<Item>& items, std::vector<Item>& scratch) {
+    const size_t count = items.size();
+    if (count < 2)
+        return;
+
+    size_t histograms[8][256] = {};
+    for (const Item& item : items) {
+        for (int byte = 0; byte < 8; ++byte)
+            histograms[byte][(item.key >> (byte * 8)) & 0xFF]++;
+    }
+
+    scratch.resize(count);
+    for (int byte = 0; byte < 8; ++byte) {
+        size_t* histogram = histograms[byte];
+        if (histogram[(items[0].key >> (byte * 8)) & 0xFF] == count)
+            continue;
+
+        size_t offset = 0;
+        for (int bucket = 0; bucket < 256; ++bucket) {
+            size_t bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+        for (const Item& item : items)
+            scratch[histogram[(item.key >> (byte * 8)) & 0xFF]++] = item;
+        items.swap(scratch);
+    }
+}
+
+} // namespace
+
+bool multiDrawIndirectSupported() {
+    return GLAD_GL_VERSION_4_3 ||
+           (GLAD_GL_ARB_draw_indirect && GLAD_GL_ARB_multi_draw_indirect && GLAD_GL_ARB_base_instance);
+}
+
+uint64_t makeSortKey(uint8_t pass, uint32_t program, uint32_t material, float depth) {
+    return ((uint64_t)pass << 56) | ((uint64_t)(program & 0xFFFF) << 40) |
+           ((uint64_t)(material & 0xFFFF) << 24) | depthBits(depth);
+}
+
+uint64_t makeBackToFrontKey(uint8_t pass, float depth, uint32_t program, uint32_t material) {
+    return ((uint64_t)pass << 56) | ((0xFFFFFF - depthBits(depth)) << 32) |
+           ((uint64_t)(program & 0xFFFF) << 16) | (uint64_t)(material & 0xFFFF);
+}
+
+void RenderQueue::beginFrame() {
+    for (size_t i = 0; i < usedLists; ++i) {
+        lists[i].packets.clear();
+        lists[i].objects.clear();
+    }
+    usedLists = 0;
+}
+
+void RenderQueue::record(size_t count, const std::function<void(CommandList&, size_t, size_t)>& body,
+                         size_t minChunk) {
+    if (count == 0)
+        return;
+
+    // Fixed chunks, each with its own list, so the merged order is the same
+    // whichever thread ran which chunk
+    minChunk = std::max<size_t>(minChunk, 1);
+    const size_t chunks = std::min<size_t>((size_t)workerCount() * 4, (count + minChunk - 1) / minChunk);
+    const size_t first = usedLists;
+    usedLists += chunks;
+    if (lists.size() < usedLists)
+        lists.resize(usedLists);
+
+    parallelFor(chunks, [&](size_t begin, size_t end) {
+        for (size_t chunk = begin; chunk < end; ++chunk)
+            body(lists[first + chunk], count * chunk / chunks, count * (chunk + 1) / chunks);
+    });
+}
+
+size_t RenderQueue::size() const {
+    size_t total = 0;
+    for (size_t i = 0; i < usedLists; ++i)
+        total += lists[i].size();
+    return total;
+}
+
+size_t RenderQueue::submit(UniformBuffer<ObjectBlock>& objectUniforms) {
+    auto submitStart = std::chrono::steady_clock::now();
+    items.clear();
+    for (size_t list = 0; list < usedLists; ++list) {
+        const std::vector<DrawPacket>& packets = lists[list].packets;
+        for (size_t packet = 0; packet < packets.size(); ++packet)
+            items.push_back({ packets[packet].key, (uint32_t)list, (uint32_t)packet });
+    }
+    radixSort(items, scratch);
+    lastStats = RenderQueueStats();
+    lastStats.packets = items.size();
+    lastStats.sortMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - submitStart).count();
+
+    // Matrices and indirect commands for the instanced packets in draw order,
+    // so every run of them is a contiguous range of both buffers
+    GLStateCache& gl = glState();
+    const bool multiDraw = multiDrawEnabled && multiDrawIndirectSupported();
+    instanceModels.clear();
+    indirectCommands.clear();
+    instanceModelPrograms.clear();
+    for (const SortItem& item : items) {
+        DrawPacket& packet = lists[item.list].packets[item.packet];
+        if (!packet.instanced)
+            continue;
+        if (!readsInstanceModel(packet.program)) {
+            packet.instanced = false;
+            lastStats.notInstanced++;
+            continue;
+        }
+        indirectCommands.push_back({ packet.indexCount, 1, packet.firstIndex, packet.baseVertex,
+                                     (uint32_t)instanceModels.size() });
+        instanceModels.push_back(lists[item.list].objects[item.packet].model);
+    }
+    if (!instanceModels.empty()) {
+        if (!instanceBuffer)
+            glGenBuffers(1, &instanceBuffer);
+        gl.bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, instanceModels.size() * sizeof(glm::mat4), instanceModels.data(), GL_STREAM_DRAW);
+        if (multiDraw) {
+            if (!indirectBuffer)
+                glGenBuffers(1, &indirectBuffer);
+            gl.bindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, indirectCommands.size() * sizeof(IndirectCommand),
+                         indirectCommands.data(), GL_STREAM_DRAW);
+        }
+    }
+
+    size_t command = 0;
+    for (size_t i = 0; i < items.size();) {
+        const CommandList& list = lists[items[i].list];
+        const DrawPacket& packet = list.packets[items[i].packet];
+
+        gl.useProgram(packet.program);
+        if (const Material* material = packet.material) {
+            for (unsigned int unit = 0; unit < material->textureCount; ++unit)
+                gl.bindTexture(unit, material->textureTarget, material->textures[unit]);
+        }
+        gl.bindVertexArray(packet.vertexArray);
+
+        if (!packet.instanced) {
+            objectUniforms.upload(list.objects[items[i].packet]);
+            const void* indices = (const void*)(packet.firstIndex * sizeof(unsigned int));
+            if (packet.instanceCount > 1)
+                glDrawElementsInstancedBaseVertex(packet.mode, (GLsizei)packet.indexCount, GL_UNSIGNED_INT, indices,
+                                                  (GLsizei)packet.instanceCount, packet.baseVertex);
+            else
+                glDrawElementsBaseVertex(packet.mode, (GLsizei)packet.indexCount, GL_UNSIGNED_INT, indices,
+                                         packet.baseVertex);
+            lastStats.drawCalls++;
+            ++i;
+            continue;
+        }
+
+        // The run continues while nothing but the mesh range changes
+        size_t end = i + 1;
+        while (end < items.size()) {
+            const DrawPacket& next = lists[items[end].list].packets[items[end].packet];
+            if (!next.instanced || next.program != packet.program || next.material != packet.material ||
+                next.vertexArray != packet.vertexArray || next.mode != packet.mode)
+                break;
+            ++end;
+        }
+        drawInstanced(command, end - i, packet.mode, multiDraw);
+        command += end - i;
+        i = end;
+    }
+    lastStats.submitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - submitStart).count();
+    return lastStats.drawCalls;
+}
+
+void RenderQueue::drawInstanced(size_t first, size_t count, unsigned int mode, bool multiDraw) {
+    // Point the bound VAO's model matrix attribute at an instance's matrix
+    auto pointModel = [](size_t instance) {
+        for (unsigned int column = 0; column < 4; ++column) {
+            const unsigned int location = INSTANCE_MODEL_LOCATION + column;
+            glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                                  (const void*)(instance * sizeof(glm::mat4) + column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(location, 1);
+            glEnableVertexAttribArray(location);
+        }
+    };
+
+    GLStateCache& gl = glState();
+    gl.bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    if (multiDraw) {
+        // Each command's base instance selects its matrix
+        pointModel(0);
+        gl.bindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, (const void*)(first * sizeof(IndirectCommand)),
+                                    (GLsizei)count, 0);
+        lastStats.drawCalls++;
+        lastStats.multiDraws++;
+        return;
+    }
+
+    // No base instance before GL 4.2, so the attribute is moved per draw instead
+    for (size_t i = first; i < first + count; ++i) {
+        const IndirectCommand& command = indirectCommands[i];
+        pointModel(command.baseInstance);
+        glDrawElementsInstancedBaseVertex(mode, (GLsizei)command.count, GL_UNSIGNED_INT,
+                                          (const void*)(command.firstIndex * sizeof(unsigned int)), 1,
+                                          command.baseVertex);
+        lastStats.drawCalls++;
+    }
+}
+
+// Whether program has an active mat4 attribute at INSTANCE_MODEL_LOCATION.
+// Asked once per program per submit.
+bool RenderQueue::readsInstanceModel(unsigned int program) {
+    for (const auto& checked : instanceModelPrograms) {
+        if (checked.first == program)
+            return checked.second;
+    }
+
+    bool reads = false;
+    GLint attributes = 0;
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &attributes);
+    for (GLint i = 0; i < attributes && !reads; ++i) {
+        char name[256];
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveAttrib(program, (GLuint)i, sizeof(name), nullptr, &size, &type, name);
+        reads = type == GL_FLOAT_MAT4 && glGetAttribLocation(program, name) == (GLint)INSTANCE_MODEL_LOCATION;
+    }
+    instanceModelPrograms.push_back({ program, reads });
+
+    if (!reads && std::find(reportedPrograms.begin(), reportedPrograms.end(), program) == reportedPrograms.end()) {
+        std::cout << "ERROR::RENDER_QUEUE::NO_INSTANCE_MODEL: program " << program << " has no mat4 at location "
+                  << INSTANCE_MODEL_LOCATION << "; its instanced packets are drawn one at a time" << std::endl;
+        reportedPrograms.push_back(program);
+    }
+    return reads;
+}
+
+void RenderQueue::destroy() {
+    GLStateCache& gl = glState();
+    glDeleteBuffers(1, &instanceBuffer);
+    glDeleteBuffers(1, &indirectBuffer);
+    gl.bufferDeleted(instanceBuffer);
+    gl.bufferDeleted(indirectBuffer);
+    instanceBuffer = indirectBuffer = 0;
+}
+
+} // namespace Common
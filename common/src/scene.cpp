@@ -0,0 +1,39 @@
+#include "scene.hpp"
+
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+
+namespace Common {
+
+glm::mat4 worldMatrix(const Transform& transform) {
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), transform.position);
+    model = glm::rotate(model, transform.spinAngle, transform.spinAxis);
+    return glm::scale(model, glm::vec3(transform.scale));
+}
+
+Transform interpolate(const Transform& a, const Transform& b, float t) {
+    Transform result = b;
+    result.position = glm::mix(a.position, b.position, t);
+    result.scale = glm::mix(a.scale, b.scale, t);
+    if (std::fabs(b.spinAngle - a.spinAngle) < glm::pi<float>() && a.spinAxis == b.spinAxis)
+        result.spinAngle = glm::mix(a.spinAngle, b.spinAngle, t);
+    return result;
+}
+
+void updateSpin(World& world, float time) {
+    world.each<Transform, Spin>([time](size_t count, Transform* transforms, Spin* spins) {
+        for (size_t i = 0; i < count; ++i)
+            transforms[i].spinAngle = spins[i].enabled ? spins[i].speed * time : 0.0f;
+    });
+}
+
+void updateWorldMatrices(World& world, unsigned int threads) {
+    world.parallelEach<Transform, WorldMatrix>([](size_t count, Transform* transforms, WorldMatrix* matrices) {
+        for (size_t i = 0; i < count; ++i)
+            matrices[i].model = worldMatrix(transforms[i]);
+    }, threads);
+}
+
+} // namespace Common
@@ -0,0 +1,280 @@
+#include "shader_permutations.hpp"
+#include "uniform_blocks.hpp"
+#include "gl_state.hpp"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace Common {
+
+namespace {
+
+// File name from `#include "name"`, or empty if the line is not an include
+std::string includeTarget(const std::string& line) {
+    size_t start = line.find_first_not_of(" \t");
+    if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+        return "";
+    size_t open = line.find('"', start + 8);
+    size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+    if (close == std::string::npos)
+        return "";
+    return line.substr(open + 1, close - open - 1);
+}
+
+bool expandFile(const std::filesystem::path& path, std::string& out, std::vector<std::string>& files) {
+    const std::string key = path.lexically_normal().generic_string();
+    if (std::find(files.begin(), files.end(), key) != files.end())
+        return true;
+
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << key << std::endl;
+        return false;
+    }
+    const size_t index = files.size();
+    files.push_back(key);
+    if (index > 0)
+        out += "#line 1 " + std::to_string(index) + "\n";
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        const std::string target = includeTarget(line);
+        if (target.empty()) {
+            out += line;
+            out += '\n';
+            continue;
+        }
+        if (!expandFile(path.parent_path() / target, out, files))
+            return false;
+        out += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(index) + "\n";
+    }
+    return true;
+}
+
+} // namespace
+
+bool loadShaderSource(const std::string& path, std::string& source, std::vector<std::string>* files) {
+    std::vector<std::string> included;
+    source.clear();
+    bool ok = expandFile(path, source, included);
+    if (files)
+        *files = included;
+    return ok;
+}
+
+std::string injectDefines(const std::string& source, uint32_t features,
+                          const std::vector<std::string>& names) {
+    // #version has to stay the first directive, so the header goes right after it
+    size_t version = source.find("#version");
+    size_t insertAt = version == std::string::npos ? 0 : source.find('\n', version);
+    insertAt = insertAt == std::string::npos ? source.size() : insertAt + 1;
+    const int nextLine = (int)std::count(source.begin(), source.begin() + insertAt, '\n') + 1;
+
+    std::string header;
+    for (size_t bit = 0; bit < names.size(); ++bit) {
+        if (features & (1u << bit))
+            header += "#define " + names[bit] + " 1\n";
+    }
+    header += "#line " + std::to_string(nextLine) + " 0\n";
+    return source.substr(0, insertAt) + header + source.substr(insertAt);
+}
+
+ShaderPermutations::ShaderPermutations(std::string vertexPath, std::string fragmentPath,
+                                       std::vector<std::string> featureNames, ProgramCache* cache)
+    : vertexPath(std::move(vertexPath)), fragmentPath(std::move(fragmentPath)),
+      featureNames(std::move(featureNames)), cache(cache) {
+}
+
+ShaderPermutations::~ShaderPermutations() {
+    clear();
+}
+
+void ShaderPermutations::clear() {
+    for (PendingVariant& pending : pendingVariants)
+        glDeleteProgram(finishProgram(pending.program));
+    pendingVariants.clear();
+    for (auto& entry : variants)
+        glDeleteProgram(entry.second.program);
+    variants.clear();
+}
+
+bool ShaderPermutations::load() {
+    ProgramSource source;
+    std::vector<std::string> vertexFiles, fragmentFiles;
+    if (!loadShaderSource(vertexPath, source.vertex, &vertexFiles) ||
+        !loadShaderSource(fragmentPath, source.fragment, &fragmentFiles))
+        return false;
+
+    expanded = std::move(source);
+    sourceFiles = vertexFiles;
+    for (const std::string& file : fragmentFiles) {
+        if (std::find(sourceFiles.begin(), sourceFiles.end(), file) == sourceFiles.end())
+            sourceFiles.push_back(file);
+    }
+    return true;
+}
+
+bool ShaderPermutations::reload() {
+    if (!load())
+        return false;
+
+    // Compiles of the previous source are stale; their variants are rebuilt below
+    std::vector<uint32_t> rebuild;
+    for (PendingVariant& pending : pendingVariants) {
+        cancelProgram(pending.program);
+        rebuild.push_back(pending.features);
+    }
+    pendingVariants.clear();
+    for (const auto& entry : variants)
+        rebuild.push_back(entry.first);
+    std::sort(rebuild.begin(), rebuild.end());
+    rebuild.erase(std::unique(rebuild.begin(), rebuild.end()), rebuild.end());
+    submitVariants(rebuild, true);
+    return true;
+}
+
+void ShaderPermutations::setLinkCallback(LinkCallback callback) {
+    onLink = std::move(callback);
+}
+
+ProgramSource ShaderPermutations::sourceFor(uint32_t features) const {
+    return { injectDefines(expanded.vertex, features, featureNames),
+             injectDefines(expanded.fragment, features, featureNames) };
+}
+
+void ShaderPermutations::finishVariant(uint32_t features, unsigned int program) {
+    Variant& variant = variants[features];
+    if (!program) {
+        std::cout << "ERROR::SHADER::VARIANT_FAILED: features 0x" << std::hex << features << std::dec
+                  << (variant.program ? ", keeping the previous program" : "") << std::endl;
+        return;
+    }
+    // A reload replaces the program in place, so references stay valid
+    if (variant.program && variant.program != program)
+        glDeleteProgram(variant.program);
+    variant.program = program;
+    variant.features = features;
+    variant.uniforms.reflect(program);
+    bindUniformBlocks(program);
+    if (onLink) {
+        glState().useProgram(program);
+        onLink(variant);
+    }
+}
+
+bool ShaderPermutations::known(uint32_t features) const {
+    if (variants.count(features))
+        return true;
+    for (const PendingVariant& pending : pendingVariants) {
+        if (pending.features == features)
+            return true;
+    }
+    return false;
+}
+
+unsigned int ShaderPermutations::finishPending(PendingVariant& pending) {
+    unsigned int program = finishProgram(pending.program);
+    if (cache)
+        cache->store(pending.source, program);
+    return program;
+}
+
+void ShaderPermutations::submit(const std::vector<uint32_t>& requested) {
+    submitVariants(requested, false);
+}
+
+void ShaderPermutations::submitVariants(const std::vector<uint32_t>& requested, bool rebuild) {
+    for (uint32_t features : requested) {
+        if (!rebuild && known(features))
+            continue;
+
+        PendingVariant pending;
+        pending.features = features;
+        pending.source = sourceFor(features);
+        unsigned int program = cache ? cache->load(pending.source) : 0;
+        if (program) {
+            finishVariant(features, program);
+            continue;
+        }
+        pending.program = beginProgram(pending.source, cache && cache->retrievable());
+        pendingVariants.push_back(std::move(pending));
+    }
+}
+
+size_t ShaderPermutations::update() {
+    const bool polling = parallelCompileSupported();
+    for (size_t i = 0; i < pendingVariants.size();) {
+        PendingVariant& pending = pendingVariants[i];
+        if (polling && !programReady(pending.program)) {
+            ++i;
+            continue;
+        }
+        finishVariant(pending.features, finishPending(pending));
+        pendingVariants.erase(pendingVariants.begin() + i);
+        if (!polling)
+            break;
+    }
+    return pendingVariants.size();
+}
+
+bool ShaderPermutations::warmUp(const std::vector<uint32_t>& requested) {
+    // One batch: every compile is issued before the first status query
+    submit(requested);
+    for (PendingVariant& pending : pendingVariants)
+        finishVariant(pending.features, finishPending(pending));
+    pendingVariants.clear();
+
+    for (uint32_t features : requested) {
+        if (!variants[features].program)
+            return false;
+    }
+    return true;
+}
+
+const ShaderPermutations::Variant& ShaderPermutations::variant(uint32_t features) {
+    auto found = variants.find(features);
+    if (found != variants.end())
+        return found->second;
+
+    ++lateCompileCount;
+    std::cout << "WARNING::SHADER::LATE_COMPILE: features 0x" << std::hex << features << std::dec
+              << " was not ready" << std::endl;
+    for (size_t i = 0; i < pendingVariants.size(); ++i) {
+        if (pendingVariants[i].features == features) {
+            finishVariant(features, finishPending(pendingVariants[i]));
+            pendingVariants.erase(pendingVariants.begin() + i);
+            return variants[features];
+        }
+    }
+    submit({ features });
+    if (!variants.count(features)) {
+        finishVariant(features, finishPending(pendingVariants.back()));
+        pendingVariants.pop_back();
+    }
+    return variants[features];
+}
+
+const ShaderPermutations::Variant& ShaderPermutations::bestReady(uint32_t features) {
+    const Variant* best = nullptr;
+    int bestCount = -1;
+    for (const auto& entry : variants) {
+        if (!entry.second.program || (entry.first & ~features) != 0)
+            continue;
+        int count = 0;
+        for (uint32_t bits = entry.first; bits; bits &= bits - 1)
+            ++count;
+        if (count > bestCount) {
+            best = &entry.second;
+            bestCount = count;
+        }
+    }
+    return best ? *best : variant(features);
+}
+
+} // namespace Common
@@ -0,0 +1,424 @@
+#include "texture_streamer.hpp"
+#include "gl_state.hpp"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace Common {
+
+namespace {
+
+GLenum pixelFormat(uint32_t channels) {
+    switch (channels) {
+    case 1: return GL_RED;
+    case 2: return GL_RG;
+    case 3: return GL_RGB;
+    default: return GL_RGBA;
+    }
+}
+
+double nowMs() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+TextureStreamer::TextureStreamer(size_t budgetBytes, uint32_t tailSize, size_t maxPendingBytes)
+    : tailSize(tailSize), maxPendingBytes(maxPendingBytes) {
+    counters.budgetBytes = budgetBytes;
+}
+
+TextureStreamer::~TextureStreamer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (worker.joinable())
+        worker.join();
+}
+
+unsigned int TextureStreamer::load(const std::string& path) {
+    if (!worker.joinable())
+        worker = std::thread(&TextureStreamer::workerLoop, this);
+
+    // Level sizes first, then the data of the tail only
+    CookedTexture cooked;
+    if (!readCookedTexture(path, cooked, (size_t)-1) || cooked.levels.empty())
+        return 0;
+    size_t tail = cooked.levels.size() - 1;
+    while (tail > 0 && cooked.levels[tail - 1].width <= tailSize && cooked.levels[tail - 1].height <= tailSize)
+        --tail;
+    if (!readCookedTexture(path, cooked, tail))
+        return 0;
+
+    Entry entry;
+    entry.path = path;
+    entry.channels = cooked.channels;
+    entry.faces = cooked.faces;
+    entry.tailLevel = (int)tail;
+    entry.targetLevel = (int)tail;
+    entry.residentLevel = (int)tail;
+    entry.requestedLevel = (int)tail;
+    for (size_t level = 0; level < cooked.levels.size(); ++level)
+        entry.levelBytes.push_back(cooked.faceBytes(level) * cooked.faces);
+
+    const GLenum target = cooked.faces == 6 ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+    glGenTextures(1, &entry.texture);
+    glState().bindTexture(target, entry.texture);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, (GLint)cooked.levels.size() - 1);
+
+    size_t tailBytes = 0;
+    for (size_t level = cooked.levels.size(); level-- > tail;) {
+        uploadLevel(entry, (int)level, cooked.levels[level]);
+        tailBytes += cooked.levels[level].data.size();
+    }
+
+    std::cout << "Streaming texture: " << path << " (" << cooked.levels[tail].width << "x"
+              << cooked.levels[tail].height << " tail resident, " << tailBytes / 1024 << " KiB)" << std::endl;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        entry.lastVisibleFrame = frame;
+        entries.push_back(entry);
+        counters.residentBytes += tailBytes;
+    }
+    wake.notify_one();
+    return entry.texture;
+}
+
+void TextureStreamer::unload(unsigned int texture) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = std::find_if(entries.begin(), entries.end(),
+                               [&](const Entry& entry) { return entry.texture == texture; });
+        if (it == entries.end())
+            return;
+        counters.residentBytes -= chainBytes(*it, it->residentLevel);
+        entries.erase(it);
+        for (auto level = ready.begin(); level != ready.end();) {
+            if (level->texture == texture) {
+                pendingBytes -= level->data.data.size();
+                level = ready.erase(level);
+            } else {
+                ++level;
+            }
+        }
+    }
+    wake.notify_one();
+    glDeleteTextures(1, &texture);
+    glState().textureDeleted(texture);
+}
+
+void TextureStreamer::setCoverage(unsigned int texture, float coverage) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (Entry* entry = find(texture)) {
+        entry->coverage = coverage;
+        if (coverage > 0.0f)
+            entry->lastVisibleFrame = frame;
+    }
+}
+
+void TextureStreamer::setBudget(size_t budgetBytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.budgetBytes = budgetBytes;
+}
+
+void TextureStreamer::update(size_t maxBytes) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.evictionsThisFrame = 0;
+        rebalance();
+    }
+    wake.notify_one();
+
+    size_t uploaded = 0;
+    while (uploaded < maxBytes) {
+        ReadyLevel level;
+        Entry entry;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (ready.empty())
+                break;
+            level = std::move(ready.front());
+            ready.pop_front();
+            pendingBytes -= level.data.data.size();
+            const Entry* found = find(level.texture);
+            // Levels go in strictly finest-next; anything else was made stale by an eviction
+            if (!found || found->generation != level.generation || level.level != found->residentLevel - 1 ||
+                level.level < found->targetLevel)
+                continue;
+            entry = *found;
+        }
+        wake.notify_one();
+
+        uploadLevel(entry, level.level, level.data);
+        uploaded += level.data.data.size();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry* found = find(level.texture);
+        if (!found)
+            continue;
+        found->residentLevel = level.level;
+        counters.residentBytes += found->levelBytes[level.level];
+
+        if (found->reloadStartMs >= 0.0 && found->residentLevel <= found->targetLevel) {
+            counters.lastReloadMs = nowMs() - found->reloadStartMs;
+            reloadTotalMs += counters.lastReloadMs;
+            counters.reloads++;
+            counters.averageReloadMs = reloadTotalMs / counters.reloads;
+            found->reloadStartMs = -1.0;
+            found->evicted = false;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ++frame;
+}
+
+bool TextureStreamer::fullyResident() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const Entry& entry : entries)
+        if (entry.residentLevel > entry.targetLevel && !entry.failed)
+            return false;
+    return true;
+}
+
+int TextureStreamer::residentLevel(unsigned int texture) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    const Entry* entry = find(texture);
+    return entry ? entry->residentLevel : -1;
+}
+
+size_t TextureStreamer::residentBytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters.residentBytes;
+}
+
+TextureResidencyStats TextureStreamer::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+void TextureStreamer::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        // Next level to read: best coverage per byte across all textures
+        Entry* best = nullptr;
+        float bestScore = -1.0f;
+        if (pendingBytes < maxPendingBytes) {
+            for (Entry& entry : entries) {
+                if (entry.requestedLevel <= entry.targetLevel || entry.failed)
+                    continue;
+                const float score = (entry.coverage + 1e-3f) / (float)entry.levelBytes[entry.requestedLevel - 1];
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = &entry;
+                }
+            }
+        }
+
+        if (stopping)
+            return;
+        if (!best) {
+            wake.wait(lock);
+            continue;
+        }
+
+        ReadyLevel level;
+        level.texture = best->texture;
+        level.generation = best->generation;
+        level.level = --best->requestedLevel;
+        const std::string path = best->path;
+
+        lock.unlock();
+        const bool ok = readCookedLevel(path, (size_t)level.level, level.data);
+        lock.lock();
+
+        if (!ok) {
+            // Stop streaming this texture; it keeps whatever is already resident
+            std::cout << "ERROR::TEXTURE_STREAMER::LEVEL_READ_FAILED: " << path << " level " << level.level << std::endl;
+            if (Entry* entry = find(level.texture))
+                entry->failed = true;
+            continue;
+        }
+        Entry* entry = find(level.texture);
+        if (!entry || entry->generation != level.generation)
+            continue;
+        if (level.data.data.size() != entry->levelBytes[level.level]) {
+            // Rewritten since it was loaded, with another layout; a reload will pick it up
+            std::cout << "ERROR::TEXTURE_STREAMER::LEVEL_SIZE_MISMATCH: " << path << " level " << level.level
+                      << std::endl;
+            entry->failed = true;
+            continue;
+        }
+        pendingBytes += level.data.data.size();
+        ready.push_back(std::move(level));
+    }
+}
+
+TextureStreamer::Entry* TextureStreamer::find(unsigned int texture) {
+    for (Entry& entry : entries)
+        if (entry.texture == texture)
+            return &entry;
+    return nullptr;
+}
+
+const TextureStreamer::Entry* TextureStreamer::find(unsigned int texture) const {
+    for (const Entry& entry : entries)
+        if (entry.texture == texture)
+            return &entry;
+    return nullptr;
+}
+
+size_t TextureStreamer::chainBytes(const Entry& entry, int level) const {
+    size_t bytes = 0;
+    for (size_t i = (size_t)level; i < entry.levelBytes.size(); ++i)
+        bytes += entry.levelBytes[i];
+    return bytes;
+}
+
+// Bytes the current targets will occupy once streaming catches up
+size_t TextureStreamer::committedBytes() const {
+    size_t bytes = 0;
+    for (const Entry& entry : entries)
+        bytes += chainBytes(entry, std::min(entry.targetLevel, entry.residentLevel));
+    return bytes;
+}
+
+void TextureStreamer::rebalance() {
+    const size_t budget = counters.budgetBytes;
+    auto visible = [&](const Entry& entry) { return entry.lastVisibleFrame == frame; };
+    auto score = [](const Entry& entry, int level) {
+        return (entry.coverage + 1e-3f) / (float)entry.levelBytes[level];
+    };
+
+    // Over budget: drop the finest target level that matters least, preferring
+    // textures that are off screen, least recently seen first
+    size_t committed = committedBytes();
+    while (committed > budget) {
+        Entry* victim = nullptr;
+        for (Entry& entry : entries) {
+            if (entry.targetLevel >= entry.tailLevel)
+                continue;
+            if (!victim) {
+                victim = &entry;
+            } else if (visible(entry) != visible(*victim)) {
+                if (!visible(entry))
+                    victim = &entry;
+            } else if (!visible(entry) ? entry.lastVisibleFrame < victim->lastVisibleFrame
+                                       : score(entry, entry.targetLevel) < score(*victim, victim->targetLevel)) {
+                victim = &entry;
+            }
+        }
+        if (!victim)
+            break;
+        raiseTarget(*victim);
+        committed = committedBytes();
+    }
+
+    // Under budget: refine targets by coverage per byte. Visible textures may
+    // evict off-screen ones (LRU) to make room; off-screen ones only use slack.
+    std::vector<Entry*> blocked;
+    while (true) {
+        Entry* best = nullptr;
+        for (Entry& entry : entries) {
+            if (entry.targetLevel == 0 || entry.failed ||
+                std::find(blocked.begin(), blocked.end(), &entry) != blocked.end())
+                continue;
+            if (!best || score(entry, entry.targetLevel - 1) > score(*best, best->targetLevel - 1))
+                best = &entry;
+        }
+        if (!best)
+            break;
+
+        const size_t need = best->levelBytes[best->targetLevel - 1];
+        while (committed + need > budget && visible(*best)) {
+            Entry* victim = nullptr;
+            for (Entry& entry : entries) {
+                if (&entry == best || visible(entry) || entry.targetLevel >= entry.tailLevel)
+                    continue;
+                if (!victim || entry.lastVisibleFrame < victim->lastVisibleFrame)
+                    victim = &entry;
+            }
+            if (!victim)
+                break;
+            raiseTarget(*victim);
+            committed = committedBytes();
+        }
+        if (committed + need > budget) {
+            blocked.push_back(best);
+            continue;
+        }
+
+        best->targetLevel--;
+        committed += need;
+        if (best->evicted && best->reloadStartMs < 0.0)
+            best->reloadStartMs = nowMs();
+    }
+}
+
+// Give up the finest target level, freeing it in GL if it was resident
+void TextureStreamer::raiseTarget(Entry& entry) {
+    entry.targetLevel++;
+
+    if (entry.residentLevel < entry.targetLevel) {
+        const GLenum target = entry.faces == 6 ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+        const GLenum format = pixelFormat(entry.channels);
+        const int dropped = entry.residentLevel;
+        glState().bindTexture(target, entry.texture);
+        glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, entry.targetLevel);
+        // Respecify the level as empty so the driver can release its storage
+        for (unsigned int face = 0; face < entry.faces; ++face) {
+            const GLenum faceTarget = entry.faces == 6 ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+            glTexImage2D(faceTarget, dropped, format, 0, 0, 0, format, GL_UNSIGNED_BYTE, nullptr);
+        }
+        entry.residentLevel = entry.targetLevel;
+        entry.evicted = true;
+        counters.residentBytes -= entry.levelBytes[dropped];
+        counters.evictionsThisFrame++;
+        counters.totalEvictions++;
+    }
+
+    // Reads for levels past the new target are stale; drop them and start over
+    if (entry.requestedLevel < entry.targetLevel) {
+        entry.generation++;
+        entry.requestedLevel = entry.residentLevel;
+        for (auto level = ready.begin(); level != ready.end();) {
+            if (level->texture == entry.texture) {
+                pendingBytes -= level->data.data.size();
+                level = ready.erase(level);
+            } else {
+                ++level;
+            }
+        }
+    }
+}
+
+void TextureStreamer::uploadLevel(const Entry& entry, int level, const CookedLevel& data) {
+    const GLenum target = entry.faces == 6 ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+    const GLenum format = pixelFormat(entry.channels);
+    const size_t faceBytes = (size_t)data.width * data.height * entry.channels;
+
+    glState().bindTexture(target, entry.texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (unsigned int face = 0; face < entry.faces; ++face) {
+        const GLenum faceTarget = entry.faces == 6 ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+        glTexImage2D(faceTarget, level, format, data.width, data.height, 0, format, GL_UNSIGNED_BYTE,
+                     data.data.data() + face * faceBytes);
+    }
+    // Back to the GL default, which every other upload assumes
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    // Only sample levels that are resident
+    glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, level);
+}
+
+} // namespace Common
@@ -0,0 +1,33 @@
+#include "uniform_blocks.hpp"
+
+#include <iostream>
+
+namespace Common {
+
+namespace {
+
+bool bindBlock(unsigned int program, const char* name, unsigned int binding, size_t expectedSize) {
+    const GLuint index = glGetUniformBlockIndex(program, name);
+    if (index == GL_INVALID_INDEX)
+        return true;
+
+    GLint size = 0;
+    glGetActiveUniformBlockiv(program, index, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+    if ((size_t)size != expectedSize) {
+        std::cout << "ERROR::UNIFORM_BLOCK::SIZE_MISMATCH: " << name << " is " << size
+                  << " bytes in GLSL, " << expectedSize << " in C++" << std::endl;
+        return false;
+    }
+    glUniformBlockBinding(program, index, binding);
+    return true;
+}
+
+} // namespace
+
+bool bindUniformBlocks(unsigned int program) {
+    bool ok = bindBlock(program, "FrameBlock", FRAME_BLOCK_BINDING, sizeof(FrameBlock));
+    ok = bindBlock(program, "ObjectBlock", OBJECT_BLOCK_BINDING, sizeof(ObjectBlock)) && ok;
+    return ok;
+}
+
+} // namespace Common
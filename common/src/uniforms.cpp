@@ -0,0 +1,49 @@
+#include "uniforms.hpp"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+namespace Common {
+
+void UniformTable::reflect(unsigned int program) {
+    slots.clear();
+
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> name((size_t)std::max(maxLength, 1));
+
+    for (GLint i = 0; i < count; ++i) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, name.data());
+
+        // Uniform block members have no location
+        const GLint location = glGetUniformLocation(program, name.data());
+        if (location < 0)
+            continue;
+
+        std::string_view base(name.data(), (size_t)length);
+        if (base.size() > 3 && base.substr(base.size() - 3) == "[0]")
+            base.remove_suffix(3);
+        slots.push_back({ fnv1a(base), location });
+    }
+
+    std::sort(slots.begin(), slots.end(), [](const Slot& a, const Slot& b) { return a.hash < b.hash; });
+    for (size_t i = 1; i < slots.size(); ++i) {
+        if (slots[i].hash == slots[i - 1].hash)
+            std::cout << "ERROR::UNIFORM_TABLE::HASH_COLLISION in program " << program << std::endl;
+    }
+}
+
+int UniformTable::location(UniformId id) const {
+    auto it = std::lower_bound(slots.begin(), slots.end(), id.hash,
+                               [](const Slot& slot, uint32_t hash) { return slot.hash < hash; });
+    return it != slots.end() && it->hash == id.hash ? it->location : -1;
+}
+
+} // namespace Common